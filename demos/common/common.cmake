@@ -21,6 +21,8 @@ set(COMMON_SOURCE_FILES
     ${CMAKE_CURRENT_LIST_DIR}/src/Camera.cpp
     ${CMAKE_CURRENT_LIST_DIR}/src/CommonUtils.cpp
     ${CMAKE_CURRENT_LIST_DIR}/src/MeshUtils.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/src/ImageFileWriter.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/src/JpegUtils.cpp
 	${CMAKE_CURRENT_LIST_DIR}/include/common/AxisAlignedBoundingBox.h
 	${CMAKE_CURRENT_LIST_DIR}/include/common/Matrix3.h
 	${CMAKE_CURRENT_LIST_DIR}/include/common/Matrix4.h
@@ -28,7 +30,9 @@ set(COMMON_SOURCE_FILES
     ${CMAKE_CURRENT_LIST_DIR}/include/common/Vector4.h
     ${CMAKE_CURRENT_LIST_DIR}/include/common/Camera.h
     ${CMAKE_CURRENT_LIST_DIR}/include/common/CommonUtils.h
-    ${CMAKE_CURRENT_LIST_DIR}/include/common/MeshUtils.h)
+    ${CMAKE_CURRENT_LIST_DIR}/include/common/MeshUtils.h
+    ${CMAKE_CURRENT_LIST_DIR}/include/common/ImageFileWriter.h
+    ${CMAKE_CURRENT_LIST_DIR}/include/common/JpegUtils.h)
 set(COMMON_PUBLIC_HEADERS_DIR ${CMAKE_CURRENT_LIST_DIR}/include)
 
 add_library(common STATIC ${COMMON_SOURCE_FILES})
@@ -38,5 +42,8 @@ target_include_directories(common PUBLIC ${COMMON_PUBLIC_HEADERS_DIR})
 target_include_directories(common PRIVATE "${HEPHAESTUS_EXTERNAL_DEPENDENCIES_LOCATION}/stb")
 target_include_directories(common PRIVATE "${HEPHAESTUS_EXTERNAL_DEPENDENCIES_LOCATION}/tiny_obj_loader")
 
+# worker threads of the image file writer
+find_package(Threads REQUIRED)
+
 checkTargetExists(hephaestus)
-target_link_libraries(common PUBLIC hephaestus)
\ No newline at end of file
+target_link_libraries(common PUBLIC hephaestus Threads::Threads)
\ No newline at end of file
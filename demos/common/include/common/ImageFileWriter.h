@@ -0,0 +1,86 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace hephaestus
+{
+// Encodes images (PNG or JPEG) & writes them to files on a pool of worker threads
+// - the image data are copied to one of a fixed number of buffers, so the caller (e.g. a readback callback of the
+//   headless renderer) can release its data immediately
+// - the queue is bounded by the number of buffers, writing blocks while all buffers are queued so memory usage
+//   stays constant when rendering is faster than encoding
+class ImageFileWriter
+{
+public:
+    enum FileFormat : uint32_t
+    {
+        eFILE_FORMAT_PNG = 0,
+        eFILE_FORMAT_JPG,
+        // quantized JPEG coefficients encoded on the device (see JpegUtils), only entropy coded by the workers
+        eFILE_FORMAT_JPG_COEFFICIENTS
+    };
+
+    struct InitInfo
+    {
+        uint32_t numWorkers = 0u;       // 0 to use the number of hardware threads
+        uint32_t maxQueuedImages = 8u;  // number of image buffers
+        uint32_t jpgQuality = 90u;      // should match the device quality for eFILE_FORMAT_JPG_COEFFICIENTS
+    };
+
+    ImageFileWriter() = default;
+    ~ImageFileWriter() { Clear(); }
+    ImageFileWriter(const ImageFileWriter&) = delete;
+    ImageFileWriter& operator=(const ImageFileWriter&) = delete;
+
+    bool Init(const InitInfo& info);
+    // waits for all queued images to be written
+    void Clear();
+
+    // queues the image for writing, blocks while all buffers are in use, the data are tightly packed rows of 
+    // 8bit channels or the JPEG coefficients of the image (numChannels is ignored)
+    bool Write(const std::string& filename, FileFormat format, 
+        const char* data, uint32_t width, uint32_t height, uint32_t numChannels);
+    // waits for all queued images to be written
+    void WaitIdle();
+
+    uint32_t GetNumWritten() const;
+    uint32_t GetNumFailed() const;
+
+private:
+    struct ImageJob
+    {
+        std::string         filename;
+        FileFormat          format = eFILE_FORMAT_PNG;
+        uint32_t            width = 0u;
+        uint32_t            height = 0u;
+        uint32_t            numChannels = 0u;
+        uint32_t            bufferIndex = 0u;
+    };
+
+    void WorkerLoop();
+    bool Encode(const ImageJob& job, const std::vector<char>& data) const;
+
+    std::vector<std::thread>            m_workers;
+    std::vector<std::vector<char>>      m_buffers;
+    std::vector<uint32_t>               m_freeBuffers;  // indices of the buffers not used by queued images
+    std::deque<ImageJob>                m_jobs;
+    uint32_t                            m_numActiveJobs = 0u;   // queued or being encoded
+    uint32_t                            m_numWritten = 0u;
+    uint32_t                            m_numFailed = 0u;
+    uint32_t                            m_jpgQuality = 90u;
+    bool                                m_stop = false;
+
+    mutable std::mutex                  m_mutex;
+    std::condition_variable             m_jobAvailable;
+    std::condition_variable             m_bufferAvailable;
+    std::condition_variable             m_idle;
+};
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+
+namespace hephaestus
+{
+// Host side of the JPEG encoding done by the headless renderer (HeadlessRenderer::eCOLOR_ENCODING_JPEG_COEFFICIENTS)
+// - the device converts to YCbCr, applies the DCT & quantizes, the host only does the entropy coding
+// - baseline JPEG, YCbCr 4:2:0 with the standard quantization (scaled by the quality) & Huffman tables
+// - only the non zero coefficients are read back, see HeadlessRenderer::eCOLOR_ENCODING_JPEG_COEFFICIENTS
+struct JpegUtils
+{
+    using QuantizationTable = std::array<uint8_t, 64>;
+
+    // standard table scaled by the quality [1, 100] (IJG scaling, same as jpeg_dct.comp), natural order
+    static void GetQuantizationTable(uint32_t quality, bool chroma, QuantizationTable& table);
+
+    // size of the coefficients of a width x height image, for each 16x16 MCU in raster order the 4 Y, Cb & Cr 
+    // blocks, each a slot of 64bit non zero mask (zigzag order) followed by the non zero values (int16)
+    static uint32_t GetCoefficientsSize(uint32_t width, uint32_t height);
+    // copies only the masks & the non zero values of each block, the rest of the slots are left as is
+    static void CopyCoefficients(const uint32_t* coefficients, uint32_t width, uint32_t height, uint32_t* dst);
+
+    // writes the JPEG file data of the image, quality should match the quality used for the quantization
+    static bool EncodeCoefficients(const uint32_t* coefficients, uint32_t width, uint32_t height, uint32_t quality,
+                                   std::vector<char>& jpegData);
+};
+
+}
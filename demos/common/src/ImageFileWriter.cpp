@@ -0,0 +1,191 @@
+#include <common/ImageFileWriter.h>
+
+#include <common/JpegUtils.h>
+
+#include <hephaestus/Log.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+
+namespace hephaestus
+{
+
+bool 
+ImageFileWriter::Init(const InitInfo& info)
+{
+    Clear();
+
+    if (info.maxQueuedImages == 0u)
+        return false;
+
+    const uint32_t numWorkers = info.numWorkers > 0u ? 
+        info.numWorkers : std::max(1u, std::thread::hardware_concurrency());
+
+    m_jpgQuality = std::min(std::max(info.jpgQuality, 1u), 100u);
+    m_stop = false;
+    m_buffers.resize(info.maxQueuedImages);
+    for (uint32_t i = 0u; i < info.maxQueuedImages; ++i)
+        m_freeBuffers.push_back(i);
+
+    for (uint32_t i = 0u; i < numWorkers; ++i)
+        m_workers.emplace_back(&ImageFileWriter::WorkerLoop, this);
+
+    return true;
+}
+
+void 
+ImageFileWriter::Clear()
+{
+    WaitIdle();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_jobAvailable.notify_all();
+    for (std::thread& worker : m_workers)
+        worker.join();
+    m_workers.clear();
+
+    m_buffers.clear();
+    m_freeBuffers.clear();
+    m_jobs.clear();
+    m_numActiveJobs = 0u;
+    m_numWritten = 0u;
+    m_numFailed = 0u;
+}
+
+bool 
+ImageFileWriter::Write(const std::string& filename, FileFormat format, 
+    const char* data, uint32_t width, uint32_t height, uint32_t numChannels)
+{
+    const bool coefficients = format == eFILE_FORMAT_JPG_COEFFICIENTS;
+    if (data == nullptr || width == 0u || height == 0u || 
+        (!coefficients && (numChannels == 0u || numChannels > 4u)))
+        return false;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_workers.empty())
+    {
+        HEPHAESTUS_LOG_WARNING("Image file writer is not initialized");
+        return false;
+    }
+
+    m_bufferAvailable.wait(lock, [this]() { return !m_freeBuffers.empty(); });
+
+    ImageJob job;
+    job.filename = filename;
+    job.format = format;
+    job.width = width;
+    job.height = height;
+    job.numChannels = numChannels;
+    job.bufferIndex = m_freeBuffers.back();
+    m_freeBuffers.pop_back();
+    ++m_numActiveJobs;
+
+    // the buffer is owned by the job until it is encoded so the copy does not need the lock, buffers keep their
+    // capacity so there are no allocations once all buffers have been used
+    lock.unlock();
+    std::vector<char>& buffer = m_buffers[job.bufferIndex];
+    buffer.resize(coefficients ? 
+        (size_t)JpegUtils::GetCoefficientsSize(width, height) : (size_t)width * height * numChannels);
+    if (coefficients)
+        JpegUtils::CopyCoefficients(reinterpret_cast<const uint32_t*>(data), width, height, 
+            reinterpret_cast<uint32_t*>(buffer.data()));
+    else
+        std::memcpy(buffer.data(), data, buffer.size());
+    lock.lock();
+
+    m_jobs.push_back(std::move(job));
+    lock.unlock();
+    m_jobAvailable.notify_one();
+
+    return true;
+}
+
+void 
+ImageFileWriter::WaitIdle()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this]() { return m_numActiveJobs == 0u; });
+}
+
+uint32_t 
+ImageFileWriter::GetNumWritten() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_numWritten;
+}
+
+uint32_t 
+ImageFileWriter::GetNumFailed() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_numFailed;
+}
+
+void 
+ImageFileWriter::WorkerLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_jobAvailable.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+        if (m_jobs.empty())
+            return; // stopped
+
+        const ImageJob job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+
+        lock.unlock();
+        const bool success = Encode(job, m_buffers[job.bufferIndex]);
+        if (!success)
+            HEPHAESTUS_LOG_WARNING("Failed to write image file %s", job.filename.c_str());
+        lock.lock();
+
+        if (success)
+            ++m_numWritten;
+        else
+            ++m_numFailed;
+        m_freeBuffers.push_back(job.bufferIndex);
+        m_bufferAvailable.notify_one();
+        if (--m_numActiveJobs == 0u)
+            m_idle.notify_all();
+    }
+}
+
+bool 
+ImageFileWriter::Encode(const ImageJob& job, const std::vector<char>& data) const
+{
+    switch (job.format)
+    {
+    case eFILE_FORMAT_PNG:
+        return stbi_write_png(job.filename.c_str(), (int)job.width, (int)job.height, (int)job.numChannels,
+            data.data(), (int)(job.width * job.numChannels)) != 0;
+    case eFILE_FORMAT_JPG:
+        return stbi_write_jpg(job.filename.c_str(), (int)job.width, (int)job.height, (int)job.numChannels,
+            data.data(), (int)m_jpgQuality) != 0;
+    case eFILE_FORMAT_JPG_COEFFICIENTS:
+    {
+        std::vector<char> jpegData;
+        if (!JpegUtils::EncodeCoefficients(reinterpret_cast<const uint32_t*>(data.data()), 
+            job.width, job.height, m_jpgQuality, jpegData))
+            return false;
+
+        FILE* file = std::fopen(job.filename.c_str(), "wb");
+        if (file == nullptr)
+            return false;
+        const bool success = std::fwrite(jpegData.data(), 1, jpegData.size(), file) == jpegData.size();
+        return std::fclose(file) == 0 && success;
+    }
+    default:
+        return false;
+    }
+}
+
+}
@@ -0,0 +1,322 @@
+#include <common/JpegUtils.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+
+namespace hephaestus
+{
+
+// standard tables (ITU T.81 Annex K)
+static const uint8_t s_lumaQuantization[64] = {
+    16, 11, 10, 16, 24, 40, 51, 61, 12, 12, 14, 19, 26, 58, 60, 55, 14, 13, 16, 24, 40, 57, 69, 56,
+    14, 17, 22, 29, 51, 87, 80, 62, 18, 22, 37, 56, 68, 109, 103, 77, 24, 35, 55, 64, 81, 104, 113, 92,
+    49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99 };
+static const uint8_t s_chromaQuantization[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99, 24, 26, 56, 99, 99, 99, 99, 99,
+    47, 66, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99 };
+// words of each block (non zero mask & up to 64 int16 values) & of each MCU (4 Y, Cb & Cr blocks)
+static const uint32_t s_blockWords = 2u + 32u;
+static const uint32_t s_mcuWords = 6u * s_blockWords;
+// zigzag index of each coefficient in natural order
+static const uint8_t s_zigzagIndex[64] = {
+    0, 1, 5, 6, 14, 15, 27, 28, 2, 4, 7, 13, 16, 26, 29, 42, 3, 8, 12, 17, 25, 30, 41, 43,
+    9, 11, 18, 24, 31, 40, 44, 53, 10, 19, 23, 32, 39, 45, 52, 54, 20, 22, 33, 38, 46, 51, 55, 60,
+    21, 34, 37, 47, 50, 56, 59, 61, 35, 36, 48, 49, 57, 58, 62, 63 };
+
+// Huffman tables as number of codes of each length (1-16) & symbols
+static const uint8_t s_dcLumaCounts[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+static const uint8_t s_dcChromaCounts[16] = { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+static const uint8_t s_dcSymbols[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+static const uint8_t s_acLumaCounts[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d };
+static const uint8_t s_acLumaSymbols[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07, 0x22, 0x71,
+    0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72,
+    0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x34, 0x35, 0x36, 0x37,
+    0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+    0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83,
+    0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3,
+    0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa };
+static const uint8_t s_acChromaCounts[16] = { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+static const uint8_t s_acChromaSymbols[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71, 0x13, 0x22,
+    0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0, 0x15, 0x62, 0x72, 0xd1,
+    0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x35, 0x36,
+    0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+    0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a,
+    0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a,
+    0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba,
+    0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa };
+
+namespace
+{
+// code & length of each symbol
+struct HuffmanTable
+{
+    uint16_t codes[256] = {};
+    uint8_t lengths[256] = {};
+
+    HuffmanTable(const uint8_t* counts, const uint8_t* symbols)
+    {
+        // canonical codes, consecutive codes for each length
+        uint32_t code = 0u;
+        uint32_t symbolIndex = 0u;
+        for (uint32_t length = 1u; length <= 16u; ++length)
+        {
+            for (uint32_t i = 0u; i < counts[length - 1u]; ++i)
+            {
+                codes[symbols[symbolIndex]] = (uint16_t)code++;
+                lengths[symbols[symbolIndex]] = (uint8_t)length;
+                ++symbolIndex;
+            }
+            code <<= 1u;
+        }
+    }
+};
+
+class BitWriter
+{
+public:
+    explicit BitWriter(std::vector<char>& data) : m_data(data) {}
+
+    void Write(uint32_t bits, uint32_t numBits)
+    {
+        m_buffer = (m_buffer << numBits) | (bits & ((1u << numBits) - 1u));
+        m_numBits += numBits;
+        while (m_numBits >= 8u)
+        {
+            const uint8_t byte = (uint8_t)(m_buffer >> (m_numBits - 8u));
+            m_data.push_back((char)byte);
+            if (byte == 0xff)
+                m_data.push_back(0);    // byte stuffing
+            m_numBits -= 8u;
+        }
+    }
+
+    void Flush()
+    {
+        // pad with 1s
+        if (m_numBits > 0u)
+            Write(0x7f, 8u - m_numBits);
+    }
+
+private:
+    std::vector<char>&  m_data;
+    uint32_t            m_buffer = 0u;
+    uint32_t            m_numBits = 0u;
+};
+
+}
+
+static 
+void
+s_WriteMarker(std::vector<char>& data, uint8_t marker, uint16_t length)
+{
+    data.push_back((char)0xff);
+    data.push_back((char)marker);
+    data.push_back((char)(length >> 8u));
+    data.push_back((char)(length & 0xffu));
+}
+
+static
+void
+s_WriteHuffmanTable(std::vector<char>& data, uint8_t tableClassAndID, 
+    const uint8_t* counts, const uint8_t* symbols, uint32_t numSymbols)
+{
+    data.push_back((char)tableClassAndID);
+    data.insert(data.end(), counts, counts + 16);
+    data.insert(data.end(), symbols, symbols + numSymbols);
+}
+
+static
+uint32_t
+s_GetNumMCUs(uint32_t width, uint32_t height)
+{
+    return ((width + 15u) / 16u) * ((height + 15u) / 16u);
+}
+
+static
+uint32_t
+s_GetNumValues(const uint32_t* block)
+{
+    uint32_t numValues = 0u;
+    for (uint32_t i = 0u; i < 2u; ++i)
+        for (uint32_t mask = block[i]; mask != 0u; mask &= mask - 1u)
+            ++numValues;
+
+    return numValues;
+}
+
+static
+void
+s_EncodeValue(BitWriter& writer, const HuffmanTable& table, uint32_t run, int32_t value)
+{
+    // magnitude category & the value bits (one's complement for negative values)
+    const uint32_t magnitude = (uint32_t)std::abs(value);
+    uint32_t category = 0u;
+    while ((magnitude >> category) != 0u)
+        ++category;
+
+    const uint32_t symbol = (run << 4u) | category;
+    writer.Write(table.codes[symbol], table.lengths[symbol]);
+    if (category > 0u)
+        writer.Write(value < 0 ? (uint32_t)(value - 1) : (uint32_t)value, category);
+}
+
+void 
+JpegUtils::GetQuantizationTable(uint32_t quality, bool chroma, QuantizationTable& table)
+{
+    quality = std::min(std::max(quality, 1u), 100u);
+    const uint32_t scale = quality < 50u ? 5000u / quality : 200u - 2u * quality;
+    const uint8_t* baseTable = chroma ? s_chromaQuantization : s_lumaQuantization;
+    for (uint32_t i = 0u; i < 64u; ++i)
+        table[i] = (uint8_t)std::min(std::max((baseTable[i] * scale + 50u) / 100u, 1u), 255u);
+}
+
+uint32_t 
+JpegUtils::GetCoefficientsSize(uint32_t width, uint32_t height)
+{
+    return s_GetNumMCUs(width, height) * s_mcuWords * (uint32_t)sizeof(uint32_t);
+}
+
+void 
+JpegUtils::CopyCoefficients(const uint32_t* coefficients, uint32_t width, uint32_t height, uint32_t* dst)
+{
+    const uint32_t numBlocks = s_GetNumMCUs(width, height) * 6u;
+    for (uint32_t i = 0u; i < numBlocks; ++i)
+    {
+        const uint32_t* block = coefficients + i * s_blockWords;
+        const uint32_t numWords = 2u + (s_GetNumValues(block) + 1u) / 2u;
+        std::memcpy(dst + i * s_blockWords, block, numWords * sizeof(uint32_t));
+    }
+}
+
+bool 
+JpegUtils::EncodeCoefficients(const uint32_t* coefficients, uint32_t width, uint32_t height, uint32_t quality,
+                              std::vector<char>& jpegData)
+{
+    if (coefficients == nullptr || width == 0u || height == 0u || width > 0xffffu || height > 0xffffu)
+        return false;
+
+    jpegData.clear();
+
+    // SOI
+    jpegData.push_back((char)0xff);
+    jpegData.push_back((char)0xd8);
+
+    // DQT, tables in zigzag order
+    s_WriteMarker(jpegData, 0xdb, 2u + 2u * 65u);
+    for (uint8_t tableID = 0u; tableID < 2u; ++tableID)
+    {
+        QuantizationTable table;
+        GetQuantizationTable(quality, tableID == 1u, table);
+        QuantizationTable zigzagTable;
+        for (uint32_t i = 0u; i < 64u; ++i)
+            zigzagTable[s_zigzagIndex[i]] = table[i];
+
+        jpegData.push_back((char)tableID);
+        jpegData.insert(jpegData.end(), zigzagTable.begin(), zigzagTable.end());
+    }
+
+    // SOF0, 3 components with 2x2 Y blocks for each Cb & Cr block, Y uses table 0 & CbCr table 1
+    s_WriteMarker(jpegData, 0xc0, 8u + 3u * 3u);
+    jpegData.push_back(8);  // precision
+    jpegData.push_back((char)(height >> 8u));
+    jpegData.push_back((char)(height & 0xffu));
+    jpegData.push_back((char)(width >> 8u));
+    jpegData.push_back((char)(width & 0xffu));
+    jpegData.push_back(3);
+    for (uint8_t component = 0u; component < 3u; ++component)
+    {
+        jpegData.push_back((char)(component + 1u));
+        jpegData.push_back(component == 0u ? 0x22 : 0x11);
+        jpegData.push_back(component == 0u ? 0 : 1);
+    }
+
+    // DHT
+    s_WriteMarker(jpegData, 0xc4, 2u + 4u * 17u + 2u * 12u + 2u * 162u);
+    s_WriteHuffmanTable(jpegData, 0x00, s_dcLumaCounts, s_dcSymbols, 12u);
+    s_WriteHuffmanTable(jpegData, 0x10, s_acLumaCounts, s_acLumaSymbols, 162u);
+    s_WriteHuffmanTable(jpegData, 0x01, s_dcChromaCounts, s_dcSymbols, 12u);
+    s_WriteHuffmanTable(jpegData, 0x11, s_acChromaCounts, s_acChromaSymbols, 162u);
+
+    // SOS
+    s_WriteMarker(jpegData, 0xda, 6u + 2u * 3u);
+    jpegData.push_back(3);
+    for (uint8_t component = 0u; component < 3u; ++component)
+    {
+        jpegData.push_back((char)(component + 1u));
+        jpegData.push_back(component == 0u ? 0x00 : 0x11);
+    }
+    jpegData.push_back(0);      // spectral selection start
+    jpegData.push_back(63);     // spectral selection end
+    jpegData.push_back(0);      // successive approximation
+
+    // entropy coded data, each MCU has 4 Y blocks followed by the Cb & Cr blocks
+    static const HuffmanTable s_dcLumaTable(s_dcLumaCounts, s_dcSymbols);
+    static const HuffmanTable s_acLumaTable(s_acLumaCounts, s_acLumaSymbols);
+    static const HuffmanTable s_dcChromaTable(s_dcChromaCounts, s_dcSymbols);
+    static const HuffmanTable s_acChromaTable(s_acChromaCounts, s_acChromaSymbols);
+
+    BitWriter writer(jpegData);
+    int32_t prevDC[3] = { 0, 0, 0 };
+    const uint32_t numBlocks = s_GetNumMCUs(width, height) * 6u;
+    for (uint32_t block = 0u; block < numBlocks; ++block)
+    {
+        const uint32_t component = block % 6u < 4u ? 0u : block % 6u - 3u;
+
+        // expand the non zero values of the block
+        int16_t blockCoefficients[64] = {};
+        {
+            const uint32_t* blockWords = coefficients + block * s_blockWords;
+            const uint16_t* values = reinterpret_cast<const uint16_t*>(blockWords + 2u);
+            uint32_t numValues = 0u;
+            for (uint32_t i = 0u; i < 64u; ++i)
+            {
+                if ((blockWords[i / 32u] >> (i % 32u)) & 1u)
+                    blockCoefficients[i] = (int16_t)values[numValues++];
+            }
+        }
+        const HuffmanTable& dcTable = component == 0u ? s_dcLumaTable : s_dcChromaTable;
+        const HuffmanTable& acTable = component == 0u ? s_acLumaTable : s_acChromaTable;
+
+        // DC is coded as the difference to the previous block of the component
+        s_EncodeValue(writer, dcTable, 0u, blockCoefficients[0] - prevDC[component]);
+        prevDC[component] = blockCoefficients[0];
+
+        // AC as runs of zeros followed by a value, 16 zeros (ZRL) & end of block (EOB) are special symbols
+        uint32_t run = 0u;
+        for (uint32_t i = 1u; i < 64u; ++i)
+        {
+            if (blockCoefficients[i] == 0)
+            {
+                ++run;
+                continue;
+            }
+
+            while (run >= 16u)
+            {
+                writer.Write(acTable.codes[0xf0], acTable.lengths[0xf0]);
+                run -= 16u;
+            }
+            s_EncodeValue(writer, acTable, run, blockCoefficients[i]);
+            run = 0u;
+        }
+        if (run > 0u)
+            writer.Write(acTable.codes[0x00], acTable.lengths[0x00]);
+    }
+    writer.Flush();
+
+    // EOI
+    jpegData.push_back((char)0xff);
+    jpegData.push_back((char)0xd9);
+
+    return true;
+}
+
+}
@@ -95,14 +95,11 @@ MeshUtils::SetupPipelineForMesh(const TriMesh& mesh,
     const uint32_t maxCopySize = std::max<uint32_t>({ vertexCopyDataSize, indexCopyDataSize });
     std::vector<char> tempBuffer(maxCopySize, 0);
 
-    // allocate stage buffer
-    constexpr uint32_t padding = 0x1000;
-    const uint32_t stageSize = maxCopySize + padding;
-    outPipeline.CreateStageBuffer(stageSize);
-
+    // no stage buffer needed, staged data are streamed through the device manager upload manager
     if (vertexDataSize > 0)
     {
-        if (!outPipeline.CreateVertexBuffer(vertexCopyDataSize))
+        if (!outPipeline.CreateVertexBuffer(vertexCopyDataSize, 
+            pipelineParams.vertexBufferMode, pipelineParams.numFramesInFlight))
             return false;
     }
 
@@ -113,11 +110,19 @@ MeshUtils::SetupPipelineForMesh(const TriMesh& mesh,
     }
 
     TriMeshPipeline::MeshIDType newMeshId = outPipeline.CreateMeshID();
+    if (newMeshId == TriMeshPipeline::InvalidMeshID)
+        return false;
+
+    // submit all staged uploads of the mesh together, unless the caller is already batching uploads
+    VulkanUploadManager& uploadManager = outPipeline.GetDeviceManager().GetUploadManager();
+    const bool batchUploads = !uploadManager.IsBatchOpen();
+    if (batchUploads && !uploadManager.BeginBatch())
+        return false;
 
     // update texture
+    bool uploaded = outPipeline.MeshCreateTexture(newMeshId, imageDesc.width, imageDesc.height);
+    if (uploaded)
     {
-        outPipeline.MeshCreateTexture(newMeshId, imageDesc.width, imageDesc.height);
-
         VulkanUtils::TextureUpdateInfo updateInfo;
         {
             updateInfo.copyCmdBuffer = copyCmdBuffer;
@@ -126,10 +131,11 @@ MeshUtils::SetupPipelineForMesh(const TriMesh& mesh,
             updateInfo.width = imageDesc.width;
             updateInfo.height = imageDesc.height;
         }
-        outPipeline.MeshSetTextureData(newMeshId, updateInfo);
+        uploaded = outPipeline.MeshSetTextureData(newMeshId, updateInfo);
     }
 
     // upload vertex data
+    if (uploaded)
     {
         VulkanUtils::BufferUpdateInfo updateInfo;
         {
@@ -148,11 +154,11 @@ MeshUtils::SetupPipelineForMesh(const TriMesh& mesh,
                 updateInfo.dataSize = vertexDataSize;
             }
         }
-        if (!outPipeline.MeshSetVertexData(newMeshId, updateInfo))
-            return false;
+        uploaded = outPipeline.MeshSetVertexData(newMeshId, updateInfo);
     }
 
     // upload index data
+    if (uploaded)
     {
         VulkanUtils::BufferUpdateInfo updateInfo;
         {
@@ -171,9 +177,18 @@ MeshUtils::SetupPipelineForMesh(const TriMesh& mesh,
                 updateInfo.dataSize = indexDataSize;
             }
         }
-        if (!outPipeline.MeshSetIndexData(newMeshId, updateInfo))
+        uploaded = outPipeline.MeshSetIndexData(newMeshId, updateInfo);
+    }
+
+    // close the batch opened here even if an upload failed, so that later uploads are not left in it
+    if (batchUploads)
+    {
+        VulkanUploadManager::Ticket ticket = VulkanUploadManager::InvalidTicket;
+        if (!uploadManager.FlushBatch(ticket))
             return false;
     }
+    if (!uploaded)
+        return false;
 
     // setup the pipeline
     if (!outPipeline.SetupPipeline(renderPass, shaderParams, pipelineParams))
@@ -0,0 +1,41 @@
+#version 450
+
+// same shading as mesh.frag & the auxiliary outputs of the renderer (VulkanUtils::RenderOutput)
+
+layout (set = 1, binding = 1) uniform sampler2D samplerColorMap;
+
+layout (push_constant) uniform MeshPC
+{
+	uint meshID;
+} meshPC;
+
+layout (location = 0) in vec3 inNormal;
+layout (location = 1) in vec3 inColor;
+layout (location = 2) in vec2 inUV;
+layout (location = 3) in vec3 inViewVec;
+layout (location = 4) in vec3 inLightVec;
+
+layout (location = 0) out vec4 outFragColor;
+layout (location = 1) out float outDepth;	// linear view space depth
+layout (location = 2) out vec4 outNormal;	// view space normal
+layout (location = 3) out uint outMeshID;
+
+void main() 
+{
+	vec4 color = texture(samplerColorMap, inUV) * vec4(inColor, 1.0);
+	
+    // simple Phong shading
+    float specularCoeff = 4.f;
+	vec3 N = normalize(inNormal);
+	vec3 L = normalize(inLightVec);
+	vec3 V = normalize(inViewVec);
+	vec3 R = reflect(-L, N);
+	vec3 diffuse = max(dot(N, L), 0.0) * inColor;
+	vec3 specular = pow(max(dot(R, V), 0.0), specularCoeff) * vec3(0.75);
+	outFragColor = vec4(diffuse * color.rgb + specular, 1.0);
+
+	// the view vector is the negated view space position
+	outDepth = inViewVec.z;
+	outNormal = vec4(N, 0.0);
+	outMeshID = meshPC.meshID;
+}
\ No newline at end of file
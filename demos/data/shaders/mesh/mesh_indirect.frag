@@ -0,0 +1,38 @@
+#version 450
+
+// shading of mesh.frag without textures for indirect draws, the mesh ID comes from the vertex shader
+// (see mesh_indirect.vert), define RENDER_OUTPUTS to also write the auxiliary outputs of the renderer
+
+layout (location = 0) in vec3 inNormal;
+layout (location = 1) in vec3 inColor;
+layout (location = 2) in vec2 inUV;
+layout (location = 3) in vec3 inViewVec;
+layout (location = 4) in vec3 inLightVec;
+layout (location = 5) flat in uint inMeshID;
+
+layout (location = 0) out vec4 outFragColor;
+#ifdef RENDER_OUTPUTS
+layout (location = 1) out float outDepth;	// linear view space depth
+layout (location = 2) out vec4 outNormal;	// view space normal
+layout (location = 3) out uint outMeshID;
+#endif
+
+void main() 
+{
+    // simple Phong shading
+    float specularCoeff = 4.f;
+	vec3 N = normalize(inNormal);
+	vec3 L = normalize(inLightVec);
+	vec3 V = normalize(inViewVec);
+	vec3 R = reflect(-L, N);
+	vec3 diffuse = max(dot(N, L), 0.0) * inColor;
+	vec3 specular = pow(max(dot(R, V), 0.0), specularCoeff) * vec3(0.75);
+	outFragColor = vec4(diffuse + specular, 1.0);
+
+#ifdef RENDER_OUTPUTS
+	// the view vector is the negated view space position
+	outDepth = inViewVec.z;
+	outNormal = vec4(N, 0.0);
+	outMeshID = inMeshID;
+#endif
+}
@@ -0,0 +1,45 @@
+#version 450
+
+#extension GL_EXT_nonuniform_qualifier : require
+
+// shading of mesh.frag for indirect draws with bindless textures (TriMeshPipeline::SetupParams::bindlessTextures),
+// the texture of each mesh is indexed by the mesh ID, which is not uniform across the draws of a multi draw,
+// define RENDER_OUTPUTS to also write the auxiliary outputs of the renderer
+
+layout (set = 1, binding = 0) uniform sampler2D textures[];
+
+layout (location = 0) in vec3 inNormal;
+layout (location = 1) in vec3 inColor;
+layout (location = 2) in vec2 inUV;
+layout (location = 3) in vec3 inViewVec;
+layout (location = 4) in vec3 inLightVec;
+layout (location = 5) flat in uint inMeshID;
+
+layout (location = 0) out vec4 outFragColor;
+#ifdef RENDER_OUTPUTS
+layout (location = 1) out float outDepth;	// linear view space depth
+layout (location = 2) out vec4 outNormal;	// view space normal
+layout (location = 3) out uint outMeshID;
+#endif
+
+void main() 
+{
+	vec4 color = texture(textures[nonuniformEXT(inMeshID)], inUV) * vec4(inColor, 1.0);
+	
+    // simple Phong shading
+    float specularCoeff = 4.f;
+	vec3 N = normalize(inNormal);
+	vec3 L = normalize(inLightVec);
+	vec3 V = normalize(inViewVec);
+	vec3 R = reflect(-L, N);
+	vec3 diffuse = max(dot(N, L), 0.0) * inColor;
+	vec3 specular = pow(max(dot(R, V), 0.0), specularCoeff) * vec3(0.75);
+	outFragColor = vec4(diffuse * color.rgb + specular, 1.0);
+
+#ifdef RENDER_OUTPUTS
+	// the view vector is the negated view space position
+	outDepth = inViewVec.z;
+	outNormal = vec4(N, 0.0);
+	outMeshID = inMeshID;
+#endif
+}
@@ -0,0 +1,55 @@
+#version 450
+
+// same as mesh_indirect.vert with instancing (TriMeshPipeline::SetupParams::instancing), the first instance of
+// each draw is the offset of the mesh instances so the mesh ID is read from the instance data
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec2 inUV;
+layout (location = 3) in vec3 inColor;
+layout (location = 4) in mat4 inInstanceTransform;	// locations 4-7
+layout (location = 8) in uint inMeshID;
+
+layout (set = 0, binding = 0) uniform SceneUB
+{
+	mat4 projection;
+	mat4 view;
+	vec4 lightPos;
+} sceneUB;
+
+layout (std430, set = 0, binding = 1) readonly buffer MeshData
+{
+	mat4 models[];
+} meshData;
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec3 outColor;
+layout (location = 2) out vec2 outUV;
+layout (location = 3) out vec3 outViewVec;
+layout (location = 4) out vec3 outLightVec;
+layout (location = 5) flat out uint outMeshID;
+
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
+
+void main() 
+{
+	outNormal = inNormal;
+	outColor = inColor;
+	outUV = inUV;
+	outMeshID = inMeshID;
+    
+    // update camera position
+    mat4 modelview = sceneUB.view * meshData.models[inMeshID] * inInstanceTransform;
+	gl_Position = sceneUB.projection * modelview * vec4(inPos.xyz, 1.0);
+	
+    // compute vectors for shading
+	vec4 pos = modelview * vec4(inPos, 1.0);
+	outNormal = mat3(modelview) * inNormal;
+	vec3 lPos = mat3(modelview) * sceneUB.lightPos.xyz;
+	outLightVec = lPos - pos.xyz;
+	outViewVec = -pos.xyz;
+}
@@ -0,0 +1,49 @@
+cmake_minimum_required (VERSION 3.5.1)
+
+# SPIR-V binaries of the demo shaders, compiled next to their sources where the demos load them from
+find_program(HEPHAESTUS_GLSLANG_VALIDATOR glslangValidator HINTS $ENV{VULKAN_SDK}/bin $ENV{VULKAN_SDK}/Bin)
+find_program(HEPHAESTUS_SPIRV_VAL spirv-val HINTS $ENV{VULKAN_SDK}/bin $ENV{VULKAN_SDK}/Bin)
+
+if (NOT HEPHAESTUS_GLSLANG_VALIDATOR)
+    message(WARNING "glslangValidator not found, the demo shader binaries will not be built")
+endif()
+
+set(HEPHAESTUS_SHADERS_DIR ${CMAKE_CURRENT_LIST_DIR})
+set(HEPHAESTUS_SHADER_BINARIES "")
+
+# compile shaderSource to shaderBinary (both relative to this dir), any extra args are passed to glslangValidator
+function(addShaderBinary shaderSource shaderBinary)
+    if (NOT HEPHAESTUS_GLSLANG_VALIDATOR)
+        return()
+    endif()
+
+    set(sourceFile ${HEPHAESTUS_SHADERS_DIR}/${shaderSource})
+    set(binaryFile ${HEPHAESTUS_SHADERS_DIR}/${shaderBinary})
+    if (HEPHAESTUS_SPIRV_VAL)
+        set(validateCommand COMMAND ${HEPHAESTUS_SPIRV_VAL} --target-env vulkan1.0 ${binaryFile})
+    endif()
+
+    add_custom_command(
+        OUTPUT ${binaryFile}
+        COMMAND ${HEPHAESTUS_GLSLANG_VALIDATOR} -V ${ARGN} -o ${binaryFile} ${sourceFile}
+        ${validateCommand}
+        DEPENDS ${sourceFile}
+        COMMENT "Compiling ${shaderBinary}")
+
+    set(HEPHAESTUS_SHADER_BINARIES ${HEPHAESTUS_SHADER_BINARIES} ${binaryFile} PARENT_SCOPE)
+endfunction(addShaderBinary)
+
+addShaderBinary(mesh/mesh_multiview.vert mesh/mesh_multiview.vert.spv)
+addShaderBinary(mesh/mesh_aux.frag mesh/mesh_aux.frag.spv)
+addShaderBinary(readback/convert.comp readback/convert.comp.spv)
+addShaderBinary(readback/jpeg_dct.comp readback/jpeg_dct.comp.spv)
+addShaderBinary(mesh/mesh_indirect.vert mesh/mesh_indirect.vert.spv)
+addShaderBinary(mesh/mesh_indirect.frag mesh/mesh_indirect.frag.spv)
+addShaderBinary(mesh/mesh_indirect.frag mesh/mesh_indirect_aux.frag.spv -DRENDER_OUTPUTS)
+addShaderBinary(mesh/mesh_instanced.vert mesh/mesh_instanced.vert.spv)
+addShaderBinary(mesh/mesh_indirect_instanced.vert mesh/mesh_indirect_instanced.vert.spv)
+addShaderBinary(mesh/mesh_indirect_bindless.frag mesh/mesh_indirect_bindless.frag.spv)
+addShaderBinary(mesh/mesh_indirect_bindless.frag mesh/mesh_indirect_bindless_aux.frag.spv -DRENDER_OUTPUTS)
+addShaderBinary(mesh/mesh_pushconstants.vert mesh/mesh_pushconstants.vert.spv)
+
+add_custom_target(shaders ALL DEPENDS ${HEPHAESTUS_SHADER_BINARIES})
@@ -2,7 +2,9 @@
 #include <common/AxisAlignedBoundingBox.h>
 #include <common/Camera.h>
 #include <common/CommonUtils.h>
+#include <common/ImageFileWriter.h>
 #include <common/MeshUtils.h>
+#include <common/Matrix3.h>
 #include <common/Matrix4.h>
 #include <hephaestus/Log.h>
 #include <hephaestus/Compiler.h>
@@ -11,19 +13,97 @@
 #include <hephaestus/VulkanConfig.h>
 
 #include <cstdlib>
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
 
 
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include <stb_image_write.h>
-
 enum ShaderType
 {
     eSHADER_VERTEX_PNTC = 0,
     eSHADER_FRAGMENT_PhongNoTexture = 1,
-    eSHADER_FRAGMENT_PhongTexture = 2
+    eSHADER_FRAGMENT_PhongTexture = 2,
+    eSHADER_COMPUTE_ColorConversion = 3
+};
+
+// renderer & pipeline features exercised by the demo, set from the command line
+struct DemoOptions
+{
+    uint32_t numViews = 1u;         // --views <n>: render n camera elevations per frame with multiview
+    bool renderOutputs = false;     // --outputs: render the aux outputs & write the mesh ID masks
+    bool convertRGB = false;        // --convert: read back RGB pixels converted on the device
+    bool jpegOnDevice = false;      // --jpeg: read back the JPEG coefficients computed on the device
+    bool indirectDraw = false;      // --indirect
+    bool instancing = false;        // --instancing: draw a row of instances of the mesh
+    bool bindlessTextures = false;  // --bindless: requires --indirect
+    bool pushConstantTransforms = false;    // --pushconstants: direct draws only
 };
 
+static bool ParseOptions(int argc, char* argv[], DemoOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--views") == 0 && i + 1 < argc)
+            options.numViews = (uint32_t)std::max(std::atoi(argv[++i]), 1);
+        else if (std::strcmp(argv[i], "--outputs") == 0)
+            options.renderOutputs = true;
+        else if (std::strcmp(argv[i], "--convert") == 0)
+            options.convertRGB = true;
+        else if (std::strcmp(argv[i], "--jpeg") == 0)
+            options.jpegOnDevice = true;
+        else if (std::strcmp(argv[i], "--indirect") == 0)
+            options.indirectDraw = true;
+        else if (std::strcmp(argv[i], "--instancing") == 0)
+            options.instancing = true;
+        else if (std::strcmp(argv[i], "--bindless") == 0)
+            options.bindlessTextures = true;
+        else if (std::strcmp(argv[i], "--pushconstants") == 0)
+            options.pushConstantTransforms = true;
+        else
+            return false;
+    }
+
+    // only combinations with a matching pair of shaders
+    if (options.numViews > 1u && (options.indirectDraw || options.instancing || options.pushConstantTransforms))
+        return false;
+    if (options.bindlessTextures && !options.indirectDraw)
+        return false;
+    if (options.pushConstantTransforms && (options.indirectDraw || options.instancing))
+        return false;
+
+    return !(options.convertRGB && options.jpegOnDevice);
+}
+
+static const char* GetVertexShaderFile(const DemoOptions& options)
+{
+    if (options.pushConstantTransforms)
+        return "../data/shaders/mesh/mesh_pushconstants.vert.spv";
+    if (options.indirectDraw)
+        return options.instancing ? 
+            "../data/shaders/mesh/mesh_indirect_instanced.vert.spv" : "../data/shaders/mesh/mesh_indirect.vert.spv";
+    if (options.instancing)
+        return "../data/shaders/mesh/mesh_instanced.vert.spv";
+
+    return options.numViews > 1u ? "../data/shaders/mesh/mesh_multiview.vert.spv" : "../data/shaders/mesh/mesh.vert.spv";
+}
+
+static const char* GetFragmentShaderFile(const DemoOptions& options)
+{
+    // the *_aux shaders are compiled with RENDER_OUTPUTS defined
+    if (options.bindlessTextures)
+        return options.renderOutputs ? 
+            "../data/shaders/mesh/mesh_indirect_bindless_aux.frag.spv" : 
+            "../data/shaders/mesh/mesh_indirect_bindless.frag.spv";
+    if (options.indirectDraw)
+        return options.renderOutputs ? 
+            "../data/shaders/mesh/mesh_indirect_aux.frag.spv" : "../data/shaders/mesh/mesh_indirect.frag.spv";
+
+    return options.renderOutputs ? "../data/shaders/mesh/mesh_aux.frag.spv" : "../data/shaders/mesh/mesh.frag.spv";
+}
+
 
 hephaestus::VulkanDispatcher::ModuleType s_vulkanLib = (hephaestus::VulkanDispatcher::ModuleType)nullptr;
 static void UnloadVulkanLib()
@@ -41,8 +121,13 @@ static void UnloadVulkanLib()
 if (!(expr)) { HEPHAESTUS_LOG_ERROR(msg); std::exit(EXIT_FAILURE); }
 
 
-int main()
+int main(int argc, char* argv[])
 {
+    DemoOptions options;
+    CHECK_EXIT_MSG(ParseOptions(argc, argv, options), 
+        "Usage: render-to-file [--views <n>] [--outputs] [--convert | --jpeg] "
+        "[--indirect [--bindless]] [--instancing] [--pushconstants]");
+
     // Load the Vulkan dynamic lib
     {
 #ifdef HEPHAESTUS_PLATFORM_WIN32
@@ -75,28 +160,56 @@ int main()
     //hephaestus::MallocAllocator allocator;
     constexpr uint32_t outWidth = 1024u;
     constexpr uint32_t outHeight = 1024u;
-
-    // init headless renderer
-    hephaestus::HeadlessRenderer renderer(deviceManager);
-    {
-        hephaestus::HeadlessRenderer::InitInfo info = {};
-        info.width = outWidth;
-        info.height = outHeight;
-        CHECK_EXIT_MSG(renderer.Init(info),"Failed to init headless renderer");
-    }
+    constexpr uint32_t numFramesInFlight = 3u;
+    constexpr uint32_t numFrames = 16u;     // frames of a turntable around the mesh
+    constexpr uint32_t numInstances = 3u;
+    constexpr uint32_t jpegQuality = 90u;
 
     hephaestus::VulkanUtils::ShaderDB shaderDB;
     {
         shaderDB.loadedShaders[ShaderType::eSHADER_VERTEX_PNTC] =
-            hephaestus::VulkanUtils::CreateShaderModule(deviceManager, "../data/shaders/mesh/mesh.vert.spv");
+            hephaestus::VulkanUtils::CreateShaderModule(deviceManager, GetVertexShaderFile(options));
         shaderDB.loadedShaders[ShaderType::eSHADER_FRAGMENT_PhongNoTexture] =
             hephaestus::VulkanUtils::CreateShaderModule(deviceManager, "../data/shaders/mesh/mesh_notexture.frag.spv");
         shaderDB.loadedShaders[ShaderType::eSHADER_FRAGMENT_PhongTexture] =
-            hephaestus::VulkanUtils::CreateShaderModule(deviceManager, "../data/shaders/mesh/mesh.frag.spv");
+            hephaestus::VulkanUtils::CreateShaderModule(deviceManager, GetFragmentShaderFile(options));
 //         shaderDB.loadedShaders[ShaderType::eSHADER_VERTEX_Lines] =
 //             VulkanUtils::CreateShaderModule(m_deviceManager, std::string(dirStr + "/primitives/lines.vert.spv").c_str());
 //         shaderDB.loadedShaders[ShaderType::eSHADER_FRAGMENT_Lines] =
 //             VulkanUtils::CreateShaderModule(m_deviceManager, std::string(dirStr + "/primitives/lines.frag.spv").c_str()    
+        if (options.convertRGB)
+            shaderDB.loadedShaders[ShaderType::eSHADER_COMPUTE_ColorConversion] =
+                hephaestus::VulkanUtils::CreateShaderModule(deviceManager, 
+                    "../data/shaders/readback/convert.comp.spv");
+        else if (options.jpegOnDevice)
+            shaderDB.loadedShaders[ShaderType::eSHADER_COMPUTE_ColorConversion] =
+                hephaestus::VulkanUtils::CreateShaderModule(deviceManager, 
+                    "../data/shaders/readback/jpeg_dct.comp.spv");
+    }
+
+    // init headless renderer
+    hephaestus::HeadlessRenderer renderer(deviceManager);
+    {
+        hephaestus::HeadlessRenderer::InitInfo info = {};
+        info.width = outWidth;
+        info.height = outHeight;
+        info.numFramesInFlight = numFramesInFlight;
+        info.numViews = options.numViews;
+        info.depthOutput = options.renderOutputs;
+        info.normalOutput = options.renderOutputs;
+        info.meshIDOutput = options.renderOutputs;
+        if (options.convertRGB)
+        {
+            info.colorConversion.shader = shaderDB.GetModule(ShaderType::eSHADER_COMPUTE_ColorConversion);
+            info.colorConversion.numChannels = 3u;
+        }
+        else if (options.jpegOnDevice)
+        {
+            info.colorConversion.shader = shaderDB.GetModule(ShaderType::eSHADER_COMPUTE_ColorConversion);
+            info.colorConversion.encoding = hephaestus::HeadlessRenderer::eCOLOR_ENCODING_JPEG_COEFFICIENTS;
+            info.colorConversion.jpegQuality = jpegQuality;
+        }
+        CHECK_EXIT_MSG(renderer.Init(info),"Failed to init headless renderer");
     }
 
     // load data into pipeline
@@ -122,6 +235,14 @@ int main()
             shaderParams.fragmentShaderIndex = ShaderType::eSHADER_FRAGMENT_PhongTexture;
         }
         hephaestus::TriMeshPipeline::SetupParams params = {}; // default pipeline params
+        params.numFramesInFlight = numFramesInFlight;
+        params.vertexBufferMode = hephaestus::PipelineBase::eVERTEX_BUFFER_MODE_STATIC; // mesh is never updated
+        params.numViews = options.numViews;
+        params.renderOutputs = options.renderOutputs;
+        params.indirectDraw = options.indirectDraw;
+        params.instancing = options.instancing;
+        params.bindlessTextures = options.bindlessTextures;
+        params.pushConstantTransforms = options.pushConstantTransforms;
         CHECK_EXIT_MSG(hephaestus::MeshUtils::SetupPipelineForMesh(
             mesh, textureData, textureDesc, renderer.GetCmdBuffer(), renderer.GetRenderPass(), 
             shaderParams, params, meshPipeline), 
@@ -157,6 +278,24 @@ int main()
             CHECK_EXIT_MSG(meshPipeline.UpdateViewMatrix(matrixData, renderer.GetCmdBuffer()),
                 "Failed to update view matrix");
 
+            // with multiple views each view looks at the mesh from a different elevation
+            if (options.numViews > 1u)
+            {
+                std::array<float, 16> projectionData;
+                projection.GetRaw(projectionData);
+                const float elevationStep = 2.f * bbox.ComputeExtends().y;
+                for (uint32_t v = 0u; v < options.numViews; ++v)
+                {
+                    hephaestus::Vector3 viewCamPos = camPos;
+                    viewCamPos.y += elevationStep * ((float)v - 0.5f * (float)(options.numViews - 1u));
+                    camera.SetLookAt(viewCamPos, center);
+                    camera.GetViewRenderMatrix(view);
+                    view.GetRaw(matrixData);
+                    CHECK_EXIT_MSG(meshPipeline.UpdateViewAndProjectionMatrix(v, matrixData, projectionData),
+                        "Failed to update view matrices");
+                }
+            }
+
             CHECK_EXIT_MSG(meshPipeline.UpdateLightPos(
                 { { 0.0f, 1.0f, 5.0f, 1.0f } }, renderer.GetCmdBuffer()), "Failed to update light position");
 
@@ -165,29 +304,93 @@ int main()
             model.GetRaw(matrixData);
             CHECK_EXIT_MSG(meshPipeline.UpdateModelMatrix(0u, matrixData, renderer.GetCmdBuffer()),
                 "Failed to update mesh model transform");
+
+            // row of instances along the x axis of the mesh
+            if (options.instancing)
+            {
+                std::vector<hephaestus::TriMeshPipeline::Matrix4x4f> instances(numInstances);
+                const float instanceStep = 2.f * bbox.ComputeExtends().x;
+                for (uint32_t k = 0u; k < numInstances; ++k)
+                {
+                    hephaestus::Matrix4 instance; instance.SetIdentity();
+                    instance.AffineSetTranslation(hephaestus::Vector3(
+                        instanceStep * ((float)k - 0.5f * (float)(numInstances - 1u)), 0.f, 0.f));
+                    instance.GetRaw(instances[k]);
+                }
+                CHECK_EXIT_MSG(meshPipeline.MeshSetInstances(0u, instances.data(), numInstances),
+                    "Failed to set mesh instances");
+            }
         }
     }
 
-    // render the pipeline
-    CHECK_EXIT_MSG(renderer.RenderPipeline(meshPipeline), "Failed to render pipeline");
-
-    // save the rendered image to a file
+    // images are encoded & written to files by worker threads, so rendering is not blocked by the encoding
+    hephaestus::ImageFileWriter writer;
     {
-        const char* filename = "renderedFrame.jpg";
-
-        uint32_t numChannels = 0u;
-        uint32_t width = 0u;
-        uint32_t height = 0u;
-        renderer.GetDstImageInfo(numChannels, width, height);
-
-        char* imgData = reinterpret_cast<char*>(STBIW_MALLOC(numChannels * width * height));
-        CHECK_EXIT_MSG(renderer.GetDstImageData(imgData), "Failed to read rendered image data");
-
-        stbi_write_jpg(filename, width, height, numChannels, imgData, 100);
+        hephaestus::ImageFileWriter::InitInfo info;
+        info.jpgQuality = jpegQuality;
+        CHECK_EXIT_MSG(writer.Init(info), "Failed to init image file writer");
+    }
 
-        STBIW_FREE(imgData);
+    uint32_t numChannels = 0u;
+    uint32_t width = 0u;
+    uint32_t height = 0u;
+    renderer.GetDstImageInfo(numChannels, width, height);
+    const hephaestus::ImageFileWriter::FileFormat colorFormat = options.jpegOnDevice ?
+        hephaestus::ImageFileWriter::eFILE_FORMAT_JPG_COEFFICIENTS : hephaestus::ImageFileWriter::eFILE_FORMAT_JPG;
+    // the images of the views are consecutive in each output
+    const uint32_t colorViewSize = renderer.GetOutputSize(hephaestus::VulkanUtils::eRENDER_OUTPUT_COLOR) / options.numViews;
+    const uint32_t meshIDOffset = renderer.GetOutputOffset(hephaestus::VulkanUtils::eRENDER_OUTPUT_MESH_ID);
+    const uint32_t numPixels = width * height;
+
+    // render the frames without waiting, each frame is handed to the writer when its readback has completed
+    std::vector<hephaestus::HeadlessRenderer::FrameID> frames(numFrames);
+    for (uint32_t i = 0u; i < numFrames; ++i)
+    {
+        // wait for the frame that used the same slot so that at most numFramesInFlight frames are retained
+        if (i >= numFramesInFlight)
+            renderer.WaitFrame(frames[i - numFramesInFlight]);
+        renderer.ProcessReadbacks();
+
+        std::array<float, 16> matrixData;
+        hephaestus::Matrix3 rotation;
+        rotation.SetFromRotationAxisY(2.f * 3.14159265f * (float)i / (float)numFrames);
+        hephaestus::Matrix4 model; model.SetIdentity();
+        model.AffineSetRotation(rotation);
+        model.GetRaw(matrixData);
+        CHECK_EXIT_MSG(meshPipeline.UpdateModelMatrix(0u, matrixData, renderer.GetCmdBuffer()),
+            "Failed to update mesh model transform");
+
+        const std::string filename = "renderedFrame" + std::to_string(i);
+        CHECK_EXIT_MSG(renderer.RenderPipelineAsync(meshPipeline, frames[i],
+            [&, filename](hephaestus::HeadlessRenderer::FrameID, const char* data, uint32_t) {
+                for (uint32_t v = 0u; v < options.numViews; ++v)
+                {
+                    const std::string viewFilename = 
+                        options.numViews > 1u ? filename + "_view" + std::to_string(v) : filename;
+                    writer.Write(viewFilename + ".jpg", colorFormat, 
+                        data + v * colorViewSize, width, height, numChannels);
+
+                    // background pixels have an invalid mesh ID
+                    if (options.renderOutputs)
+                    {
+                        const uint32_t* meshIDs = 
+                            reinterpret_cast<const uint32_t*>(data + meshIDOffset) + v * numPixels;
+                        std::vector<char> mask(numPixels);
+                        for (uint32_t p = 0u; p < numPixels; ++p)
+                            mask[p] = meshIDs[p] == UINT32_MAX ? '\x00' : '\xff';
+                        writer.Write(viewFilename + "_mask.png", hephaestus::ImageFileWriter::eFILE_FORMAT_PNG,
+                            mask.data(), width, height, 1u);
+                    }
+                }
+            }), "Failed to render pipeline");
     }
 
+    for (hephaestus::HeadlessRenderer::FrameID frameID : frames)
+        renderer.WaitFrame(frameID);
+    renderer.ProcessReadbacks();
+    writer.WaitIdle();
+    CHECK_EXIT_MSG(writer.GetNumFailed() == 0u, "Failed to write rendered images");
+
     renderer.Clear();
 
 
@@ -13,8 +13,6 @@ endif()
 
 add_executable(render-to-file ${CMAKE_CURRENT_LIST_DIR}/RenderOBJToImageFile.cpp)
 
-target_include_directories(render-to-file PRIVATE "${HEPHAESTUS_EXTERNAL_DEPENDENCIES_LOCATION}/stb")
-
 checkTargetExists(hephaestus)
 checkTargetExists(common)
 target_link_libraries(render-to-file PRIVATE hephaestus common ${CMAKE_DL_LIBS})
\ No newline at end of file
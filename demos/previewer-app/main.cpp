@@ -351,6 +351,7 @@ int main(/*int argc, char** argv*/)
             }
             hephaestus::TriMeshPipeline::SetupParams params;
             params.enableFaceCulling = false;
+            params.vertexBufferMode = hephaestus::PipelineBase::eVERTEX_BUFFER_MODE_STATIC;
             CHECK_EXIT_MSG(hephaestus::MeshUtils::SetupPipelineForMesh(
                 mesh, textureData, textureDesc, renderer.GetCmdBuffer(), renderer.GetRenderPass(), 
                 shaderParams, params, renderer.m_graphicsPipeline),
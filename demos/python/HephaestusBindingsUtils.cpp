@@ -2,6 +2,8 @@
 
 #include <common/AxisAlignedBoundingBox.h>
 
+#include <algorithm>
+
 
 // helper macro to check return values & throw an exception if fail
 #define CHECK_EXIT_MSG(expr, msg)	\
@@ -83,6 +85,80 @@ Utils::CopyTriMeshToRenderMeshData(
     return true;
 }
 
+void
+HostImagePool::Clear()
+{
+    if (!m_state)
+        return;
+
+    // releasing waits for the device, the imports are only released here & when the frame size changes
+    for (const Allocation& allocation : m_state->imports)
+        m_renderer.ReleaseHostMemory(allocation.data);
+    for (const Allocation& allocation : m_state->freeAllocations)
+        delete[] allocation.allocation;
+
+    // arrays still alive free their allocations when released
+    m_state->active = false;
+    m_state = std::make_shared<State>();
+}
+
+pybind11::array_t<uint8_t>
+HostImagePool::Acquire(char*& data)
+{
+    const size_t alignment = std::max<size_t>((size_t)m_renderer.GetHostMemoryAlignment(), 1u);
+    const size_t size = (m_renderer.GetFrameDataSize() + alignment - 1u) / alignment * alignment;
+
+    Allocation allocation;
+    while (!m_state->freeAllocations.empty() && allocation.allocation == nullptr)
+    {
+        allocation = m_state->freeAllocations.back();
+        m_state->freeAllocations.pop_back();
+        if (allocation.size != size)
+        {
+            // the frame size has changed (the renderer has been re-initialized)
+            for (size_t i = 0; i < m_state->imports.size(); ++i)
+            {
+                if (m_state->imports[i].data == allocation.data)
+                {
+                    m_renderer.ReleaseHostMemory(allocation.data);
+                    m_state->imports.erase(m_state->imports.begin() + i);
+                    break;
+                }
+            }
+            delete[] allocation.allocation;
+            allocation = Allocation();
+        }
+    }
+
+    if (allocation.allocation == nullptr)
+    {
+        allocation.allocation = new char[size + alignment];
+        allocation.data = allocation.allocation + 
+            (alignment - reinterpret_cast<uintptr_t>(allocation.allocation) % alignment) % alignment;
+        allocation.size = size;
+
+        // falls back to copying from the renderer if the memory cannot be imported
+        if (m_renderer.IsHostMemoryImportSupported() && m_state->imports.size() < MaxImports &&
+            m_renderer.ImportHostMemory(allocation.data, size))
+            m_state->imports.push_back(allocation);
+    }
+
+    // the allocation returns to the pool when the array is released, unless the pool has been cleared
+    pybind11::capsule capsule(new std::pair<std::shared_ptr<State>, Allocation>(m_state, allocation), 
+        [](void* ptr) 
+        {
+            auto* ownerInfo = reinterpret_cast<std::pair<std::shared_ptr<State>, Allocation>*>(ptr);
+            if (ownerInfo->first->active)
+                ownerInfo->first->freeAllocations.push_back(ownerInfo->second);
+            else
+                delete[] ownerInfo->second.allocation;
+            delete ownerInfo;
+        });
+
+    data = allocation.data;
+    return pybind11::array_t<uint8_t>(size, reinterpret_cast<uint8_t*>(allocation.data), capsule);
+}
+
 std::tuple<pybind11::array_t<uint8_t>, uint32_t, uint32_t, uint32_t>
 Utils::ExtractRendererDstImage(const hephaestus::HeadlessRenderer& renderer)
 {
@@ -92,14 +168,35 @@ Utils::ExtractRendererDstImage(const hephaestus::HeadlessRenderer& renderer)
     uint32_t height = 0u;
     renderer.GetDstImageInfo(numChannels, width, height);
 
+    // the copy is the whole frame data (all views & auxiliary outputs), only the color image is exposed
+    auto frameData = pybind11::array_t<uint8_t>(renderer.GetFrameDataSize());
+    pybind11::buffer_info frameDataBufferInfo = frameData.request();
+
+    CHECK_EXIT_MSG(renderer.GetDstImageData(reinterpret_cast<char*>(frameDataBufferInfo.ptr)),
+        "Failed to read rendered image data");
+
     const size_t size = numChannels * width * height;
-    auto imageData = pybind11::array_t<uint8_t>(size);
-    pybind11::buffer_info imageDataBufferInfo = imageData.request();
+    auto imageData = pybind11::array_t<uint8_t>(size, reinterpret_cast<uint8_t*>(frameDataBufferInfo.ptr), frameData);
 
-    // pybind11::print("ExtractRendererDstImage: Loading image with ", numChannels, " channels,", width, " width and ", height, " height");
+    return std::make_tuple(imageData, numChannels, width, height);
+}
 
-    CHECK_EXIT_MSG(renderer.GetDstImageData(reinterpret_cast<char*>(imageDataBufferInfo.ptr)),
-        "Failed to read rendered image data");
+std::tuple<pybind11::array_t<uint8_t>, uint32_t, uint32_t, uint32_t>
+Utils::RenderPipelineToImage(hephaestus::HeadlessRenderer& renderer, HostImagePool& imagePool,
+    const hephaestus::TriMeshPipeline& pipeline)
+{
+    uint32_t numChannels = 0u;
+    uint32_t width = 0u;
+    uint32_t height = 0u;
+    renderer.GetDstImageInfo(numChannels, width, height);
+
+    // the frame data are rendered to the (imported) pool allocation, only the color image is exposed
+    char* data = nullptr;
+    pybind11::array_t<uint8_t> frameData = imagePool.Acquire(data);
+    CHECK_EXIT_MSG(renderer.RenderPipelineToHostMemory(pipeline, data), "Failed to render pipeline");
+
+    const size_t size = numChannels * width * height;
+    auto imageData = pybind11::array_t<uint8_t>(size, reinterpret_cast<uint8_t*>(data), frameData);
 
     return std::make_tuple(imageData, numChannels, width, height);
 }
@@ -30,6 +30,7 @@ struct VulkanSystemInfo
     hephaestus::HeadlessRenderer renderer;
     hephaestus::TriMeshPipeline meshPipeline;
     hephaestus::VulkanUtils::ShaderDB shaderDB;
+    hephaestus_bindings::HostImagePool imagePool;   // declared after the renderer so that it is released first
 
     static VulkanSystemInfo& GetInstance()
     {
@@ -53,7 +54,8 @@ private:
     VulkanSystemInfo() :
         deviceManager(),
         renderer(deviceManager),
-        meshPipeline(deviceManager)
+        meshPipeline(deviceManager),
+        imagePool(renderer)
     {}
 
     static VulkanSystemInfo* s_instance;
@@ -143,6 +145,7 @@ HEPHAESTUS_BINDINGS_Clear()
     VulkanSystemInfo& instance = VulkanSystemInfo::GetInstance();
 
     instance.deviceManager.WaitDevice();
+    instance.imagePool.Clear();
 
     // let the destructor deal with the release of the Vulkan handles
     // make sure that no dynamically allocated Vulkan data are still alive
@@ -280,9 +283,8 @@ HEPHAESTUS_BINDINGS_RenderMesh(const hephaestus_bindings::HEPHAESTUS_BINDINGS_Me
         "Failed to update view and projection matrices");
 
     // render the pipeline
-    CHECK_EXIT_MSG(instance.renderer.RenderPipeline(instance.meshPipeline), "Failed to render pipeline");
-
-    return hephaestus_bindings::Utils::ExtractRendererDstImage(instance.renderer);
+    return hephaestus_bindings::Utils::RenderPipelineToImage(
+        instance.renderer, instance.imagePool, instance.meshPipeline);
 }
 
 pybind11::array_t<uint8_t>
@@ -318,12 +320,13 @@ HEPHAESTUS_BINDINGS_RenderMeshOnImage(const hephaestus_bindings::HEPHAESTUS_BIND
     if (dstHeight != renderHeight || dstWidth != renderWidth || dstNumChannels != renderNumChannels)
         throw std::runtime_error("Invalid destination image shape, should match renderer target width & height");
 
-    // allocate normal buffer
-    auto result = pybind11::array_t<uint8_t>(renderSize);
-    pybind11::buffer_info resultBufferInfo = result.request();
-    char* resImageData = (char*)resultBufferInfo.ptr;
+    // allocate normal buffer, the whole frame data are copied but only the color image is returned
+    auto frameData = pybind11::array_t<uint8_t>(instance.renderer.GetFrameDataSize());
+    pybind11::buffer_info frameDataBufferInfo = frameData.request();
+    char* resImageData = (char*)frameDataBufferInfo.ptr;
 
     CHECK_EXIT_MSG(instance.renderer.GetDstImageData(resImageData), "Failed to read rendered image data");
+    auto result = pybind11::array_t<uint8_t>(renderSize, reinterpret_cast<uint8_t*>(resImageData), frameData);
 
     // combine images
     char* dstData = (char*)dstBufferInfo.ptr;
@@ -9,6 +9,7 @@
 #include <hephaestus/VulkanConfig.h>
 #include <hephaestus/HeadlessRenderer.h>
 
+#include <memory>
 #include <tuple>
 #include <vector>
 
@@ -16,6 +17,45 @@
 namespace hephaestus_bindings
 {
 
+// pool of host allocations for the rendered images returned to python, the allocations are imported by the 
+// renderer once & re-used when the arrays using them are released, so that rendering to them does not need
+// an import (and the device wait of releasing it) per frame
+class HostImagePool
+{
+public:
+    explicit HostImagePool(hephaestus::HeadlessRenderer& renderer) :
+        m_renderer(renderer),
+        m_state(std::make_shared<State>())
+    {}
+
+    ~HostImagePool() { Clear(); }
+    // releases all imports (waits for the device), allocations still used by arrays are freed with the arrays
+    void Clear();
+
+    // returns an array with an allocation of the frame data size, data points to the (aligned) frame data
+    pybind11::array_t<uint8_t> Acquire(char*& data);
+
+private:
+    static const size_t MaxImports = 8u;    // bounds the number of dedicated imported device allocations
+
+    struct Allocation
+    {
+        char*   allocation = nullptr;
+        char*   data = nullptr;             // aligned start of the allocation
+        size_t  size = 0u;
+    };
+    // shared with the arrays so that released allocations return to the pool while it is active
+    struct State
+    {
+        std::vector<Allocation> freeAllocations;
+        std::vector<Allocation> imports;    // imported allocations, free or used by arrays
+        bool                    active = true;
+    };
+
+    hephaestus::HeadlessRenderer&   m_renderer;
+    std::shared_ptr<State>          m_state;
+};
+
 struct Utils
 {
     static bool CopyTriMeshToRenderMeshData(
@@ -24,8 +64,14 @@ struct Utils
             const float* vertexUV,   // optional, same count as vertices
             hephaestus::MeshUtils::TriMesh& mesh);
 
+    // the returned arrays are views of the color image (of the first view) in the frame data
     static std::tuple<pybind11::array_t<uint8_t>, uint32_t, uint32_t, uint32_t>
         ExtractRendererDstImage(const hephaestus::HeadlessRenderer& renderer);
+
+    // renders directly to the memory of the returned array when the renderer supports importing host memory
+    static std::tuple<pybind11::array_t<uint8_t>, uint32_t, uint32_t, uint32_t>
+        RenderPipelineToImage(hephaestus::HeadlessRenderer& renderer, HostImagePool& imagePool,
+            const hephaestus::TriMeshPipeline& pipeline);
 };
 
 struct HEPHAESTUS_BINDINGS_Vec4
@@ -15,6 +15,9 @@ set(HEPHAESTUS_SOURCE_FILES
     ${CMAKE_CURRENT_LIST_DIR}/src/RendererBase.cpp
     ${CMAKE_CURRENT_LIST_DIR}/src/VulkanValidate.cpp
     ${CMAKE_CURRENT_LIST_DIR}/src/VulkanUtils.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/src/VulkanMemoryAllocator.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/src/RangeAllocator.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/src/VulkanUploadManager.cpp
     ${CMAKE_CURRENT_LIST_DIR}/src/SwapChainRenderer.cpp
     ${CMAKE_CURRENT_LIST_DIR}/src/Log.cpp
     ${CMAKE_CURRENT_LIST_DIR}/include/hephaestus/VulkanDeviceManager.h
@@ -26,6 +29,9 @@ set(HEPHAESTUS_SOURCE_FILES
     ${CMAKE_CURRENT_LIST_DIR}/include/hephaestus/RendererBase.h
     ${CMAKE_CURRENT_LIST_DIR}/include/hephaestus/VulkanValidate.h
     ${CMAKE_CURRENT_LIST_DIR}/include/hephaestus/VulkanUtils.h
+    ${CMAKE_CURRENT_LIST_DIR}/include/hephaestus/VulkanMemoryAllocator.h
+    ${CMAKE_CURRENT_LIST_DIR}/include/hephaestus/RangeAllocator.h
+    ${CMAKE_CURRENT_LIST_DIR}/include/hephaestus/VulkanUploadManager.h
     ${CMAKE_CURRENT_LIST_DIR}/include/hephaestus/SwapChainRenderer.h
     ${CMAKE_CURRENT_LIST_DIR}/include/hephaestus/VulkanConfig.h
     ${CMAKE_CURRENT_LIST_DIR}/include/hephaestus/Platform.h
@@ -5,32 +5,115 @@
 #include <hephaestus/VulkanDeviceManager.h>
 #include <hephaestus/VulkanUtils.h>
 
+#include <array>
+#include <functional>
+#include <vector>
+
 
 namespace hephaestus
 {
 class PipelineBase;
 
 // Renderer class for targeting a windowless image buffer (headless)
+// - frames are rendered to a ring of slots, each with its own render target, readback buffer, command buffer
+//   & fence, so that the host can record the next frame while the device renders the previous ones
+// - readback buffers are host cached buffers with the frame image tightly packed (RGBA rows), so a frame can be
+//   handed out as a single contiguous block
+// - the copy to the readback buffer is recorded in the same command buffer right after the render pass, so each
+//   frame is a single submission with a single fence
+// - a frame is only waited on when its slot is re-used or when the image of the frame is read back
+// - readback buffers come from a pool, a frame keeps its readback buffer until its slot is re-used (i.e. it should
+//   be read before numFramesInFlight more frames are rendered) unless it is retained, in which case the image
+//   is kept until the frame is released or its completion callback has been called
+// - optionally multiple views (e.g. camera poses) are rendered in a single pass (multiview) to the layers of the
+//   frame image, all views are read back with one copy & the images of the views are consecutive in the frame data
+// - optionally auxiliary outputs (depth, normals, mesh ID) are rendered in the same pass as the color to extra 
+//   attachments & read back with the color, the frame data are the color followed by the enabled outputs
+// - outputs larger than the extent (e.g. beyond the device image limits) can be rendered as tiles of the extent,
+//   each tile is rendered through a sub-frustum of the projection & streamed to a sink, so memory usage only
+//   depends on the extent
+// - optionally the color output is converted by a compute shader (see convert.comp) before readback, e.g. to
+//   RGB, BGR or single channel pixels, sRGB/linear, flipped vertically, so that less data are read back, or
+//   encoded to quantized JPEG DCT coefficients (see jpeg_dct.comp) that only need entropy coding on the host
+// - optionally (VK_EXT_external_memory_host) caller allocated host memory can be imported & used as the destination
+//   of the frame copy instead of a readback buffer, so the frame lands directly in the caller's memory
+// Not thread safe, readbacks should be polled/waited from the rendering thread (e.g. with ProcessReadbacks()),
+// callbacks can then pass the data on to other threads.
 class HeadlessRenderer : public RendererBase
 {
 public:
+    using FrameID = uint64_t;
+    static const FrameID InvalidFrameID = UINT64_MAX;
+
+    // called with the mapped data of a completed frame (size bytes of tightly packed RGBA rows or converted color,
+    // followed by the enabled auxiliary outputs, see GetOutputOffset()), the data are only valid during the call
+    using ReadbackCallback = std::function<void(FrameID frameID, const char* data, uint32_t size)>;
 
     HeadlessRenderer(const VulkanDeviceManager& deviceManager) :
         RendererBase(deviceManager)
     {}
 
+    enum ColorSpaceConversion : uint32_t
+    {
+        eCOLOR_SPACE_CONVERSION_NONE = 0,
+        eCOLOR_SPACE_CONVERSION_LINEAR_TO_SRGB,
+        eCOLOR_SPACE_CONVERSION_SRGB_TO_LINEAR
+    };
+
+    enum ColorEncoding : uint32_t
+    {
+        eCOLOR_ENCODING_PIXELS = 0,         // tightly packed pixels (convert.comp)
+        // baseline JPEG coefficients (jpeg_dct.comp), YCbCr 4:2:0, for each 16x16 MCU in raster order the 4 Y, 
+        // Cb & Cr blocks, each a slot of JpegBlockWords with a 64bit mask of the non zero quantized coefficients
+        // in zigzag order followed by their values (int16), i.e. at most GetJpegCoefficientsSize() per view but 
+        // only the masks & the non zero values are written
+        eCOLOR_ENCODING_JPEG_COEFFICIENTS
+    };
+
+    // conversion of the color output on the device before readback
+    struct ColorConversionInfo
+    {
+        vk::ShaderModule shader;            // compute shader doing the conversion, null to disable
+        ColorEncoding encoding = eCOLOR_ENCODING_PIXELS;   // should match the shader
+        uint32_t numChannels = 4u;          // 1 (luminance), 3 or 4, pixels are tightly packed bytes
+        uint32_t jpegQuality = 90u;         // [1, 100] scaling of the standard JPEG quantization tables
+        bool swizzleBGR = false;            // BGR(A) channel order
+        bool flipY = false;                 // first row is the bottom of the image
+        ColorSpaceConversion colorSpace = eCOLOR_SPACE_CONVERSION_NONE;
+    };
+
     struct InitInfo : public RendererBase::InitInfo
     {
         uint32_t width = 1024u;
         uint32_t height = 1024u;
+        uint32_t numFramesInFlight = 1u;    // number of slots, rendered pipelines should be setup with at least
+                                            // as many frames in flight
+        uint32_t maxReadbackBuffers = 8u;   // max size of the readback buffer pool (at least numFramesInFlight)
+        uint32_t numViews = 1u;             // views rendered by each frame, more than one requires multiview support
+                                            // & rendered pipelines should be setup with the same number of views
+        // auxiliary outputs, rendered pipelines should write all outputs (e.g. TriMeshPipeline with renderOutputs)
+        bool depthOutput = false;
+        bool normalOutput = false;
+        bool meshIDOutput = false;
+        ColorConversionInfo colorConversion;
     };
     bool Init(const InitInfo& info);
     void Clear();
     const vk::Extent2D& GetExtent() const { return m_extent; }
+    uint32_t GetNumFramesInFlight() const { return (uint32_t)m_frameSlots.size(); }
+    uint32_t GetNumViews() const { return m_numViews; }
+    bool IsOutputEnabled(VulkanUtils::RenderOutput output) const { return m_outputSizes[output] > 0u; }
+    // size of all the data of a frame & offset of each output in the data (images of all views are consecutive)
+    uint32_t GetFrameDataSize() const { return m_frameDataSize; }
+    uint32_t GetOutputOffset(VulkanUtils::RenderOutput output) const { return m_outputOffsets[output]; }
+    uint32_t GetOutputSize(VulkanUtils::RenderOutput output) const { return m_outputSizes[output]; }
 
 
+    // waits for the next slot to be available & starts recording in its command buffer
     bool RenderBegin(VulkanUtils::FrameUpdateInfo& frameInfo) const;
-    bool RenderEnd(const VulkanUtils::FrameUpdateInfo& frameInfo) const;
+    // records the copy to the readback buffer (or to hostData if it is imported host memory) & submits the frame
+    // without waiting for the device
+    bool RenderEnd(const VulkanUtils::FrameUpdateInfo& frameInfo, const char* hostData = nullptr) const;
 
     // util to render single pipeline of any type
     // only requirement is that the passed types support a method with signature
@@ -44,24 +127,254 @@ public:
 
         pipeline.RecordDrawCommands(frameInfo);
 
-        if (!RenderEnd(frameInfo))
+        return RenderEnd(frameInfo);
+    }
+
+    // same as above but does not wait for the frame, the frame is retained & its ID is returned as the handle
+    // for the async readback API below, if a callback is given it is called by ProcessReadbacks()
+    template<typename PipelineType>
+    bool RenderPipelineAsync(const PipelineType& pipeline, FrameID& frameID, ReadbackCallback callback = nullptr) const
+    {
+        if (!RenderPipeline(pipeline))
+            return false;
+
+        frameID = GetLastFrameID();
+        return RetainFrame(frameID, std::move(callback));
+    }
+
+    // renders & waits for the frame, the image is copied by the device tightly packed (RGBA rows) directly to data
+    // if it has been imported with ImportHostMemory(), otherwise falls back to copying from the readback buffer
+    template<typename PipelineType>
+    bool RenderPipelineToHostMemory(const PipelineType& pipeline, char* data) const
+    {
+        VulkanUtils::FrameUpdateInfo frameInfo;
+        if (!RenderBegin(frameInfo))
+            return false;
+
+        pipeline.RecordDrawCommands(frameInfo);
+
+        if (!RenderEnd(frameInfo, data))
+            return false;
+
+        return FindHostMemoryImport(data) != nullptr ? 
+            WaitFrame(GetLastFrameID()) : GetFrameImageData(GetLastFrameID(), data);
+    }
+
+    // region of a tile in the output image of tiled rendering, tiles at the right & bottom edges are cropped
+    struct TileInfo
+    {
+        uint32_t x = 0u;                // offset of the tile in the output image
+        uint32_t y = 0u;
+        uint32_t width = 0u;            // size of the tile in the output image, at most the renderer extent
+        uint32_t height = 0u;
+        uint32_t outputWidth = 0u;      // size of the output image
+        uint32_t outputHeight = 0u;
+    };
+    // called before rendering a tile to setup the pipelines (e.g. set the tile projection matrix)
+    using TileSetupCallback = std::function<bool(const TileInfo& tile)>;
+    // called with the color pixels of a rendered tile, data points to the top row of the tile & rows are rowPitch
+    // bytes apart (negative if the rows are flipped), only the first tile.width pixels of each row & the first 
+    // tile.height rows are part of the output image
+    using TileSinkCallback = std::function<void(const TileInfo& tile, const char* data, int32_t rowPitch)>;
+
+    // renders an output image of any size as tiles of the extent, tiles are pipelined & passed to the sink as
+    // they complete, fails for frames without rows of pixels (JPEG coefficients) or with multiple views
+    template<typename PipelineType>
+    bool RenderPipelineTiled(const PipelineType& pipeline, uint32_t outputWidth, uint32_t outputHeight,
+        const TileSetupCallback& setup, const TileSinkCallback& sink) const
+    {
+        uint32_t topRowOffset = 0u;
+        int32_t rowPitch = 0;
+        if (!GetTileRowLayout(topRowOffset, rowPitch))
             return false;
 
-        CopyRenderFrame();
+        const uint32_t numTiles = GetNumTiles(outputWidth, outputHeight);
+        std::vector<FrameID> tileFrames(numTiles, InvalidFrameID);
+        bool success = true;
+        for (uint32_t i = 0u; success && i < numTiles; ++i)
+        {
+            // wait for the tile that used the same slot so that at most numFramesInFlight tiles are retained
+            const uint32_t numFramesInFlight = GetNumFramesInFlight();
+            if (i >= numFramesInFlight && !WaitFrame(tileFrames[i - numFramesInFlight]))
+                success = false;
+            ProcessReadbacks();
+
+            const TileInfo tile = GetTileInfo(i, outputWidth, outputHeight);
+            success = success && setup(tile) && RenderPipelineAsync(pipeline, tileFrames[i], 
+                [tile, topRowOffset, rowPitch, &sink](FrameID, const char* data, uint32_t) 
+                { sink(tile, data + topRowOffset, rowPitch); });
+        }
+
+        if (success && numTiles > 0u)
+            success = WaitFrame(tileFrames.back());
+        ProcessReadbacks();
+
+        // tiles that have not been passed to the sink
+        for (FrameID frameID : tileFrames)
+            ReleaseFrame(frameID);
 
-        return true;
+        return success;
     }
 
-    void CopyRenderFrame() const;
+    uint32_t GetNumTiles(uint32_t outputWidth, uint32_t outputHeight) const;
+    TileInfo GetTileInfo(uint32_t tileIndex, uint32_t outputWidth, uint32_t outputHeight) const;
+    // projection matrix (column major) for rendering the sub-frustum of the tile with the renderer extent
+    std::array<float, 16> GetTileProjectionMatrix(const std::array<float, 16>& projection, const TileInfo& tile) const;
+
+    FrameID GetLastFrameID() const { return m_nextFrameID - 1u; }
     bool GetDstImageInfo(uint32_t& numChannels, uint32_t& width, uint32_t& height) const;
+    // size of the JPEG coefficient slots of a width x height image (eCOLOR_ENCODING_JPEG_COEFFICIENTS)
+    static const uint32_t JpegBlockWords = 2u + 32u;    // non zero mask & up to 64 int16 values
+    static uint32_t GetJpegCoefficientsSize(uint32_t width, uint32_t height)
+    {
+        return ((width + 15u) / 16u) * ((height + 15u) / 16u) * 6u * JpegBlockWords * (uint32_t)sizeof(uint32_t);
+    }
+    // waits for the last rendered frame & copies the frame data
     bool GetDstImageData(char* data) const;
+    // same for any previous frame, fails if the readback buffer of the frame has been re-used
+    bool GetFrameImageData(FrameID frameID, char* data) const;
+    // same but only copies the data of a single output
+    bool GetFrameOutputData(FrameID frameID, VulkanUtils::RenderOutput output, char* data) const;
+
+    // async readback API
+    // keeps the readback buffer of the frame until ReleaseFrame() (or until the callback has been called)
+    bool RetainFrame(FrameID frameID, ReadbackCallback callback = nullptr) const;
+    void ReleaseFrame(FrameID frameID) const;
+    bool IsFrameComplete(FrameID frameID) const;    // non blocking
+    bool WaitFrame(FrameID frameID, uint64_t timeout = UINT64_MAX) const;
+    // calls the callbacks of all completed retained frames & releases them, returns the number of processed frames
+    uint32_t ProcessReadbacks() const;
+
+    // host memory import API, both the address & the size of the memory should be aligned to 
+    // GetHostMemoryAlignment() and the size should fit a frame image
+    bool IsHostMemoryImportSupported() const { return m_hostMemoryAlignment > 0u; }
+    VkDeviceSize GetHostMemoryAlignment() const { return m_hostMemoryAlignment; }
+    bool ImportHostMemory(char* data, VkDeviceSize size);
+    void ReleaseHostMemory(const char* data);   // waits for the device since the memory may be used by frames in flight
 
 private:
 
+    struct FrameSlot
+    {
+        VulkanUtils::ImageInfo              frameImageInfo; // image to use as render target
+        std::array<VulkanUtils::ImageInfo, VulkanUtils::eRENDER_OUTPUT_COUNT> auxImageInfos; // enabled aux outputs
+        VulkanUtils::ImageInfo              depthImageInfo;
+        VulkanUtils::ImageViewHandle        conversionView; // array view of the frame image read by the conversion
+        VulkanUtils::DescriptorSetHandle    conversionDescSet;
+        VulkanUtils::FramebufferHandle      framebuffer;    // buffer for the rendered frame during command buffer processing
+        VulkanUtils::CommandBufferHandle    cmdBuffer;      // draw & readback commands of the frame
+        VulkanUtils::FenceHandle            fence;          // signaled when the frame has been copied to the readback buffer
+        mutable FrameID                     frameID = InvalidFrameID;   // frame rendered in the slot
+        mutable bool                        submitted = false;
+        mutable uint32_t                    readbackIndex = UINT32_MAX; // readback buffer used by the frame
+
+        void Clear()
+        {
+            fence.reset(nullptr);
+            cmdBuffer.reset(nullptr);
+            framebuffer.reset(nullptr);
+            depthImageInfo.Clear();
+            conversionDescSet.reset(nullptr);
+            conversionView.reset(nullptr);
+            for (VulkanUtils::ImageInfo& auxImageInfo : auxImageInfos)
+                auxImageInfo.Clear();
+            frameImageInfo.Clear();
+            frameID = InvalidFrameID;
+            submitted = false;
+            readbackIndex = UINT32_MAX;
+        }
+    };
+
+    struct ReadbackBuffer
+    {
+        VulkanUtils::BufferInfo bufferInfo;     // persistently mapped, host cached if available
+        FrameID                 frameID = InvalidFrameID;
+        bool                    inUse = false;
+        bool                    retained = false;
+        ReadbackCallback        callback;
+
+        void Clear()
+        {
+            bufferInfo.Clear();
+            frameID = InvalidFrameID;
+            inUse = false;
+            retained = false;
+            callback = nullptr;
+        }
+    };
+
+    struct HostMemoryImport
+    {
+        const char*                     data = nullptr;
+        VkDeviceSize                    size = 0u;
+        VulkanUtils::DeviceMemoryHandle memory;         // declared first so that the buffer is destroyed first
+        VulkanUtils::BufferHandle       bufferHandle;   // buffer bound to the imported memory
+
+        void Clear()
+        {
+            bufferHandle.reset(nullptr);
+            memory.reset(nullptr);
+            data = nullptr;
+            size = 0u;
+        }
+    };
+
+    bool GetTileRowLayout(uint32_t& topRowOffset, int32_t& rowPitch) const;
+    bool CreateFrameSlot(const InitInfo& info, FrameSlot& slot);
+    bool CreateOutputImage(const InitInfo& info, vk::Format format, VulkanUtils::ImageInfo& imageInfo,
+        vk::ImageUsageFlags extraUsage = vk::ImageUsageFlags());
+    bool CreateConversionPipeline(const InitInfo& info);
+    bool CreateConversionDescriptorSet(const InitInfo& info, FrameSlot& slot);
+    void RecordConversionCommands(const FrameSlot& slot, vk::Buffer dstBuffer, vk::CommandBuffer cmdBuffer) const;
+    bool IsConversionEnabled() const { return (bool)m_conversionPipeline; }
+    vk::BufferUsageFlags GetReadbackBufferUsage() const;
+    const VulkanUtils::ImageInfo& GetOutputImage(const FrameSlot& slot, VulkanUtils::RenderOutput output) const;
+    bool CreateReadbackBuffer(ReadbackBuffer& readbackBuffer) const;
+    bool AcquireReadbackBuffer(uint32_t& readbackIndex) const;
+    ReadbackBuffer* FindReadbackBuffer(FrameID frameID) const;
+    const FrameSlot* FindFrameSlot(FrameID frameID) const;
+    const HostMemoryImport* FindHostMemoryImport(const char* data) const;
+    void RecordFrameImageBarrier(const FrameSlot& slot, vk::CommandBuffer cmdBuffer) const;
+    void RecordCopyCommands(const FrameSlot& slot, vk::Buffer dstBuffer, vk::CommandBuffer cmdBuffer) const;
+    bool CopyFrameData(FrameID frameID, uint32_t offset, uint32_t size, char* data) const;
+    const char* MapReadbackBuffer(const ReadbackBuffer& readbackBuffer) const;
+
     vk::Extent2D                    m_extent;           // size of the rendered target
-    VulkanUtils::FramebufferHandle  m_framebuffer;      // buffer for the rendered frame during command buffer processing
-    VulkanUtils::ImageInfo          m_frameImageInfo;   // image to use as render target
-    VulkanUtils::ImageInfo          m_dstImageInfo;     // image that can be loaded from host memory
+    uint32_t                        m_numViews = 1u;    // layers of the rendered target
+    std::array<uint32_t, VulkanUtils::eRENDER_OUTPUT_COUNT> m_outputOffsets = {};  // offsets in the frame data
+    std::array<uint32_t, VulkanUtils::eRENDER_OUTPUT_COUNT> m_outputSizes = {};    // 0 for disabled outputs
+    uint32_t                        m_frameDataSize = 0u;
+
+    // color conversion
+    struct ConversionPushConstants
+    {
+        uint32_t width;
+        uint32_t height;
+        uint32_t numChannels;
+        uint32_t wordsPerLayer;     // 32bit words of the converted data of each view
+        uint32_t swizzleBGR;
+        uint32_t flipY;
+        uint32_t colorSpace;
+        uint32_t jpegQuality;
+    };
+    ColorEncoding                           m_colorEncoding = eCOLOR_ENCODING_PIXELS;
+    ConversionPushConstants                 m_conversionParams = {};
+    VulkanUtils::SamplerHandle              m_conversionSampler;
+    VulkanUtils::DescriptorPoolHandle       m_conversionDescPool;
+    VulkanUtils::DescriptorSetLayoutHandle  m_conversionDescSetLayout;
+    VulkanUtils::PipelineLayoutHandle       m_conversionPipelineLayout;
+    VulkanUtils::PipelineHandle             m_conversionPipeline;
+    std::vector<FrameSlot>          m_frameSlots;
+    mutable uint32_t                m_nextSlot = 0u;    // slot used by the next rendered frame
+    mutable uint32_t                m_lastRenderedSlot = UINT32_MAX;
+    mutable FrameID                 m_nextFrameID = 0u;
+    mutable FrameID                 m_numCompletedFrames = 0u;  // all frames with lower IDs have completed
+
+    mutable std::vector<ReadbackBuffer>  m_readbackBuffers;   // pool of readback buffers, grows on demand
+    uint32_t                            m_maxReadbackBuffers = 0u;
+
+    std::vector<HostMemoryImport>   m_hostMemoryImports;
+    VkDeviceSize                    m_hostMemoryAlignment = 0u; // 0 if host memory import is not supported
 };
 
-} // namespace hephaestus
\ No newline at end of file
+} // namespace hephaestus
@@ -2,16 +2,22 @@
 
 #include <hephaestus/Compiler.h>
 #include <hephaestus/VulkanConfig.h>
+#include <hephaestus/RangeAllocator.h>
 #include <hephaestus/VulkanDeviceManager.h>
 #include <hephaestus/VulkanUtils.h>
 
+#include <algorithm>
+
 
 namespace hephaestus
 {
 // Base class acting as a helper for writing graphics pipelines
 // - stage buffer to re-use
-// - vertex buffer
+// - tracking of the staged uploads submitted to the upload manager
+// - vertex buffer, either static (device local), dynamic (host visible) or streamed (per frame in flight),
+//   grows automatically when there is not enough space for new vertex data
 // - descriptor pool
+// - retired resources, released by the pipeline but destroyed only once the frames in flight are done with them
 class PipelineBase
 {
 public:
@@ -28,30 +34,117 @@ public:
                                                                     // that should be used as the fragment shader
     };
 
+    // usage of the vertex buffer, defines the type of memory used & how vertex data are updated
+    enum VertexBufferMode : uint32_t
+    {
+        eVERTEX_BUFFER_MODE_STATIC = 0,     // device local, data are staged through the upload manager
+        eVERTEX_BUFFER_MODE_DYNAMIC,        // host visible & persistently mapped, data are updated in place
+        eVERTEX_BUFFER_MODE_STREAM,         // host visible with a region per frame in flight, data are kept in a
+                                            // host copy & written to the region of a frame when recording it
+
+        eVERTEX_BUFFER_MODE_COUNT
+    };
+
     explicit PipelineBase(const VulkanDeviceManager& _deviceManager) :
         m_deviceManager(_deviceManager),
-        m_vertexBufferCurSize(0u)
+        m_vertexBufferMode(eVERTEX_BUFFER_MODE_DYNAMIC),
+        m_vertexBufferCurSize(0u),
+        m_vertexStreamVersion(0u),
+        m_lastUploadTicket(VulkanUploadManager::InvalidTicket),
+        m_retireVersion(0u)
     {}
     virtual ~PipelineBase() { Clear(); }
 
     void Clear();
 
     // buffer setup & update
-    void CreateDescriptorPool(uint32_t uniformSize = 5u, uint32_t combinedImgSamplerSize = 5u);
+    void CreateDescriptorPool(uint32_t uniformSize = 5u, uint32_t combinedImgSamplerSize = 5u, 
+        uint32_t dynamicUniformSize = 5u, uint32_t dynamicStorageSize = 2u);
     void CreateStageBuffer(uint32_t stageSize = 1000000u);
-    bool CreateVertexBuffer(uint32_t size);
+    // numFramesInFlight is only used by streamed buffers & should be at least the number of frames of the renderer,
+    // size is only the initial size, the buffer grows when needed so it does not need to fit all the vertex data
+    bool CreateVertexBuffer(uint32_t size, VertexBufferMode mode = eVERTEX_BUFFER_MODE_DYNAMIC, 
+        uint32_t numFramesInFlight = 3u);
+    // appends data after the last vertex data in the buffer, unless space has been freed by the pipeline
     bool AppendVertexData(const VulkanUtils::BufferUpdateInfo& updateInfo);
 
+    // staged uploads complete asynchronously, commands submitted to the graphics queue afterwards are ordered
+    // after them so waiting is only required before accessing the uploaded resources from the host
+    bool IsUploadComplete() const;
+    bool WaitUploads() const;
+
     // internal
     vk::DescriptorPool GetDescriptorPool() const { return m_descriptorPool.get(); }
     const VulkanUtils::BufferInfo& GetVertexBufferInfo() const { return m_vertexBufferInfo; }
+    VertexBufferMode GetVertexBufferMode() const { return m_vertexBufferMode; }
     const VulkanDeviceManager& GetDeviceManager() const { return m_deviceManager; }
 
 protected:
+    // range of data in a buffer (in bytes)
+    struct DataRange
+    {
+        VkDeviceSize offset;
+        VkDeviceSize size;
+    };
+
+    // vertex buffers of all modes are copied by the device when they are moved to a new buffer
+    static vk::BufferUsageFlags GetVertexBufferUsage()
+    {
+        return vk::BufferUsageFlagBits::eVertexBuffer | 
+            vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst;
+    }
 
     void GetShaderModules(const PipelineBase::ShaderParams& shaderParams,
         vk::ShaderModule& vertexShaderModule, vk::ShaderModule& fragmentShaderModule);
 
+    // write to the vertex buffer (offset in bytes) depending on its mode
+    bool WriteVertexData(const VulkanUtils::BufferUpdateInfo& updateInfo, VkDeviceSize offset);
+    // returns the offset of the vertex data used by the frame, for streamed buffers the region of
+    // the frame is also updated if the vertex data have changed since it was last used
+    VkDeviceSize PrepareVertexBufferFrame(uint32_t frameIndex) const;
+
+    // vertex data are sub-allocated from the vertex buffer so that freed ranges can be re-used
+    bool AllocateVertexData(const VulkanUtils::BufferUpdateInfo& updateInfo, VkDeviceSize alignment, 
+        VkDeviceSize& offset);
+    // the range is retired, so it is not re-used while frames in flight may still read it
+    void FreeVertexData(VkDeviceSize offset, VkDeviceSize size);
+    // moves the ranges (sorted by offset) to the start of the vertex buffer & updates their offsets,
+    // the device must not be using the vertex buffer
+    bool CompactVertexData(std::vector<DataRange>& ranges, VkDeviceSize alignment);
+
+    // grows the vertex buffer geometrically so that it has at least minSize bytes, offsets of existing data
+    // remain valid & the previous buffer is retired
+    bool GrowVertexBuffer(VkDeviceSize minSize);
+    static VkDeviceSize GetGrowSize(VkDeviceSize curSize, VkDeviceSize minSize)
+    {
+        return std::max(GrowthFactor * curSize, minSize);
+    }
+
+    // helpers for compacting & growing buffers, returns the size of the packed data & the copy regions for all ranges
+    static VkDeviceSize PackDataRanges(RangeAllocator& allocator, std::vector<DataRange>& ranges, 
+        VkDeviceSize alignment, std::vector<vk::BufferCopy>& regions);
+    // replaces a device local (or persistently mapped host visible) buffer with a new one, copying the regions from 
+    // the old buffer with the device, waits for the copy so that the new buffer can be written & retires the old one
+    bool ReallocateDeviceBuffer(VulkanUtils::BufferInfo& bufferInfo, uint32_t size, vk::BufferUsageFlags usage,
+        const std::vector<vk::BufferCopy>& regions, vk::AccessFlags dstAccessMask, vk::PipelineStageFlags dstStageMask,
+        bool hostVisible = false);
+
+    // resources that may be used by frames in flight are retired instead of destroyed, they are destroyed once every
+    // frame has been recorded again (the renderer waits for the previous use of a frame before recording it) & 
+    // the upload with the given ticket has completed, ranges are freed back to their allocator at the same time
+    void RetireBuffer(VulkanUtils::BufferInfo& bufferInfo, 
+        VulkanUploadManager::Ticket ticket = VulkanUploadManager::InvalidTicket);
+    void RetireImage(VulkanUtils::ImageInfo& imageInfo, 
+        VulkanUploadManager::Ticket ticket = VulkanUploadManager::InvalidTicket);
+    void RetireDescriptorSet(VulkanUtils::DescriptorSetInfo& descSetInfo);
+    void RetireRange(RangeAllocator& allocator, VkDeviceSize offset, VkDeviceSize size);
+    // called when recording a frame, destroys the retired resources that are not used by any frame anymore
+    void ReleaseRetiredResources(uint32_t frameIndex) const;
+    // destroys all the retired resources, the device must not be using them
+    void ReleaseAllRetiredResources();
+
+    static const VkDeviceSize GrowthFactor = 2u;
+
     const VulkanDeviceManager& m_deviceManager;
 
     // descriptor pool 
@@ -60,10 +153,37 @@ protected:
     // data buffers
     VulkanUtils::BufferInfo m_stageBufferInfo;	// stage buffer for temporary data
     VulkanUtils::BufferInfo m_vertexBufferInfo;
-    VkDeviceSize m_vertexBufferCurSize; // size of data (in byte) currently set in the vertex buffer
+    VertexBufferMode m_vertexBufferMode;
+    VkDeviceSize m_vertexBufferCurSize; // end (in bytes) of the data currently set in the vertex buffer
+    RangeAllocator m_vertexRanges;      // ranges of the vertex buffer used by the pipeline data
+
+    // host copy of the streamed vertex data & versions of the data in each frame region of the buffer
+    std::vector<char> m_vertexStreamData;
+    uint64_t m_vertexStreamVersion;
+    mutable std::vector<uint64_t> m_vertexStreamFrameVersions;
+
+    VulkanUploadManager::Ticket m_lastUploadTicket; // ticket of the last upload submitted for the pipeline resources
+
+    // retired resources with the retire version when they were released, a single resource is set in each entry
+    struct RetiredResource
+    {
+        uint64_t                        version = 0u;
+        VulkanUploadManager::Ticket     ticket = VulkanUploadManager::InvalidTicket;
+        VulkanUtils::BufferInfo         bufferInfo;
+        VulkanUtils::ImageInfo          imageInfo;
+        VulkanUtils::DescriptorSetInfo  descriptorSetInfo;
+        RangeAllocator*                 allocator = nullptr;
+        DataRange                       range = {};
+    };
+    uint64_t m_retireVersion;   // incremented on every retired resource
+    mutable std::vector<uint64_t> m_retireFrameVersions;    // retire version when each frame was last recorded
+    mutable std::vector<RetiredResource> m_retiredResources;
 
 
 private: 
+    void AddRetiredResource(RetiredResource&& resource);
+    void ReleaseCompletedResources() const;
+
     // non-copyable
     PipelineBase(const PipelineBase&) = delete;
     void operator=(const PipelineBase&) = delete;
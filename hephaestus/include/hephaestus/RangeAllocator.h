@@ -0,0 +1,51 @@
+#pragma once
+
+#include <hephaestus/Compiler.h>
+
+#include <vector>
+
+
+namespace hephaestus
+{
+// Utility for sub-allocating ranges from a linear space of fixed size
+// - first fit search over a list of free ranges (sorted by offset)
+// - alignment aware, any padding introduced by the alignment stays in the free list
+// - freed ranges are merged with their neighbours so that they can be re-used
+// Only keeps track of offsets, does not own any memory
+class RangeAllocator
+{
+public:
+    using SizeType = uint64_t;
+    static const SizeType InvalidOffset = UINT64_MAX;
+
+    RangeAllocator() = default;
+    explicit RangeAllocator(SizeType size) { Init(size); }
+
+    void Init(SizeType size);
+    void Clear();
+
+    // returns InvalidOffset if there is no free range that can fit the requested size
+    SizeType Allocate(SizeType size, SizeType alignment = 1u);
+    // same search as Allocate() without allocating
+    bool CanAllocate(SizeType size, SizeType alignment = 1u) const;
+    void Free(SizeType offset, SizeType size);
+    // extends the managed space, the new space is added as free at the end
+    void Grow(SizeType newSize);
+
+    SizeType GetSize() const { return m_size; }
+    SizeType GetFreeSize() const { return m_freeSize; }
+    bool IsEmpty() const { return m_freeSize == m_size; }
+
+private:
+    struct Range
+    {
+        SizeType offset;
+        SizeType size;
+    };
+
+    std::vector<Range>  m_freeRanges;   // sorted by offset, adjacent ranges are always merged
+    SizeType            m_size = 0u;    // total size of the managed space
+    SizeType            m_freeSize = 0u;
+};
+
+} // hephaestus
@@ -5,6 +5,7 @@
 #include <hephaestus/VulkanUtils.h>
 
 #include <array>
+#include <vector>
 
 
 namespace hephaestus
@@ -30,6 +31,8 @@ protected:
         vk::ImageLayout outputImageLayout;
         vk::Format colorFormat = vk::Format::eR8G8B8A8Unorm;
         Color4 colorClearValues = { { 0.7f, 0.88f, 0.9f, 1.0f } };
+        uint32_t numViews = 1u;     // views rendered by the render pass with multiview
+        std::vector<vk::Format> auxFormats; // extra color attachments, see VulkanUtils::CreateRenderPass()
     };
     bool Init(const InitInfo& info);
     void Clear();
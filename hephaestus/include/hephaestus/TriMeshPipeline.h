@@ -13,13 +13,32 @@ namespace hephaestus
 {
 // Graphics pipeline that renders multiple (sub)meshes
 // - position/normal/uv/color vertex buffer
-// - projection & view matrix (using a uniform buffer)
+// - projection & view matrix (using a uniform buffer with a region per frame in flight)
+// - per mesh model matrix (using a single uniform buffer for all meshes, addressed with dynamic offsets)
+// - meshes can be removed, their vertex & index ranges are re-used by new meshes and the shared buffers
+//   can be compacted to remove the gaps left by removed meshes
+// - vertex & index buffers grow geometrically when new mesh data do not fit, mesh offsets remain valid
+// - optionally multiple views (multiview), the scene uniform data are followed by per view matrices that are
+//   indexed by the view index in the shader (see mesh_multiview.vert)
+// - optionally writes the auxiliary render outputs (see mesh_aux.frag), the ID of each mesh is passed to the
+//   shaders as a push constant
+// - optionally all visible meshes are drawn with indirect draws (a single multi draw if supported), the draw
+//   commands are kept in a buffer with a region per frame in flight that is only updated when the visibility or
+//   the data ranges of the meshes change, the shaders read the model transforms from a storage buffer indexed by
+//   the mesh ID (first instance of the draw) so there are no descriptor bindings per mesh (see mesh_indirect.vert)
+// - optionally meshes are drawn as multiple instances with a single draw, the instance transforms of all meshes
+//   are packed in a vertex buffer with instance input rate & a region per frame in flight (see mesh_instanced.vert)
+// - optionally with indirect draws, the textures of all meshes are in a single array descriptor (bindless) indexed
+//   by the mesh ID so draws of meshes with different textures are merged (see mesh_indirect_bindless.frag)
+// - optionally the model matrix & a material index of each mesh are recorded as push constants, so there is no
+//   mesh uniform buffer & the mesh descriptor sets only have the texture (see mesh_pushconstants.vert)
 class TriMeshPipeline : public PipelineBase
 {
 public:
     using Matrix4x4f = std::array<float, 16>;
     using Vector4f = std::array<float, 4>;
     using MeshIDType = uint32_t;
+    static const MeshIDType InvalidMeshID = UINT32_MAX;
 
     struct VertexData
     {
@@ -37,55 +56,170 @@ public:
     // [32-47] -> 16 float misc shader data (e.g. light source position)
     using SceneUBData = VulkanUtils::UniformBufferData<48u * sizeof(float)>;
 
-    // uniform buffer data per mesh (model transform)
+    // uniform data per view with multiview, stored after the scene data for MaxNumViews views
     // [0-15]  -> 4x4 projection matrix
-    using MeshUBData = VulkanUtils::UniformBufferData<16u * sizeof(float)>;
+    // [16-31] -> 4x4 camera/view matrix
+    using ViewUBData = std::array<char, 32u * sizeof(float)>;
+    static const uint32_t MaxNumViews = 32u;
+
+    // push constant data per mesh
+    struct MeshPushConstants
+    {
+        MeshIDType meshID;
+    };
+
+    // push constant data per mesh with push constant transforms, starts with the same data as MeshPushConstants
+    // so the fragment shaders are the same, the matrix is aligned to 16 bytes as in the shader block
+    struct MeshTransformPushConstants
+    {
+        MeshIDType  meshID;
+        uint32_t    materialIndex;
+        uint32_t    padding[2];
+        Matrix4x4f  model;
+    };
+
+    // uniform data per mesh (model transform)
+    // [0-15]  -> 4x4 model matrix
+    using MeshUBData = std::array<char, 16u * sizeof(float)>;
+
+    // per instance vertex data when instancing is enabled (vertex binding 1)
+    // transform -> 4x4 instance matrix, applied before the mesh model matrix (locations 4-7)
+    // meshID    -> ID of the instanced mesh (location 8)
+    struct InstanceData
+    {
+        Matrix4x4f  transform;
+        MeshIDType  meshID;
+    };
 
     struct SetupParams 
     {
         bool enableFaceCulling = true;
+        uint32_t numFramesInFlight = 3u;    // should be at least the number of frames used by the renderer
+        uint32_t numViews = 1u;             // should be the number of views of the renderer
+        bool renderOutputs = false;         // should be set if the renderer has any auxiliary outputs
+        bool indirectDraw = false;          // draw all meshes with indirect draws, requires drawIndirectFirstInstance
+        bool instancing = false;            // draw the instances set with MeshSetInstances()
+        // textures of all meshes in a single descriptor array, requires indirectDraw & VK_EXT_descriptor_indexing,
+        // mesh IDs must be less than the (clamped) max number of textures
+        bool bindlessTextures = false;
+        uint32_t maxBindlessTextures = 1024u;
+        // model matrix & material index as push constants instead of the mesh uniform buffer, direct draws without
+        // instancing only
+        bool pushConstantTransforms = false;
+        // not used by the pipeline setup, helper for creating the vertex buffer with CreateVertexBuffer()
+        VertexBufferMode vertexBufferMode = eVERTEX_BUFFER_MODE_DYNAMIC;
     };
 
 public:
     explicit TriMeshPipeline(const VulkanDeviceManager& _deviceManager) :
         PipelineBase(_deviceManager),
+        m_meshDescPoolSize(0u),
+        m_sceneUBStride(0u),
+        m_sceneUBVersion(0u),
+        m_numViews(1u),
+        m_meshUBStride(0u),
+        m_meshUBCapacity(0u),
+        m_meshUBFrameSize(0u),
+        m_numFramesInFlight(0u),
+        m_meshUBVersion(0u),
+        m_indirectDraw(false),
+        m_drawVersion(0u),
+        m_instancing(false),
+        m_instanceCapacity(0u),
+        m_numInstances(0u),
+        m_instanceVersion(0u),
+        m_bindlessTextures(false),
+        m_bindlessTextureCount(0u),
+        m_bindlessVersion(0u),
+        m_pushConstantTransforms(false),
         m_indexBufferCurSize(0u)
     {}
 
     ~TriMeshPipeline() { Clear(); }
     void Clear();
 
-    // Resources shared by all meshes
+    // Resources shared by all meshes, the size is only the initial size as the buffer grows when needed
     bool CreateIndexBuffer(uint32_t size);
 
     // mesh API
+    // re-uses the IDs of removed meshes, returns InvalidMeshID if the mesh resources cannot grow
     MeshIDType CreateMeshID();
-    bool MeshCreateTexture(MeshIDType meshId, uint32_t width, uint32_t height);  // only support for RGBA
+    // releases all the mesh resources, they are destroyed (or re-used) once the frames in flight are done with them
+    bool MeshRemove(MeshIDType meshId);
+    // only support for RGBA, after the pipeline setup this also allocates the mesh descriptor set from the pool
+    // (or writes the texture to the bindless texture array)
+    bool MeshCreateTexture(MeshIDType meshId, uint32_t width, uint32_t height);
     bool MeshSetVertexData(MeshIDType meshId, const VulkanUtils::BufferUpdateInfo& updateInfo);
     bool MeshUpdateVertexData(MeshIDType meshId, const VulkanUtils::BufferUpdateInfo& updateInfo);
+    // index & texture data are uploaded asynchronously through the upload manager (copyCmdBuffer is not used)
     bool MeshSetIndexData(MeshIDType meshId, const VulkanUtils::BufferUpdateInfo& updateInfo);
     bool MeshSetTextureData(MeshIDType meshId, const VulkanUtils::TextureUpdateInfo& textureUpdateInfo);
     void MeshSetVisible(uint32_t meshId, bool visible);
+    // the mesh is drawn once per transform (in the mesh model space) with a single instanced draw, an empty list
+    // draws the mesh once with an identity transform, only used if the pipeline is setup with instancing
+    bool MeshSetInstances(MeshIDType meshId, const Matrix4x4f* transforms, uint32_t count);
 
-    // transform update API
+    // moves the data of all meshes to the start of the vertex & index buffers (using device copies for device local
+    // buffers), so that the free space is contiguous at the end of the buffers, waits for the device & releases
+    // all the retired resources
+    bool Compact();
+
+    // transform update API, only the host copies are updated & written to the frame in flight when it is 
+    // recorded, so frames still rendered by the device are not affected (copyCmdBuffer is not used)
     bool UpdateProjectionMatrix(const Matrix4x4f& projectionMatrix, vk::CommandBuffer copyCmdBuffer);
     bool UpdateViewMatrix(const Matrix4x4f& viewMatrix, vk::CommandBuffer copyCmdBuffer);
     bool UpdateLightPos(const Vector4f& lightPos, vk::CommandBuffer copyCmdBuffer);
     bool UpdateViewAndProjectionMatrix(const Matrix4x4f& viewMatrix, const Matrix4x4f& projectionMatrix, vk::CommandBuffer copyCmdBuffer);
     bool UpdateModelMatrix(MeshIDType meshId, const Matrix4x4f& modelMatrix, vk::CommandBuffer copyCmdBuffer);
+    // application defined index (e.g. in a material table of the shaders), only used with push constant transforms
+    void MeshSetMaterialIndex(MeshIDType meshId, uint32_t materialIndex);
+    // per view transforms when rendering multiple views
+    bool UpdateViewAndProjectionMatrix(uint32_t viewIndex, const Matrix4x4f& viewMatrix, const Matrix4x4f& projectionMatrix);
 
     // Setup internal/Vulkan data, call after setting all mesh data
     bool SetupPipeline(vk::RenderPass renderPass, 
         const PipelineBase::ShaderParams& shaderParams, const SetupParams& params);
 
     void RecordDrawCommands(const VulkanUtils::FrameUpdateInfo& frameInfo) const;
+    bool IsIndirectDraw() const { return m_indirectDraw; }
 
 private:
     // pipeline setup
     bool CreateUniformBuffer(VulkanUtils::BufferInfo& bufferInfo, uint32_t reqSize);
-    bool SetupDescriptorSets();
-    void SetupMeshDescriptorSet(VulkanUtils::DescriptorSetInfo& descSetInfo,
+    bool CreateMeshUniformBuffer(uint32_t numFramesInFlight, uint32_t capacity);
+    void SetMeshUniformLayout(uint32_t numFramesInFlight, uint32_t capacity);
+    bool SetupDescriptorSets(const SetupParams& params);
+    bool AllocateSceneDescriptorSet();
+    bool SetupMeshDescriptorSet(VulkanUtils::DescriptorSetInfo& descSetInfo,
         const VulkanUtils::BufferInfo& uniformBufferInfo, const VulkanUtils::ImageInfo& textureInfo);
+    bool AllocateMeshDescriptorSet(VulkanUtils::DescriptorSetInfo& descSetInfo);
+    bool CreateDefaultTexture();
+    void ReleaseMeshID(MeshIDType meshId, bool reusedId);
+    VkDeviceSize GetUniformBufferAlignment() const;
+    VkDeviceSize GetStorageBufferAlignment() const;
+    uint32_t GetSceneUniformSize() const;
+    void UpdateSceneUniformBuffer(uint32_t frameIndex) const;
+    void UpdateMeshUniformBuffer(uint32_t frameIndex) const;
+    bool GrowMeshUniformBuffer();
+    bool RecreateMeshBuffers(uint32_t capacity);
+    bool CreateIndirectBuffer(uint32_t numFramesInFlight, uint32_t capacity);
+    void UpdateIndirectBuffer(uint32_t frameIndex) const;
+    void UpdateSceneMeshDataDescriptor();
+    void RecordIndirectDrawCommands(const VulkanUtils::FrameUpdateInfo& frameInfo) const;
+    bool CreateInstanceBuffer(uint32_t numFramesInFlight, uint32_t capacity);
+    bool UpdateInstanceOffsets();
+    VkDeviceSize UpdateInstanceBuffer(uint32_t frameIndex) const;
+    bool SetupBindlessDescriptorSet(const SetupParams& params);
+    void MarkBindlessTexture(MeshIDType meshId);
+    void UpdateBindlessDescriptorSet(uint32_t frameIndex) const;
+    bool GrowIndexBuffer(VkDeviceSize minSize);
+
+    static vk::BufferUsageFlags GetIndexBufferUsage()
+    {
+        return vk::BufferUsageFlagBits::eIndexBuffer | 
+            vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst;
+    }
+
     void CreatePipelineLayout();
     bool CreatePipeline(vk::RenderPass renderPass, const PipelineBase::ShaderParams& shaderParams, const SetupParams& params);
 
@@ -95,31 +229,92 @@ private:
 
     // descriptor setup 
     VulkanUtils::DescriptorSetLayoutHandle  m_meshDescSetLayout; // descriptor layout for per mesh descriptor sets
+    // pools of the per mesh descriptor sets, a larger pool is added when all the pools are full
+    std::vector<VulkanUtils::DescriptorPoolHandle> m_meshDescPools;
+    uint32_t                                m_meshDescPoolSize;     // number of sets of the last pool
     VulkanUtils::DescriptorSetLayoutHandle  m_sceneDescSetLayout; // descriptor layout for scene descriptor sets
     VulkanUtils::DescriptorSetInfo          m_sceneDescSetInfo; // descriptor set for scene
     SceneUBData                             m_sceneUBData; // uniform data for the entire scene (all meshes)
+    uint32_t                                m_sceneUBStride;    // aligned size of the scene data of a frame
+    uint64_t                                m_sceneUBVersion;   // incremented on every scene data update
+    mutable std::vector<uint64_t>           m_sceneUBFrameVersions; // version of the data in each frame region
+    uint32_t                                m_numViews;
+    std::vector<ViewUBData>                 m_viewUBData;       // uniform data of each view with multiview
+
+    // uniform data for all meshes, the buffer is split in one region per frame in flight so that updates
+    // never overwrite data still used by the device and each mesh is addressed with a dynamic offset, with
+    // indirect draws the data are tightly packed & the frame region is bound as a storage buffer instead
+    VulkanUtils::BufferInfo                 m_meshUBBufferInfo;
+    uint32_t                                m_meshUBStride;         // aligned size of the uniform data of a mesh
+    uint32_t                                m_meshUBCapacity;       // number of meshes in each frame region
+    uint32_t                                m_meshUBFrameSize;      // aligned size of each frame region
+    uint32_t                                m_numFramesInFlight;
+    uint64_t                                m_meshUBVersion;        // incremented on every model transform update
+    mutable std::vector<uint64_t>           m_meshUBFrameVersions;  // version of the data in each frame region
+
+    // indirect draw commands of the visible meshes, a region of m_meshUBCapacity commands per frame in flight
+    bool                                    m_indirectDraw;
+    VulkanUtils::BufferInfo                 m_indirectBufferInfo;
+    uint64_t                                m_drawVersion;          // incremented on visibility & mesh range updates
+    mutable std::vector<uint64_t>           m_drawFrameVersions;    // version of the commands in each frame region
+    mutable std::vector<uint32_t>           m_drawFrameCounts;      // number of commands in each frame region
+
+    // instance data of all meshes, packed by mesh ID with a region of m_instanceCapacity instances per frame in flight
+    bool                                    m_instancing;
+    VulkanUtils::BufferInfo                 m_instanceBufferInfo;
+    uint32_t                                m_instanceCapacity;     // number of instances in each frame region
+    uint32_t                                m_numInstances;         // number of instances of all meshes
+    uint64_t                                m_instanceVersion;      // incremented on every instance update
+    mutable std::vector<uint64_t>           m_instanceFrameVersions; // version of the data in each frame region
+
+    // bindless textures, a descriptor set (1) per frame in flight with an array of textures indexed by mesh ID, 
+    // allocated from a separate pool
+    bool                                    m_bindlessTextures;
+    uint32_t                                m_bindlessTextureCount;
+    uint64_t                                m_bindlessVersion;      // incremented on every texture change
+    mutable std::vector<uint64_t>           m_bindlessFrameVersions; // version of the textures in each frame set
+    VulkanUtils::DescriptorPoolHandle       m_bindlessDescPool;
+    VulkanUtils::DescriptorSetLayoutHandle  m_bindlessDescSetLayout;
+    std::vector<VulkanUtils::DescriptorSetInfo> m_bindlessDescSetInfos;
+    VulkanUtils::ImageInfo                  m_defaultTextureInfo;   // 1x1 white texture for meshes without texture
+
+    // model matrix & material index of each mesh recorded in the draw commands
+    bool                                    m_pushConstantTransforms;
 
     // meshes are sharing a vertex and an index buffer
     VulkanUtils::BufferInfo                 m_indexBufferInfo;
-    VkDeviceSize                            m_indexBufferCurSize; // size of data (bytes) currently set in the index buffer
+    VkDeviceSize                            m_indexBufferCurSize; // end (bytes) of the data currently set in the index buffer
+    RangeAllocator                          m_indexRanges;      // ranges of the index buffer used by the meshes
     struct MeshInfo
     {
         bool                            visible = true;
+        bool                            removed = false;
         VkDeviceSize                    vertexOffset = 0u;  // offset in the vertex buffer
+        VkDeviceSize                    vertexSize = 0u;
         int64_t                         indexOffset = -1;   // offset in the index buffer
+        VkDeviceSize                    indexSize = 0u;
         VulkanUtils::ImageInfo          textureInfo;        // info for the texture used for this mesh
-        MeshUBData                      ubData;             // uniform buffer data for this mesh (model transform)
-        VulkanUtils::DescriptorSetInfo  descriptorSetInfo;  // descriptor set for this mesh
+        MeshUBData                      ubData;             // uniform data for this mesh (model transform)
+        VulkanUtils::DescriptorSetInfo  descriptorSetInfo;  // descriptor set for this mesh (texture & uniform buffer)
+        std::vector<Matrix4x4f>         instances;          // instance transforms, empty for a single instance
+        uint32_t                        instanceOffset = 0u; // first instance in the packed instance data
+        uint32_t                        materialIndex = 0u;
+        uint64_t                        bindlessVersion = 0u; // version of the last texture change
 
         void Clear()
         {
-            ubData.bufferInfo.Clear();
+            vertexOffset = 0u;
+            vertexSize = 0u;
             indexOffset = -1;
-            textureInfo.Clear();
+            indexSize = 0u;
             descriptorSetInfo.Clear();
+            textureInfo.Clear();
+            instances.clear();
+            materialIndex = 0u;
         }
     };
     std::vector<MeshInfo> m_meshInfos;
+    std::vector<MeshIDType> m_freeMeshIDs;  // IDs of removed meshes
 };
 
 } // hephaestus
\ No newline at end of file
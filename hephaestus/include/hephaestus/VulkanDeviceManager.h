@@ -3,6 +3,7 @@
 #include <hephaestus/Compiler.h>
 #include <hephaestus/VulkanConfig.h>
 #include <hephaestus/VulkanUtils.h>
+#include <hephaestus/VulkanUploadManager.h>
 
 #include <vector>
 
@@ -11,11 +12,15 @@ namespace hephaestus
 {
 // Class for dealing with the core management of the Vulkan device
 // - container for Vulkan device, instance & queues
+// - owns the allocator used for the device memory of all resources
+// - owns the service used for uploading data to device local resources
 // - optionally setups the present surface (extension)
 class VulkanDeviceManager
 {
 public:
     static std::vector<char const*> GetDeviceRequiredExtensions();
+    // extensions that are enabled only if supported by the physical device
+    static std::vector<char const*> GetDeviceOptionalExtensions();
     static std::vector<char const*> GetInstanceRequiredExtensions(bool enableValidationLayers);
 
 public:
@@ -45,6 +50,14 @@ public:
     const vk::SurfaceKHR& GetPresentSurface() const { return m_presentSurface.get(); }
     const VulkanUtils::QueueInfo& GetGraphicsQueueInfo() const { return m_graphicsQueueInfo; }
     const VulkanUtils::QueueInfo& GetPresentQueueInfo() const { return m_presentQueueInfo; }
+    bool IsDeviceExtensionEnabled(const char* extensionName) const;
+    // max number of views in a multiview render pass, 0 if multiview is not supported
+    uint32_t GetMaxMultiviewViewCount() const { return m_maxMultiviewViewCount; }
+    // optional core features that are enabled if supported (e.g. multiDrawIndirect)
+    const vk::PhysicalDeviceFeatures& GetEnabledFeatures() const { return m_enabledFeatures; }
+    // descriptor indexing features that are enabled if supported, all false without VK_EXT_descriptor_indexing
+    const vk::PhysicalDeviceDescriptorIndexingFeaturesEXT& GetEnabledDescriptorIndexingFeatures() const
+    { return m_enabledDescriptorIndexingFeatures; }
 
     vk::Instance GetInstance() { return m_instance.get(); }
     vk::Device GetDevice() { return m_device.get(); }
@@ -52,6 +65,11 @@ public:
     VulkanUtils::QueueInfo GetGraphicsQueueInfo() { return m_graphicsQueueInfo; }
     VulkanUtils::QueueInfo GetPresentQueueInfo() { return m_presentQueueInfo; }
 
+    // device memory for all resources is sub-allocated from the allocator
+    VulkanMemoryAllocator& GetMemoryAllocator() const { return m_memoryAllocator; }
+    // staged uploads are submitted asynchronously through the upload manager
+    VulkanUploadManager& GetUploadManager() const { return m_uploadManager; }
+
 private:
     // internal helpers
     bool CreateInstance(bool enableValidationLayers);
@@ -73,6 +91,12 @@ private:
     vk::UniqueHandle<vk::SurfaceKHR, VulkanDispatcher>  m_presentSurface;
     VulkanUtils::QueueInfo                              m_graphicsQueueInfo;
     VulkanUtils::QueueInfo                              m_presentQueueInfo;
+    std::vector<char const*>                            m_enabledDeviceExtensions;
+    uint32_t                                            m_maxMultiviewViewCount = 0u;
+    vk::PhysicalDeviceFeatures                          m_enabledFeatures;
+    vk::PhysicalDeviceDescriptorIndexingFeaturesEXT     m_enabledDescriptorIndexingFeatures;
+    mutable VulkanMemoryAllocator                       m_memoryAllocator;  // needs to be destroyed before the device
+    mutable VulkanUploadManager                         m_uploadManager;    // needs to be destroyed before the allocator
 
     // debugging
     vk::UniqueHandle<vk::DebugUtilsMessengerEXT, VulkanDispatcher> m_debugMessenger;
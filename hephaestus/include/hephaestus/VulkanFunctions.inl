@@ -18,6 +18,9 @@ VULKAN_EXPORTEDFUNCTION_DECLARATION(vkCreateDevice);
 VULKAN_EXPORTEDFUNCTION_DECLARATION(vkGetDeviceProcAddr);
 VULKAN_EXPORTEDFUNCTION_DECLARATION(vkDestroyInstance);
 VULKAN_EXPORTEDFUNCTION_DECLARATION(vkGetPhysicalDeviceMemoryProperties);
+VULKAN_EXPORTEDFUNCTION_DECLARATION(vkGetPhysicalDeviceMemoryProperties2);
+VULKAN_EXPORTEDFUNCTION_DECLARATION(vkGetPhysicalDeviceProperties2);
+VULKAN_EXPORTEDFUNCTION_DECLARATION(vkGetPhysicalDeviceFeatures2);
 VULKAN_EXPORTEDFUNCTION_DECLARATION(vkEnumerateDeviceExtensionProperties);
 VULKAN_EXPORTEDFUNCTION_DECLARATION(vkGetPhysicalDeviceSurfaceSupportKHR);
 VULKAN_EXPORTEDFUNCTION_DECLARATION(vkGetPhysicalDeviceSurfaceCapabilitiesKHR);
@@ -62,6 +65,7 @@ VULKAN_EXPORTEDFUNCTION_DECLARATION(vkCreateFramebuffer);
 VULKAN_EXPORTEDFUNCTION_DECLARATION(vkCreateShaderModule);
 VULKAN_EXPORTEDFUNCTION_DECLARATION(vkCreatePipelineLayout);
 VULKAN_EXPORTEDFUNCTION_DECLARATION(vkCreateGraphicsPipelines);
+VULKAN_EXPORTEDFUNCTION_DECLARATION(vkCreateComputePipelines);
 VULKAN_EXPORTEDFUNCTION_DECLARATION(vkCmdBeginRenderPass);
 VULKAN_EXPORTEDFUNCTION_DECLARATION(vkCmdBindPipeline);
 VULKAN_EXPORTEDFUNCTION_DECLARATION(vkCmdDraw);
@@ -81,12 +85,14 @@ VULKAN_EXPORTEDFUNCTION_DECLARATION(vkAllocateMemory);
 VULKAN_EXPORTEDFUNCTION_DECLARATION(vkBindBufferMemory);
 VULKAN_EXPORTEDFUNCTION_DECLARATION(vkMapMemory);
 VULKAN_EXPORTEDFUNCTION_DECLARATION(vkFlushMappedMemoryRanges);
+VULKAN_EXPORTEDFUNCTION_DECLARATION(vkInvalidateMappedMemoryRanges);
 VULKAN_EXPORTEDFUNCTION_DECLARATION(vkUnmapMemory);
 VULKAN_EXPORTEDFUNCTION_DECLARATION(vkCmdSetViewport);
 VULKAN_EXPORTEDFUNCTION_DECLARATION(vkCmdSetScissor);
 VULKAN_EXPORTEDFUNCTION_DECLARATION(vkCmdBindVertexBuffers);
 VULKAN_EXPORTEDFUNCTION_DECLARATION(vkWaitForFences);
 VULKAN_EXPORTEDFUNCTION_DECLARATION(vkResetFences);
+VULKAN_EXPORTEDFUNCTION_DECLARATION(vkGetFenceStatus);
 VULKAN_EXPORTEDFUNCTION_DECLARATION(vkFreeMemory);
 VULKAN_EXPORTEDFUNCTION_DECLARATION(vkDestroyBuffer);
 VULKAN_EXPORTEDFUNCTION_DECLARATION(vkDestroyFence);
@@ -108,9 +114,13 @@ VULKAN_EXPORTEDFUNCTION_DECLARATION(vkFreeDescriptorSets);
 
 VULKAN_EXPORTEDFUNCTION_DECLARATION(vkCmdBindIndexBuffer);
 VULKAN_EXPORTEDFUNCTION_DECLARATION(vkCmdDrawIndexed);
+VULKAN_EXPORTEDFUNCTION_DECLARATION(vkCmdDrawIndexedIndirect);
 VULKAN_EXPORTEDFUNCTION_DECLARATION(vkCmdPushConstants);
 VULKAN_EXPORTEDFUNCTION_DECLARATION(vkResetCommandPool);
 
 VULKAN_EXPORTEDFUNCTION_DECLARATION(vkCmdSetLineWidth);
 VULKAN_EXPORTEDFUNCTION_DECLARATION(vkCmdCopyImage);
-VULKAN_EXPORTEDFUNCTION_DECLARATION(vkGetImageSubresourceLayout);
\ No newline at end of file
+VULKAN_EXPORTEDFUNCTION_DECLARATION(vkGetImageSubresourceLayout);
+VULKAN_EXPORTEDFUNCTION_DECLARATION(vkCmdCopyImageToBuffer);
+VULKAN_EXPORTEDFUNCTION_DECLARATION(vkCmdDispatch);
+VULKAN_EXPORTEDFUNCTION_DECLARATION(vkGetMemoryHostPointerPropertiesEXT);
\ No newline at end of file
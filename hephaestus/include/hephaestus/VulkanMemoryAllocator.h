@@ -0,0 +1,180 @@
+#pragma once
+
+#include <hephaestus/Compiler.h>
+#include <hephaestus/VulkanConfig.h>
+#include <hephaestus/RangeAllocator.h>
+
+#include <vector>
+
+
+namespace hephaestus
+{
+// Allocator for device memory that sub-allocates resources from large memory blocks
+// - blocks are allocated per memory type and separately for linear (buffers, linear images) and
+//   optimal resources so that bufferImageGranularity does not need to be taken into account
+// - sub-allocations are alignment aware and freed ranges are re-used by later allocations
+// - resources that are too large to share a block get their own dedicated memory object
+// - host visible blocks are mapped once on demand and stay mapped while there are mapped allocations
+// - memory types are selected by scoring them against the intended usage of the allocation while
+//   keeping track of the heap budgets (using VK_EXT_memory_budget when available)
+class VulkanMemoryAllocator
+{
+public:
+    static const uint32_t InvalidIndex = UINT32_MAX;
+    static const VkDeviceSize DefaultBlockSize = 64u * 1024u * 1024u;
+
+    // Intended usage of an allocation, used for selecting the memory type
+    enum MemoryUsage : uint32_t
+    {
+        eMEMORY_USAGE_AUTO = 0,         // derived from the required memory property flags
+        eMEMORY_USAGE_GPU_ONLY,         // device resources, e.g. static geometry, textures & render targets
+        eMEMORY_USAGE_CPU_TO_GPU,       // written by the host & read by the device, e.g. dynamic geometry & uniforms
+        eMEMORY_USAGE_CPU_ONLY,         // staging memory, only used as a transfer source
+        eMEMORY_USAGE_GPU_TO_CPU,       // written by the device & read back by the host
+
+        eMEMORY_USAGE_COUNT
+    };
+
+    // Range of device memory sub-allocated from a block
+    struct Allocation
+    {
+        vk::DeviceMemory        memory;                         // memory object of the block, shared with other allocations
+        VkDeviceSize            offset = 0u;                    // offset of the allocation in the memory object
+        VkDeviceSize            size = 0u;
+        uint32_t                memoryTypeIndex = InvalidIndex;
+        uint32_t                blockIndex = InvalidIndex;
+        vk::MemoryPropertyFlags propertyFlags;                  // property flags of the memory type
+    };
+
+    // Move only handle that returns the allocation to the allocator when reset or destroyed
+    class AllocationHandle
+    {
+    public:
+        AllocationHandle() = default;
+        AllocationHandle(AllocationHandle&& other) { Swap(other); }
+        AllocationHandle& operator=(AllocationHandle&& other) { Reset(); Swap(other); return *this; }
+        ~AllocationHandle() { Reset(); }
+
+        bool IsValid() const { return m_allocator != nullptr; }
+        explicit operator bool() const { return IsValid(); }
+
+        const Allocation& Get() const { return m_allocation; }
+        const Allocation* operator->() const { return &m_allocation; }
+
+        // keep the allocation mapped until unmapped or reset, returns the mapped pointer
+        void* Map();
+        void Unmap();
+        void* GetMappedData() const { return m_mappedData; }
+
+        void Reset();
+        void Swap(AllocationHandle& other);
+
+    private:
+        friend class VulkanMemoryAllocator;
+
+        VulkanMemoryAllocator*  m_allocator = nullptr;
+        Allocation              m_allocation;
+        void*                   m_mappedData = nullptr;
+
+        AllocationHandle(const AllocationHandle&) = delete;
+        void operator=(const AllocationHandle&) = delete;
+    };
+
+    struct Stats
+    {
+        uint32_t        blockCount = 0u;        // number of device memory objects
+        uint32_t        allocationCount = 0u;   // number of live sub-allocations
+        VkDeviceSize    blockBytes = 0u;        // total size of all device memory objects
+        VkDeviceSize    usedBytes = 0u;         // total size of all live sub-allocations
+    };
+
+    // Memory usage & budget of a memory heap
+    struct HeapBudget
+    {
+        VkDeviceSize    blockBytes = 0u;        // size of the device memory objects allocated in the heap
+        VkDeviceSize    allocationBytes = 0u;   // size of the live sub-allocations in the heap
+        VkDeviceSize    usage = 0u;             // estimated heap usage of the process
+        VkDeviceSize    budget = 0u;            // estimated heap size available to the process
+    };
+
+public:
+    VulkanMemoryAllocator() = default;
+    ~VulkanMemoryAllocator();
+
+    // useMemoryBudget should only be set if VK_EXT_memory_budget is enabled for the device
+    bool Init(vk::PhysicalDevice physicalDevice, vk::Device device, bool useMemoryBudget,
+        VkDeviceSize blockSize = DefaultBlockSize);
+    void Clear();
+
+    // linear should be true for buffers and linear tiled images
+    bool Allocate(const vk::MemoryRequirements& requirements, uint32_t memoryTypeIndex, bool linear,
+        AllocationHandle& allocationHandle);
+    // allocate from the best memory type for the usage that has all the required property flags
+    bool Allocate(const vk::MemoryRequirements& requirements, vk::MemoryPropertyFlags requiredFlags,
+        MemoryUsage usage, bool linear, AllocationHandle& allocationHandle);
+
+    // returns the memory type with the highest score for the usage that has all the required property flags, 
+    // types from heaps without enough budget left are only selected if no other type is available, only the
+    // memory that would have to be allocated from the heap (new or dedicated block) is checked against the budget
+    uint32_t FindMemoryTypeIndex(const vk::MemoryRequirements& requirements, vk::MemoryPropertyFlags requiredFlags, 
+        MemoryUsage usage, bool linear) const;
+
+    // map/unmap host visible memory of an allocation, the memory of the block is mapped once & ref counted
+    void* Map(const Allocation& allocation);
+    void Unmap(const Allocation& allocation);
+    // flush/invalidate a range (relative to the allocation) of mapped memory, does nothing for coherent memory
+    void Flush(const Allocation& allocation, VkDeviceSize offset, VkDeviceSize size) const;
+    void Invalidate(const Allocation& allocation, VkDeviceSize offset, VkDeviceSize size) const;
+
+    const vk::PhysicalDeviceMemoryProperties& GetMemoryProperties() const { return m_memoryProperties; }
+    Stats GetStats() const;
+    // budgets are refreshed on every call, one entry per memory heap
+    void GetHeapBudgets(std::vector<HeapBudget>& heapBudgets) const;
+    bool IsMemoryBudgetSupported() const { return m_useMemoryBudget; }
+
+private:
+    struct Block
+    {
+        vk::DeviceMemory    memory;
+        VkDeviceSize        size = 0u;
+        uint32_t            memoryTypeIndex = InvalidIndex;
+        bool                linear = true;
+        bool                dedicated = false;      // used by a single allocation, released when freed
+        RangeAllocator      ranges;
+        uint32_t            allocationCount = 0u;
+        void*               mappedData = nullptr;
+        uint32_t            mapCount = 0u;
+    };
+
+    void Free(const Allocation& allocation);
+    uint32_t CreateBlock(VkDeviceSize size, uint32_t memoryTypeIndex, bool linear, bool dedicated);
+    void ReleaseBlock(Block& block);
+    VkDeviceSize GetPreferredBlockSize(uint32_t memoryTypeIndex) const;
+    void GetAllocationSize(const vk::MemoryRequirements& requirements, uint32_t memoryTypeIndex, 
+        VkDeviceSize& size, VkDeviceSize& alignment) const;
+    // size of the memory that has to be allocated from the heap, 0 if an existing block has enough free space
+    VkDeviceSize GetBlockAllocationSize(uint32_t memoryTypeIndex, VkDeviceSize size, VkDeviceSize alignment, 
+        bool linear) const;
+    vk::MappedMemoryRange GetMappedRange(const Allocation& allocation, VkDeviceSize offset, VkDeviceSize size) const;
+    void UpdateBudget() const;
+
+    vk::Device                          m_device;
+    vk::PhysicalDeviceMemoryProperties  m_memoryProperties;
+    VkDeviceSize                        m_blockSize = DefaultBlockSize;
+    VkDeviceSize                        m_nonCoherentAtomSize = 1u;
+    uint32_t                            m_maxAllocationCount = UINT32_MAX;
+    uint32_t                            m_liveBlockCount = 0u;
+    bool                                m_useMemoryBudget = false;
+
+    vk::PhysicalDevice                  m_physicalDevice;
+    VkDeviceSize                        m_heapBlockBytes[VK_MAX_MEMORY_HEAPS] = {};
+    VkDeviceSize                        m_heapAllocationBytes[VK_MAX_MEMORY_HEAPS] = {};
+    mutable HeapBudget                  m_heapBudgets[VK_MAX_MEMORY_HEAPS];     // cached, refreshed when blocks change
+
+    std::vector<Block>                  m_blocks;   // released blocks leave empty slots that get re-used
+
+    VulkanMemoryAllocator(const VulkanMemoryAllocator&) = delete;
+    void operator=(const VulkanMemoryAllocator&) = delete;
+};
+
+} // hephaestus
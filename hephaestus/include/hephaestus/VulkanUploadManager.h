@@ -0,0 +1,117 @@
+#pragma once
+
+#include <hephaestus/Compiler.h>
+#include <hephaestus/VulkanConfig.h>
+#include <hephaestus/RangeAllocator.h>
+#include <hephaestus/VulkanUtils.h>
+
+#include <deque>
+#include <vector>
+
+
+namespace hephaestus
+{
+// Service for uploading data to device local buffers & images without stalling the device
+// - data are copied to a persistently mapped staging buffer owned by the manager, so the source data
+//   can be released as soon as an upload call returns
+// - copies are recorded in command buffers from a pool and submitted to the graphics queue with a fence
+// - every submission returns a ticket which can be polled or waited on later, tickets are increasing so
+//   a completed ticket means that all previous uploads have also completed
+// - staging memory & command buffers of completed submissions are recycled lazily
+// - uploads larger than the staging memory are split in chunks (at row boundaries for images) that are streamed
+//   through a bounded staging window, i.e. a submission never uses more than half of the staging memory so that
+//   the host can fill the next chunks while the previous ones are copied by the device
+// - uploads can be batched, i.e. recorded in a single command buffer and submitted together, in which case
+//   all uploads of the batch share the same ticket
+// Commands submitted to the graphics queue after an upload are ordered after the copy by the barriers
+// recorded with it, so waiting on a ticket is only needed before the host re-uses or reads the memory.
+class VulkanUploadManager
+{
+public:
+    using Ticket = uint64_t;
+    static const Ticket InvalidTicket = 0u;     // tickets start from 1, the invalid ticket is always complete
+    static const VkDeviceSize DefaultStagingSize = 16u * 1024u * 1024u;
+
+public:
+    VulkanUploadManager() = default;
+    ~VulkanUploadManager() { Clear(); }
+
+    bool Init(const VulkanDeviceManager& deviceManager, VkDeviceSize stagingSize = DefaultStagingSize);
+    void Clear();
+
+    // copy data to a buffer region, dstAccessMask & dstStageMask describe how the buffer is used before & after the copy
+    bool UploadBuffer(const char* data, VkDeviceSize dataSize, vk::Buffer dstBuffer, VkDeviceSize dstOffset,
+        vk::AccessFlags dstAccessMask, vk::PipelineStageFlags dstStageMask, Ticket& ticket);
+    // copy tightly packed texel data to a 2D color image and transition it for reading in the fragment shader
+    bool UploadImage(const char* data, VkDeviceSize dataSize, vk::Image dstImage, uint32_t width, uint32_t height,
+        Ticket& ticket);
+    // device side copy between buffers, the regions must not overlap if the buffers are the same
+    bool CopyBuffer(vk::Buffer srcBuffer, vk::Buffer dstBuffer, const std::vector<vk::BufferCopy>& regions,
+        vk::AccessFlags dstAccessMask, vk::PipelineStageFlags dstStageMask, Ticket& ticket);
+
+    // uploads after BeginBatch() are recorded in the same command buffer and only submitted by FlushBatch(),
+    // the batch is also submitted early if it runs out of staging memory or when waiting on its ticket
+    bool BeginBatch();
+    bool FlushBatch(Ticket& ticket);
+    bool IsBatchOpen() const { return m_batchSubmission != InvalidSubmission; }
+
+    // non blocking check, also recycles the resources of completed submissions
+    bool IsComplete(Ticket ticket);
+    bool Wait(Ticket ticket, uint64_t timeout = UINT64_MAX);
+    bool WaitAll(uint64_t timeout = UINT64_MAX) { return Wait(m_lastTicket, timeout); }
+
+    Ticket GetLastTicket() const { return m_lastTicket; }
+    VkDeviceSize GetStagingSize() const { return m_stagingRanges.GetSize(); }
+    // maximum staging memory used by a single submission
+    VkDeviceSize GetStagingWindowSize() const { return m_stagingRanges.GetSize() / 2u; }
+
+private:
+    static const uint32_t InvalidSubmission = UINT32_MAX;
+
+    struct StagingRange
+    {
+        VkDeviceSize    offset;
+        VkDeviceSize    size;
+    };
+
+    struct Submission
+    {
+        VulkanUtils::CommandBufferHandle    cmdBuffer;
+        VulkanUtils::FenceHandle            fence;
+        Ticket                              ticket = InvalidTicket;
+        std::vector<StagingRange>           stagingRanges;  // released when the submission completes
+        VkDeviceSize                        stagingSize = 0u;
+    };
+
+    // copies a chunk of data to the staging memory used by the open batch
+    bool StageChunk(const char* data, VkDeviceSize dataSize, VkDeviceSize& stagingOffset);
+    bool EndUpload(bool ownBatch, bool success, Ticket& ticket);
+    // submits the open batch & starts a new one
+    bool RestartBatch();
+    vk::CommandBuffer GetBatchCmdBuffer() const { return m_submissions[m_batchSubmission].cmdBuffer.get(); }
+    bool AllocateStaging(VkDeviceSize size, VkDeviceSize& offset);
+    void ReleaseStaging(Submission& submission);
+    bool BeginSubmission(uint32_t& submissionIndex);
+    bool EndSubmission(uint32_t submissionIndex, Ticket& ticket);
+    // recycles completed submissions in order, optionally blocking on the oldest pending one
+    bool RetireSubmissions(bool waitOldest);
+
+    const VulkanDeviceManager*          m_deviceManager = nullptr;
+    VulkanUtils::CommandPoolHandle      m_commandPool;
+    VulkanUtils::BufferInfo             m_stagingBufferInfo;
+    RangeAllocator                      m_stagingRanges;
+    VkDeviceSize                        m_stagingAlignment = 1u;
+    VkDeviceSize                        m_chunkSize = 0u;   // max size of the chunks uploads are split in
+
+    std::vector<Submission>             m_submissions;          // pool of submissions, pending or free
+    std::deque<uint32_t>                m_pendingSubmissions;   // in submission order
+    std::vector<uint32_t>               m_freeSubmissions;
+    Ticket                              m_lastTicket = InvalidTicket;
+    Ticket                              m_completedTicket = InvalidTicket;  // all tickets up to this are complete
+    uint32_t                            m_batchSubmission = InvalidSubmission;  // submission recording the open batch
+
+    VulkanUploadManager(const VulkanUploadManager&) = delete;
+    void operator=(const VulkanUploadManager&) = delete;
+};
+
+} // hephaestus
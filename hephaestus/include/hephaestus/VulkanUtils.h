@@ -2,6 +2,7 @@
 
 #include <hephaestus/Compiler.h>
 #include <hephaestus/VulkanConfig.h>
+#include <hephaestus/VulkanMemoryAllocator.h>
 
 #include <vector>
 
@@ -62,6 +63,7 @@ public:
     using BufferHandle = vk::UniqueHandle<vk::Buffer, hephaestus::VulkanDispatcher>;
     using DeviceMemoryHandle = vk::UniqueHandle<vk::DeviceMemory, hephaestus::VulkanDispatcher>;
     using ImageHandle = vk::UniqueHandle<vk::Image, hephaestus::VulkanDispatcher>;
+    using AllocationHandle = VulkanMemoryAllocator::AllocationHandle;
     using SamplerHandle = vk::UniqueHandle<vk::Sampler, hephaestus::VulkanDispatcher>;
     using CommandPoolHandle = vk::UniqueHandle<vk::CommandPool, hephaestus::VulkanDispatcher>;
     using PipelineHandle = vk::UniqueHandle<vk::Pipeline, hephaestus::VulkanDispatcher>;
@@ -75,6 +77,18 @@ public:
         uint32_t	familyIndex = VulkanUtils::InvalidQueueIndex;
     };
 
+    // Outputs of a render pass, the color output is always rendered & the rest are optional auxiliary outputs
+    // written by the fragment shader to the location with the same index (see mesh_aux.frag)
+    enum RenderOutput : uint32_t
+    {
+        eRENDER_OUTPUT_COLOR = 0,   // RGBA (color format of the renderer)
+        eRENDER_OUTPUT_DEPTH,       // R32 float, linear view space depth, 0 for the background
+        eRENDER_OUTPUT_NORMAL,      // RGBA16 float, view space normal in xyz, 0 for the background
+        eRENDER_OUTPUT_MESH_ID,     // R32 uint, ID of the rendered mesh, UINT32_MAX for the background
+
+        eRENDER_OUTPUT_COUNT
+    };
+
     // Container with info for recording draw commands during a frame update
     struct FrameUpdateInfo
     {
@@ -84,6 +98,8 @@ public:
         vk::ImageView       view;
         vk::Extent2D        extent;
         vk::RenderPass      renderPass;
+        uint32_t            frameIndex = 0u;    // index of the frame in flight, resources used by the
+                                                // frame with the same index are guaranteed to be finished
     };
 
     // Container for keeping track of the Swap Chain
@@ -138,18 +154,24 @@ public:
     struct BufferInfo
     {
         BufferHandle        bufferHandle;
-        DeviceMemoryHandle  deviceMemory;
+        AllocationHandle    allocation;     // sub-allocated from the device manager memory allocator
         uint32_t            size = 0;
 
         bool IsValid() const
         {
-            return bufferHandle && deviceMemory && size > 0;
+            return bufferHandle && allocation && size > 0;
+        }
+
+        // pointer to the persistently mapped memory of the buffer, null if the buffer is not mapped
+        char* GetMappedData() const
+        {
+            return reinterpret_cast<char*>(allocation.GetMappedData());
         }
 
         void Clear()
         {
-            deviceMemory.reset(nullptr);
             bufferHandle.reset(nullptr);
+            allocation.Reset();
         }
     };
 
@@ -159,14 +181,14 @@ public:
         ImageHandle         imageHandle;
         ImageViewHandle     view;
         SamplerHandle       sampler;
-        DeviceMemoryHandle  deviceMemory;
+        AllocationHandle    allocation;     // sub-allocated from the device manager memory allocator
 
         void Clear()
         {
             view.reset(nullptr);
             sampler.reset(nullptr);
-            deviceMemory.reset(nullptr);
             imageHandle.reset(nullptr);
+            allocation.Reset();
         }
     };
 
@@ -227,21 +249,31 @@ public:
     static ShaderModuleHandle CreateShaderModule(const VulkanDeviceManager& deviceManager, 
         const char* filename);
 
+    // for more than one layer the image is an array image (e.g. for multiview rendering)
     static bool CreateDepthImage(const VulkanDeviceManager& deviceManager, 
-        uint32_t width, uint32_t height, ImageInfo& depthImageInfo);
+        uint32_t width, uint32_t height, ImageInfo& depthImageInfo, uint32_t numLayers = 1u);
 
+    // memory is allocated from the best memory type for the memory usage that has all the required properties,
+    // host visible buffers can optionally stay mapped for their whole lifetime
     static bool CreateBuffer(const VulkanDeviceManager& deviceManager, uint32_t size, 
-        vk::BufferUsageFlags usage, vk::MemoryPropertyFlags memoryProperty, BufferInfo& bufferInfo);
+        vk::BufferUsageFlags usage, vk::MemoryPropertyFlags memoryProperty, BufferInfo& bufferInfo,
+        VulkanMemoryAllocator::MemoryUsage memoryUsage = VulkanMemoryAllocator::eMEMORY_USAGE_AUTO,
+        bool persistentlyMapped = false);
 
     static bool AllocateBufferMemory(const VulkanDeviceManager& deviceManager, 
-        vk::MemoryPropertyFlags requiredMemoryProperty, BufferInfo& bufferInfo);
+        vk::MemoryPropertyFlags requiredMemoryProperty, BufferInfo& bufferInfo,
+        VulkanMemoryAllocator::MemoryUsage memoryUsage = VulkanMemoryAllocator::eMEMORY_USAGE_AUTO);
 
+    // linearTiling should be set for images created with vk::ImageTiling::eLinear
     static bool AllocateImageMemory(const VulkanDeviceManager& deviceManager, 
-        vk::MemoryPropertyFlags requiredMemoryProperty, ImageInfo& imageInfo);
+        vk::MemoryPropertyFlags requiredMemoryProperty, ImageInfo& imageInfo, bool linearTiling = false,
+        VulkanMemoryAllocator::MemoryUsage memoryUsage = VulkanMemoryAllocator::eMEMORY_USAGE_AUTO);
 
     static bool CreateImageTextureInfo(const VulkanDeviceManager& deviceManager, uint32_t width, uint32_t height, 
         ImageInfo& textureInfo);
 
+    // Synchronous copies through a staging buffer, the calls block until the copy has been executed.
+    // VulkanUploadManager should be preferred for uploads that do not need to complete immediately.
     static bool CopyImageDataStage(const VulkanDeviceManager& deviceManager, const BufferInfo &stageBufferInfo, 
         const ImageInfo& imageInfo, const TextureUpdateInfo& textureUpdateInfo);
 
@@ -251,15 +283,24 @@ public:
         const BufferUpdateInfo &updateInfo, const BufferInfo& dstBufferInfo,
         vk::AccessFlagBits dstFinalAccessMask, vk::PipelineStageFlagBits dstStageMask, VkDeviceSize dstBufferOffset = 0u);
 
-    // Copy data to (host local) buffer
+    // Copy data to (host local) buffer, only a memcpy (and a flush for non coherent memory) for mapped buffers
     static bool CopyBufferDataHost(const VulkanDeviceManager& deviceManager, 
         const BufferUpdateInfo &updateInfo, const BufferInfo& dstBufferInfo, VkDeviceSize dstBufferOffset = 0u);
 
     static bool CreateDescriptorPool(const VulkanDeviceManager& deviceManager,
-        uint32_t uniformSize, uint32_t combinedImgSamplerSize, DescriptorPoolHandle& descriptorPool);
+        uint32_t uniformSize, uint32_t combinedImgSamplerSize, DescriptorPoolHandle& descriptorPool,
+        uint32_t dynamicUniformSize = 0u, uint32_t dynamicStorageSize = 0u);
 
+    // for more than one view the subpass is rendered to the first numViews layers of the attachments (multiview)
+    // auxFormats are the formats of extra color attachments at locations 1, 2, ... (eUndefined for unused 
+    // locations), the extra attachments follow the depth attachment & end up in the same layout as the color
     static bool CreateRenderPass(const VulkanDeviceManager& deviceManager, 
-        vk::Format format, vk::ImageLayout finalLayout, RenderPassHandle& renderPass);
+        vk::Format format, vk::ImageLayout finalLayout, RenderPassHandle& renderPass, uint32_t numViews = 1u,
+        const std::vector<vk::Format>& auxFormats = std::vector<vk::Format>());
+
+    // format of the image of a render output, colorFormat is the format of the color output
+    static vk::Format GetRenderOutputFormat(RenderOutput output, vk::Format colorFormat);
+    static uint32_t GetRenderOutputPixelSize(RenderOutput output);
 
     // utility that makes sure that the allocation size for a mappable memory object adheres to device limitations
     // see https://www.khronos.org/registry/vulkan/specs/1.2-extensions/html/vkspec.html#memory-device-hostaccess
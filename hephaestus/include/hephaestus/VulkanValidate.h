@@ -19,6 +19,9 @@ struct VulkanValidate
     static bool CheckPhysicalDeviceRequiredExtensions(
         const std::vector<const char*>& deviceExtensions, 
         const vk::PhysicalDevice& physicalDevice);
+    static bool IsPhysicalDeviceExtensionSupported(
+        const char* extensionName,
+        const vk::PhysicalDevice& physicalDevice);
 };
 
 } // hephaestus
\ No newline at end of file
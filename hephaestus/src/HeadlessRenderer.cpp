@@ -4,6 +4,9 @@
 #include <hephaestus/PipelineBase.h>
 #include <hephaestus/VulkanDispatcher.h>
 
+#include <algorithm>
+#include <cstring>
+
 
 namespace hephaestus
 {
@@ -15,118 +18,384 @@ HeadlessRenderer::Init(const InitInfo& info)
     {
         baseInfo.outputImageLayout = vk::ImageLayout::eTransferSrcOptimal;
         baseInfo.colorFormat = info.colorFormat;
+        baseInfo.numViews = info.numViews;
+    }
+
+    const ColorConversionInfo& conversion = info.colorConversion;
+    const bool jpegEncoding = conversion.encoding == eCOLOR_ENCODING_JPEG_COEFFICIENTS;
+    if (conversion.shader && !jpegEncoding &&
+        conversion.numChannels != 1u && conversion.numChannels != 3u && conversion.numChannels != 4u)
+    {
+        HEPHAESTUS_LOG_ERROR("Color conversion to %u channels is not supported", conversion.numChannels);
+        return false;
+    }
+
+    // the converted color of each view is written as 32bit words by the compute shader
+    m_colorEncoding = conversion.shader ? conversion.encoding : eCOLOR_ENCODING_PIXELS;
+    m_conversionParams = {};
+    m_conversionParams.width = info.width;
+    m_conversionParams.height = info.height;
+    m_conversionParams.numChannels = conversion.shader ? (jpegEncoding ? 3u : conversion.numChannels) : 4u;
+    m_conversionParams.wordsPerLayer = m_colorEncoding == eCOLOR_ENCODING_JPEG_COEFFICIENTS ?
+        GetJpegCoefficientsSize(info.width, info.height) / 4u :
+        (info.width * info.height * m_conversionParams.numChannels + 3u) / 4u;
+    m_conversionParams.swizzleBGR = conversion.swizzleBGR ? 1u : 0u;
+    m_conversionParams.flipY = conversion.flipY ? 1u : 0u;
+    m_conversionParams.colorSpace = (uint32_t)conversion.colorSpace;
+    m_conversionParams.jpegQuality = std::min(std::max(conversion.jpegQuality, 1u), 100u);
+
+    // setup the outputs & their offsets in the frame data, the aux outputs are written to the locations with the
+    // same index so locations of disabled outputs are unused, offsets are aligned to the largest texel size
+    const bool outputEnabled[VulkanUtils::eRENDER_OUTPUT_COUNT] = 
+        { true, info.depthOutput, info.normalOutput, info.meshIDOutput };
+    m_frameDataSize = 0u;
+    for (uint32_t i = 0u; i < VulkanUtils::eRENDER_OUTPUT_COUNT; ++i)
+    {
+        const VulkanUtils::RenderOutput output = (VulkanUtils::RenderOutput)i;
+        m_frameDataSize = (m_frameDataSize + 7u) & ~7u;
+        m_outputOffsets[i] = m_frameDataSize;
+        if (i == VulkanUtils::eRENDER_OUTPUT_COLOR && conversion.shader)
+            m_outputSizes[i] = m_conversionParams.wordsPerLayer * 4u * info.numViews;
+        else
+            m_outputSizes[i] = outputEnabled[i] ? 
+                info.width * info.height * info.numViews * VulkanUtils::GetRenderOutputPixelSize(output) : 0u;
+        m_frameDataSize += m_outputSizes[i];
+
+        if (i != VulkanUtils::eRENDER_OUTPUT_COLOR && (info.depthOutput || info.normalOutput || info.meshIDOutput))
+            baseInfo.auxFormats.push_back(outputEnabled[i] ? 
+                VulkanUtils::GetRenderOutputFormat(output, info.colorFormat) : vk::Format::eUndefined);
     }
+
+    if (info.numFramesInFlight == 0u || info.numViews == 0u)
+        return false;
+    if (info.numViews > 1u && info.numViews > m_deviceManager.GetMaxMultiviewViewCount())
+    {
+        HEPHAESTUS_LOG_ERROR("Rendering %u views is not supported, max number of views is %u", 
+            info.numViews, m_deviceManager.GetMaxMultiviewViewCount());
+        return false;
+    }
+
     if (!RendererBase::Init(baseInfo))
         return false;
 
     m_extent.setWidth(info.width);
     m_extent.setHeight(info.height);
+    m_numViews = info.numViews;
 
-    if (!VulkanUtils::CreateDepthImage(
-        m_deviceManager, info.width, info.height, m_depthImageInfo))
+    if (conversion.shader && !CreateConversionPipeline(info))
         return false;
 
-    // create frame image to render to
-    {
-        vk::ImageCreateInfo imageCreateInfo;
-        imageCreateInfo.imageType = vk::ImageType::e2D;
-        imageCreateInfo.format = info.colorFormat;
-        imageCreateInfo.extent.width = info.width;
-        imageCreateInfo.extent.height = info.height;
-        imageCreateInfo.extent.depth = 1;
-        imageCreateInfo.mipLevels = 1;
-        imageCreateInfo.arrayLayers = 1;
-        imageCreateInfo.samples = vk::SampleCountFlagBits::e1;
-        imageCreateInfo.tiling = vk::ImageTiling::eOptimal;
-        imageCreateInfo.usage = 
-            vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc;
-
-        HEPHAESTUS_CHECK_RESULT_HANDLE(m_frameImageInfo.imageHandle, 
-            m_deviceManager.GetDevice().createImageUnique(imageCreateInfo, nullptr));
-
-        // allocate memory for image
-        if (!VulkanUtils::AllocateImageMemory(
-            m_deviceManager, vk::MemoryPropertyFlagBits::eDeviceLocal, m_frameImageInfo))
+    m_frameSlots.resize(info.numFramesInFlight);
+    for (FrameSlot& slot : m_frameSlots)
+    {
+        if (!CreateFrameSlot(info, slot))
             return false;
+    }
+    m_nextSlot = 0u;
+    m_lastRenderedSlot = UINT32_MAX;
+    m_nextFrameID = 0u;
+    m_numCompletedFrames = 0u;
 
-        m_deviceManager.GetDevice().bindImageMemory(
-            m_frameImageInfo.imageHandle.get(), m_frameImageInfo.deviceMemory.get(), 0);
+    // start with enough readback buffers for the frames in flight, more are created for retained frames
+    m_maxReadbackBuffers = std::max(info.maxReadbackBuffers, info.numFramesInFlight);
+    m_readbackBuffers.resize(info.numFramesInFlight);
+    for (ReadbackBuffer& readbackBuffer : m_readbackBuffers)
+    {
+        if (!CreateReadbackBuffer(readbackBuffer))
+            return false;
+    }
+
+    // importing host memory is optional
+    m_hostMemoryAlignment = 0u;
+    if (m_deviceManager.IsDeviceExtensionEnabled(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME))
+    {
+        auto properties = m_deviceManager.GetPhysicalDevice().getProperties2<
+            vk::PhysicalDeviceProperties2, vk::PhysicalDeviceExternalMemoryHostPropertiesEXT>();
+        m_hostMemoryAlignment = 
+            properties.get<vk::PhysicalDeviceExternalMemoryHostPropertiesEXT>().minImportedHostPointerAlignment;
+    }
+
+    return true;
+}
 
-        vk::ImageViewCreateInfo viewCreateInfo;
-        viewCreateInfo.viewType = vk::ImageViewType::e2D;
-        viewCreateInfo.format = info.colorFormat;
-        //viewCreateInfo.subresourceRange = {};
-        viewCreateInfo.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
-        viewCreateInfo.subresourceRange.baseMipLevel = 0;
-        viewCreateInfo.subresourceRange.levelCount = 1;
-        viewCreateInfo.subresourceRange.baseArrayLayer = 0;
-        viewCreateInfo.subresourceRange.layerCount = 1;
-        viewCreateInfo.image = m_frameImageInfo.imageHandle.get();
+bool
+HeadlessRenderer::CreateFrameSlot(const InitInfo& info, FrameSlot& slot)
+{
+    // each slot has its own depth image so that frames in flight do not depend on each other
+    if (!VulkanUtils::CreateDepthImage(
+        m_deviceManager, info.width, info.height, slot.depthImageInfo, info.numViews))
+        return false;
 
-        HEPHAESTUS_CHECK_RESULT_HANDLE(m_frameImageInfo.view, 
-            m_deviceManager.GetDevice().createImageViewUnique(viewCreateInfo, nullptr));
+    // create frame image to render to & the images of the aux outputs, the frame image is sampled by the conversion
+    if (!CreateOutputImage(info, info.colorFormat, slot.frameImageInfo, 
+        IsConversionEnabled() ? vk::ImageUsageFlagBits::eSampled : vk::ImageUsageFlags()))
+        return false;
+    for (uint32_t i = 1u; i < VulkanUtils::eRENDER_OUTPUT_COUNT; ++i)
+    {
+        const VulkanUtils::RenderOutput output = (VulkanUtils::RenderOutput)i;
+        if (IsOutputEnabled(output) && !CreateOutputImage(
+            info, VulkanUtils::GetRenderOutputFormat(output, info.colorFormat), slot.auxImageInfos[i]))
+            return false;
     }
 
     // create framebuffer
     {
-        std::array<vk::ImageView, 2> attachments = {
-            m_frameImageInfo.view.get(),
-            m_depthImageInfo.view.get()
+        // same order as the render pass attachments, the aux outputs follow the depth
+        std::vector<vk::ImageView> attachments = {
+            slot.frameImageInfo.view.get(),
+            slot.depthImageInfo.view.get()
         };
+        for (uint32_t i = 1u; i < VulkanUtils::eRENDER_OUTPUT_COUNT; ++i)
+        {
+            if (IsOutputEnabled((VulkanUtils::RenderOutput)i))
+                attachments.push_back(slot.auxImageInfos[i].view.get());
+        }
 
         // setup the framebuffer for the currently rendered image
         vk::FramebufferCreateInfo frameBufferCreateInfo(
             vk::FramebufferCreateFlags(),
             m_renderPass.get(),
-            2, attachments.data(),
+            (uint32_t)attachments.size(), attachments.data(),
             info.width,
             info.height,
-            1);		// layers
+            1);		// layers, multiview renders to the layers of the attachments
 
-        HEPHAESTUS_CHECK_RESULT_HANDLE(m_framebuffer, 
+        HEPHAESTUS_CHECK_RESULT_HANDLE(slot.framebuffer, 
             m_deviceManager.GetDevice().createFramebufferUnique(frameBufferCreateInfo, nullptr));
     }
 
-    // create destination image buffer
-    {
-        vk::ImageCreateInfo imageCreateInfo;
-        imageCreateInfo.imageType = vk::ImageType::e2D;
-        imageCreateInfo.format = vk::Format::eR8G8B8A8Unorm;
-        imageCreateInfo.extent.width = info.width;
-        imageCreateInfo.extent.height = info.height;
-        imageCreateInfo.extent.depth = 1;
-        imageCreateInfo.mipLevels = 1;
-        imageCreateInfo.arrayLayers = 1;
-        imageCreateInfo.initialLayout = vk::ImageLayout::eUndefined;
-        imageCreateInfo.samples = vk::SampleCountFlagBits::e1;
-        imageCreateInfo.tiling = vk::ImageTiling::eLinear;
-        imageCreateInfo.usage = vk::ImageUsageFlagBits::eTransferDst;
-
-        HEPHAESTUS_CHECK_RESULT_HANDLE(m_dstImageInfo.imageHandle, 
-            m_deviceManager.GetDevice().createImageUnique(imageCreateInfo, nullptr));
-
-        // allocate memory for image
-        // VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-        if (!VulkanUtils::AllocateImageMemory(
-            m_deviceManager, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, m_dstImageInfo))
-            return false;
+    // command buffer & fence, the fence starts signaled since the slot is available
+    {
+        vk::CommandBufferAllocateInfo cmdBufferAllocateInfo(
+            m_graphicsCommandPool.get(), vk::CommandBufferLevel::ePrimary, 1);
+        std::vector<vk::CommandBuffer> buffer;
+        HEPHAESTUS_CHECK_RESULT_RAW(buffer, 
+            m_deviceManager.GetDevice().allocateCommandBuffers(cmdBufferAllocateInfo));
+        vk::PoolFree<vk::Device, vk::CommandPool, VulkanDispatcher> deleter(
+            m_deviceManager.GetDevice(), m_graphicsCommandPool.get());
+        slot.cmdBuffer = VulkanUtils::CommandBufferHandle(buffer.front(), deleter);
 
-        m_deviceManager.GetDevice().bindImageMemory(
-            m_dstImageInfo.imageHandle.get(), m_dstImageInfo.deviceMemory.get(), 0);
+        vk::FenceCreateInfo fenceCreateInfo(vk::FenceCreateFlagBits::eSignaled);
+        HEPHAESTUS_CHECK_RESULT_HANDLE(slot.fence, 
+            m_deviceManager.GetDevice().createFenceUnique(fenceCreateInfo, nullptr));
+    }
+
+    if (IsConversionEnabled() && !CreateConversionDescriptorSet(info, slot))
+        return false;
+
+    return true;
+}
+
+bool
+HeadlessRenderer::CreateOutputImage(const InitInfo& info, vk::Format format, VulkanUtils::ImageInfo& imageInfo, 
+    vk::ImageUsageFlags extraUsage /*= vk::ImageUsageFlags()*/)
+{
+    vk::ImageCreateInfo imageCreateInfo;
+    imageCreateInfo.imageType = vk::ImageType::e2D;
+    imageCreateInfo.format = format;
+    imageCreateInfo.extent.width = info.width;
+    imageCreateInfo.extent.height = info.height;
+    imageCreateInfo.extent.depth = 1;
+    imageCreateInfo.mipLevels = 1;
+    imageCreateInfo.arrayLayers = info.numViews;
+    imageCreateInfo.samples = vk::SampleCountFlagBits::e1;
+    imageCreateInfo.tiling = vk::ImageTiling::eOptimal;
+    imageCreateInfo.usage = 
+        vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc | extraUsage;
+
+    HEPHAESTUS_CHECK_RESULT_HANDLE(imageInfo.imageHandle, 
+        m_deviceManager.GetDevice().createImageUnique(imageCreateInfo, nullptr));
+
+    // allocate memory for image
+    if (!VulkanUtils::AllocateImageMemory(
+        m_deviceManager, vk::MemoryPropertyFlagBits::eDeviceLocal, imageInfo))
+        return false;
+
+    m_deviceManager.GetDevice().bindImageMemory(imageInfo.imageHandle.get(), 
+        imageInfo.allocation->memory, imageInfo.allocation->offset);
+
+    vk::ImageViewCreateInfo viewCreateInfo;
+    viewCreateInfo.viewType = info.numViews > 1u ? vk::ImageViewType::e2DArray : vk::ImageViewType::e2D;
+    viewCreateInfo.format = format;
+    viewCreateInfo.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+    viewCreateInfo.subresourceRange.baseMipLevel = 0;
+    viewCreateInfo.subresourceRange.levelCount = 1;
+    viewCreateInfo.subresourceRange.baseArrayLayer = 0;
+    viewCreateInfo.subresourceRange.layerCount = info.numViews;
+    viewCreateInfo.image = imageInfo.imageHandle.get();
+
+    HEPHAESTUS_CHECK_RESULT_HANDLE(imageInfo.view, 
+        m_deviceManager.GetDevice().createImageViewUnique(viewCreateInfo, nullptr));
+
+    return true;
+}
+
+bool
+HeadlessRenderer::CreateConversionPipeline(const InitInfo& info)
+{
+    const vk::Device& device = m_deviceManager.GetDevice();
+
+    // texels are fetched by the shader so the filtering is irrelevant
+    vk::SamplerCreateInfo samplerCreateInfo(
+        vk::SamplerCreateFlags(),
+        vk::Filter::eNearest, vk::Filter::eNearest,
+        vk::SamplerMipmapMode::eNearest,
+        vk::SamplerAddressMode::eClampToEdge,		// address mode U
+        vk::SamplerAddressMode::eClampToEdge,		// V
+        vk::SamplerAddressMode::eClampToEdge,		// W
+        0.f,										// mip Lod bias
+        VK_FALSE, 1.f,								// anisotropy
+        VK_FALSE, vk::CompareOp::eAlways,			// compare
+        0.f, 0.f,									// min/max Lod
+        vk::BorderColor::eFloatTransparentBlack,
+        VK_FALSE);									// un normalized coords
+    HEPHAESTUS_CHECK_RESULT_HANDLE(m_conversionSampler, device.createSamplerUnique(samplerCreateInfo, nullptr));
+
+    // one descriptor set per frame slot
+    {
+        std::vector<vk::DescriptorPoolSize> poolSizes;
+        poolSizes.emplace_back(vk::DescriptorType::eCombinedImageSampler, info.numFramesInFlight);
+        poolSizes.emplace_back(vk::DescriptorType::eStorageBuffer, info.numFramesInFlight);
+        vk::DescriptorPoolCreateInfo poolCreateInfo(
+            vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet, info.numFramesInFlight, 
+            (uint32_t)poolSizes.size(), poolSizes.data());
+        HEPHAESTUS_CHECK_RESULT_HANDLE(m_conversionDescPool, 
+            device.createDescriptorPoolUnique(poolCreateInfo, nullptr));
+    }
+
+    // frame image (all views) & destination buffer
+    {
+        std::vector<vk::DescriptorSetLayoutBinding> layoutBindings;
+        layoutBindings.emplace_back(
+            0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eCompute, nullptr);
+        layoutBindings.emplace_back(
+            1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute, nullptr);
+
+        vk::DescriptorSetLayoutCreateInfo layoutCreateInfo(
+            vk::DescriptorSetLayoutCreateFlagBits(), (uint32_t)layoutBindings.size(), layoutBindings.data());
+        HEPHAESTUS_CHECK_RESULT_HANDLE(m_conversionDescSetLayout,
+            device.createDescriptorSetLayoutUnique(layoutCreateInfo, nullptr));
     }
 
+    vk::PushConstantRange pushConstantRange(
+        vk::ShaderStageFlagBits::eCompute, 0u, (uint32_t)sizeof(ConversionPushConstants));
+    vk::PipelineLayoutCreateInfo layoutCreateInfo(
+        vk::PipelineLayoutCreateFlags(),
+        1, &m_conversionDescSetLayout.get(),
+        1, &pushConstantRange);
+    HEPHAESTUS_CHECK_RESULT_HANDLE(m_conversionPipelineLayout,
+        device.createPipelineLayoutUnique(layoutCreateInfo, nullptr));
+
+    vk::ComputePipelineCreateInfo pipelineCreateInfo(
+        vk::PipelineCreateFlags(),
+        vk::PipelineShaderStageCreateInfo(
+            vk::PipelineShaderStageCreateFlags(),
+            vk::ShaderStageFlagBits::eCompute,
+            info.colorConversion.shader,
+            "main"),
+        m_conversionPipelineLayout.get(),
+        nullptr,        // basePipelineHandle
+        -1);            // basePipelineIndex
+    HEPHAESTUS_CHECK_RESULT_HANDLE(m_conversionPipeline, 
+        device.createComputePipelineUnique(nullptr, pipelineCreateInfo, nullptr));
+
+    return true;
+}
+
+bool
+HeadlessRenderer::CreateConversionDescriptorSet(const InitInfo& info, FrameSlot& slot)
+{
+    // the shader reads the views as layers of an array image, also with a single view
+    vk::ImageViewCreateInfo viewCreateInfo;
+    viewCreateInfo.viewType = vk::ImageViewType::e2DArray;
+    viewCreateInfo.format = info.colorFormat;
+    viewCreateInfo.subresourceRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, m_numViews);
+    viewCreateInfo.image = slot.frameImageInfo.imageHandle.get();
+    HEPHAESTUS_CHECK_RESULT_HANDLE(slot.conversionView, 
+        m_deviceManager.GetDevice().createImageViewUnique(viewCreateInfo, nullptr));
+
+    vk::DescriptorSetAllocateInfo allocInfo(m_conversionDescPool.get(), 1, &m_conversionDescSetLayout.get());
+    std::vector<vk::DescriptorSet> descSet;
+    HEPHAESTUS_CHECK_RESULT_RAW(descSet, m_deviceManager.GetDevice().allocateDescriptorSets(allocInfo));
+    vk::PoolFree<vk::Device, vk::DescriptorPool, VulkanDispatcher> deleter(
+        m_deviceManager.GetDevice(), m_conversionDescPool.get());
+    slot.conversionDescSet = VulkanUtils::DescriptorSetHandle(descSet.front(), deleter);
+
+    // the destination buffer is only known when the frame is recorded
+    vk::DescriptorImageInfo imageInfo(
+        m_conversionSampler.get(), slot.conversionView.get(), vk::ImageLayout::eShaderReadOnlyOptimal);
+    vk::WriteDescriptorSet descriptorWrite(
+        slot.conversionDescSet.get(),
+        0,		// destination binding
+        0,		// destination array element
+        1,		// descriptor count
+        vk::DescriptorType::eCombinedImageSampler,
+        &imageInfo,
+        nullptr,
+        nullptr);
+    m_deviceManager.GetDevice().updateDescriptorSets(descriptorWrite, nullptr);
+
     return true;
 }
 
+vk::BufferUsageFlags
+HeadlessRenderer::GetReadbackBufferUsage() const
+{
+    // the conversion shader writes directly to the readback buffer
+    return IsConversionEnabled() ? 
+        vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer :
+        vk::BufferUsageFlagBits::eTransferDst;
+}
+
+const VulkanUtils::ImageInfo& 
+HeadlessRenderer::GetOutputImage(const FrameSlot& slot, VulkanUtils::RenderOutput output) const
+{
+    return output == VulkanUtils::eRENDER_OUTPUT_COLOR ? slot.frameImageInfo : slot.auxImageInfos[output];
+}
+
+bool
+HeadlessRenderer::CreateReadbackBuffer(ReadbackBuffer& readbackBuffer) const
+{
+    // the buffer stays mapped, prefer host cached memory since the buffer is read back by the host
+    return VulkanUtils::CreateBuffer(m_deviceManager, GetFrameDataSize(), 
+        GetReadbackBufferUsage(), vk::MemoryPropertyFlagBits::eHostVisible, 
+        readbackBuffer.bufferInfo, VulkanMemoryAllocator::eMEMORY_USAGE_GPU_TO_CPU, true);
+}
+
 void 
 HeadlessRenderer::Clear()
 {
     HEPHAESTUS_LOG_ASSERT(m_deviceManager.GetDevice(), "No Vulkan device available");
     m_deviceManager.WaitDevice();
 
-    m_framebuffer.reset(nullptr);
-    m_dstImageInfo.Clear();
-    m_frameImageInfo.Clear();
+    for (HostMemoryImport& hostMemory : m_hostMemoryImports)
+        hostMemory.Clear();
+    m_hostMemoryImports.clear();
+    m_hostMemoryAlignment = 0u;
+
+    // buffers need to be destroyed before the graphics command pool, descriptor sets before their pool
+    for (FrameSlot& slot : m_frameSlots)
+        slot.Clear();
+    m_frameSlots.clear();
+    m_conversionPipeline.reset(nullptr);
+    m_conversionPipelineLayout.reset(nullptr);
+    m_conversionDescSetLayout.reset(nullptr);
+    m_conversionDescPool.reset(nullptr);
+    m_conversionSampler.reset(nullptr);
+    m_conversionParams = {};
+    m_colorEncoding = eCOLOR_ENCODING_PIXELS;
+    for (ReadbackBuffer& readbackBuffer : m_readbackBuffers)
+        readbackBuffer.Clear();
+    m_readbackBuffers.clear();
+    m_maxReadbackBuffers = 0u;
+    m_numViews = 1u;
+    m_outputOffsets.fill(0u);
+    m_outputSizes.fill(0u);
+    m_frameDataSize = 0u;
+    m_nextSlot = 0u;
+    m_lastRenderedSlot = UINT32_MAX;
+    m_nextFrameID = 0u;
+    m_numCompletedFrames = 0u;
 
     RendererBase::Clear();
 }
@@ -134,16 +403,45 @@ HeadlessRenderer::Clear()
 bool 
 HeadlessRenderer::RenderBegin(VulkanUtils::FrameUpdateInfo& frameInfo) const
 {
-    m_deviceManager.WaitDevice();
+    HEPHAESTUS_LOG_ASSERT(m_nextSlot < m_frameSlots.size(), "Frame slot index out of range");
+    const uint32_t slotIndex = m_nextSlot;
+    const FrameSlot& slot = m_frameSlots[slotIndex];
+
+    // wait for the previous frame rendered in the slot, both the render target & the readback buffer are re-used,
+    // the fence is not signaled if the previous frame failed to be submitted so it is only waited on after a submit
+    if (slot.submitted)
+    {
+        if (m_deviceManager.GetDevice().waitForFences(
+            slot.fence.get(), VK_TRUE, UINT64_MAX) != vk::Result::eSuccess)
+            return false;
+
+        // the readback buffer of the previous frame is recycled unless the frame has been retained
+        m_numCompletedFrames = std::max(m_numCompletedFrames, slot.frameID + 1u);
+
+        ReadbackBuffer& prevReadbackBuffer = m_readbackBuffers[slot.readbackIndex];
+        if (prevReadbackBuffer.frameID == slot.frameID && !prevReadbackBuffer.retained)
+            prevReadbackBuffer.inUse = false;
+    }
+
+    uint32_t readbackIndex = UINT32_MAX;
+    if (!AcquireReadbackBuffer(readbackIndex))
+        return false;
+
+    m_nextSlot = (m_nextSlot + 1u) % (uint32_t)m_frameSlots.size();
+    slot.frameID = m_nextFrameID++;
+    slot.submitted = false;
+    slot.readbackIndex = readbackIndex;
+    m_readbackBuffers[readbackIndex].frameID = slot.frameID;
 
     // set frame info
     {
-        frameInfo.drawCmdBuffer = m_cmdBuffer.get();
-        frameInfo.framebuffer = m_framebuffer.get();
+        frameInfo.drawCmdBuffer = slot.cmdBuffer.get();
+        frameInfo.framebuffer = slot.framebuffer.get();
         frameInfo.extent = m_extent;
-        frameInfo.image = m_frameImageInfo.imageHandle.get();
-        frameInfo.view = m_frameImageInfo.view.get();
+        frameInfo.image = slot.frameImageInfo.imageHandle.get();
+        frameInfo.view = slot.frameImageInfo.view.get();
         frameInfo.renderPass = m_renderPass.get();
+        frameInfo.frameIndex = slotIndex;
     }
 
     // begin recording commands
@@ -152,9 +450,15 @@ HeadlessRenderer::RenderBegin(VulkanUtils::FrameUpdateInfo& frameInfo) const
 
     // begin the render pass
     std::array<float, 4> colorClearValues = m_colorClearValues;
-    std::array<vk::ClearValue, 2> clearValues = {};
+    std::vector<vk::ClearValue> clearValues(2);
     clearValues[0].color = colorClearValues;
     clearValues[1].depthStencil = vk::ClearDepthStencilValue(1.0f, 0u);
+    if (IsOutputEnabled(VulkanUtils::eRENDER_OUTPUT_DEPTH))
+        clearValues.emplace_back(vk::ClearColorValue(std::array<float, 4>{ { 0.f, 0.f, 0.f, 0.f } }));
+    if (IsOutputEnabled(VulkanUtils::eRENDER_OUTPUT_NORMAL))
+        clearValues.emplace_back(vk::ClearColorValue(std::array<float, 4>{ { 0.f, 0.f, 0.f, 0.f } }));
+    if (IsOutputEnabled(VulkanUtils::eRENDER_OUTPUT_MESH_ID))
+        clearValues.emplace_back(vk::ClearColorValue(std::array<uint32_t, 4>{ { UINT32_MAX, 0u, 0u, 0u } }));
     vk::Rect2D renderArea = { {0, 0}, { frameInfo.extent } };
     vk::RenderPassBeginInfo renderPassBeginInfo(
         frameInfo.renderPass,
@@ -186,123 +490,171 @@ HeadlessRenderer::RenderBegin(VulkanUtils::FrameUpdateInfo& frameInfo) const
 }
 
 bool 
-HeadlessRenderer::RenderEnd(const VulkanUtils::FrameUpdateInfo& frameInfo) const
+HeadlessRenderer::RenderEnd(const VulkanUtils::FrameUpdateInfo& frameInfo, const char* hostData /*= nullptr*/) const
 {
+    HEPHAESTUS_LOG_ASSERT(frameInfo.frameIndex < m_frameSlots.size(), "Frame slot index out of range");
+    const FrameSlot& slot = m_frameSlots[frameInfo.frameIndex];
+    ReadbackBuffer& readbackBuffer = m_readbackBuffers[slot.readbackIndex];
+
     frameInfo.drawCmdBuffer.endRenderPass();
+    RecordFrameImageBarrier(slot, frameInfo.drawCmdBuffer);
+    const HostMemoryImport* hostMemory = FindHostMemoryImport(hostData);
+    if (hostMemory != nullptr)
+    {
+        RecordCopyCommands(slot, hostMemory->bufferHandle.get(), frameInfo.drawCmdBuffer);
+
+        // the frame does not need its readback buffer
+        readbackBuffer.inUse = false;
+        readbackBuffer.frameID = InvalidFrameID;
+    }
+    else
+        RecordCopyCommands(slot, readbackBuffer.bufferInfo.bufferHandle.get(), frameInfo.drawCmdBuffer);
     frameInfo.drawCmdBuffer.end();
 
-    // submit graphics queue
+    // submit graphics queue, the fence is only waited on when the slot is re-used or the frame is read back
     {
-        vk::FenceCreateInfo fenceCreateInfo(vk::FenceCreateFlagBits::eSignaled);
-        VulkanUtils::FenceHandle fence;
-        HEPHAESTUS_CHECK_RESULT_HANDLE(fence, 
-            m_deviceManager.GetDevice().createFenceUnique(fenceCreateInfo, nullptr));
-        m_deviceManager.GetDevice().resetFences(fence.get());
+        m_deviceManager.GetDevice().resetFences(slot.fence.get());
 
-        //vk::PipelineStageFlags waitDstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
         vk::SubmitInfo submitInfo(
             0, nullptr,
             nullptr,
-            1, &m_cmdBuffer.get(),
+            1, &slot.cmdBuffer.get(),
             0, nullptr);
-        m_deviceManager.GetGraphicsQueueInfo().queue.submit(submitInfo, fence.get());
-        //m_deviceManager.GetDevice().waitForFences(fence.get(), VK_TRUE, UINT64_MAX);
-        if (m_deviceManager.GetDevice().waitForFences(
-            fence.get(), VK_TRUE, UINT64_MAX) != vk::Result::eSuccess)
+        if (m_deviceManager.GetGraphicsQueueInfo().queue.submit(submitInfo, slot.fence.get()) != 
+            vk::Result::eSuccess)
+        {
+            // the frame will never be read back, the slot is not marked as submitted so its fence is not waited on
+            if (readbackBuffer.frameID == slot.frameID)
+            {
+                readbackBuffer.inUse = false;
+                readbackBuffer.frameID = InvalidFrameID;
+            }
             return false;
+        }
     }
 
+    slot.submitted = true;
+    m_lastRenderedSlot = frameInfo.frameIndex;
+
     return true;
 }
 
 void 
-HeadlessRenderer::CopyRenderFrame() const
+HeadlessRenderer::RecordFrameImageBarrier(const FrameSlot& slot, vk::CommandBuffer cmdBuffer) const
 {
-    // copy to the destination image
-    // ref https://github.com/SaschaWillems/Vulkan/blob/master/examples/renderheadless/renderheadless.cpp
+    vk::ImageSubresourceRange imageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, m_numViews);
 
-    m_deviceManager.WaitDevice();
-
-    // Do the actual blit from the offscreen image to our host visible destination image
-    vk::CommandBufferBeginInfo cmdBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
-    m_cmdBuffer.get().begin(cmdBufferBeginInfo);
-
-    // Transition destination image to transfer destination layout
+    // colorAttachment.image is already in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL after the render pass, but the
+    // copy still needs to wait for the color attachment writes, same for the aux outputs, the color image is
+    // instead sampled by the conversion shader when enabled
+    std::vector<vk::ImageMemoryBarrier> barriersFromRenderToTransfer;
+    for (uint32_t i = 0u; i < VulkanUtils::eRENDER_OUTPUT_COUNT; ++i)
     {
-        vk::ImageSubresourceRange imageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+        const VulkanUtils::RenderOutput output = (VulkanUtils::RenderOutput)i;
+        if (!IsOutputEnabled(output))
+            continue;
 
-        vk::ImageMemoryBarrier barrierFromLinearToTransfer(
-            vk::AccessFlags(),
-            vk::AccessFlagBits::eTransferWrite,
-            vk::ImageLayout::eUndefined,
-            vk::ImageLayout::eTransferDstOptimal,
-            m_deviceManager.GetGraphicsQueueInfo().familyIndex,
-            m_deviceManager.GetGraphicsQueueInfo().familyIndex,
-            m_dstImageInfo.imageHandle.get(),
+        const bool converted = output == VulkanUtils::eRENDER_OUTPUT_COLOR && IsConversionEnabled();
+        barriersFromRenderToTransfer.emplace_back(
+            vk::AccessFlagBits::eColorAttachmentWrite,
+            converted ? vk::AccessFlagBits::eShaderRead : vk::AccessFlagBits::eTransferRead,
+            vk::ImageLayout::eTransferSrcOptimal,
+            converted ? vk::ImageLayout::eShaderReadOnlyOptimal : vk::ImageLayout::eTransferSrcOptimal,
+            VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED,
+            GetOutputImage(slot, output).imageHandle.get(),
             imageSubresourceRange);
+    }
 
-        m_cmdBuffer.get().pipelineBarrier(
+    cmdBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eColorAttachmentOutput,
+        IsConversionEnabled() ? 
+            vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader : 
             vk::PipelineStageFlagBits::eTransfer,
-            vk::PipelineStageFlagBits::eTransfer,
-            vk::DependencyFlags(),
-            nullptr, nullptr, barrierFromLinearToTransfer);
-    }
-
-    // colorAttachment.image is already in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, and does not need to be transitioned
-
-    vk::ImageCopy imageCopyRegion = {};
-    imageCopyRegion.srcSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
-    imageCopyRegion.srcSubresource.layerCount = 1;
-    imageCopyRegion.dstSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
-    imageCopyRegion.dstSubresource.layerCount = 1;
-    imageCopyRegion.extent.width = m_extent.width;
-    imageCopyRegion.extent.height = m_extent.height;
-    imageCopyRegion.extent.depth = 1;
-
-    m_cmdBuffer.get().copyImage(
-        m_frameImageInfo.imageHandle.get(), vk::ImageLayout::eTransferSrcOptimal,
-        m_dstImageInfo.imageHandle.get(), vk::ImageLayout::eTransferDstOptimal,
-        imageCopyRegion);
-
-    // Transition destination image to general layout, which is the required layout for mapping the image memory later on
-    {
-        vk::ImageSubresourceRange imageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
-
-        vk::ImageMemoryBarrier barrierFromLinearToTransfer(
-            vk::AccessFlagBits::eTransferWrite,
-            vk::AccessFlagBits::eMemoryRead,
-            vk::ImageLayout::eTransferDstOptimal,
-            vk::ImageLayout::eGeneral,
-            m_deviceManager.GetGraphicsQueueInfo().familyIndex,
-            m_deviceManager.GetGraphicsQueueInfo().familyIndex,
-            m_dstImageInfo.imageHandle.get(),
-            imageSubresourceRange);
+        vk::DependencyFlags(),
+        nullptr, nullptr, barriersFromRenderToTransfer);
+}
 
-        m_cmdBuffer.get().pipelineBarrier(
-            vk::PipelineStageFlagBits::eTransfer,
-            vk::PipelineStageFlagBits::eTransfer,
-            vk::DependencyFlags(),
-            nullptr, nullptr, barrierFromLinearToTransfer);
+void 
+HeadlessRenderer::RecordCopyCommands(const FrameSlot& slot, vk::Buffer dstBuffer, vk::CommandBuffer cmdBuffer) const
+{
+    // rows are tightly packed in the destination buffer (zero row length & image height), so unlike copying to a
+    // linear image there is no row pitch & no limits on the extent or the format of the image
+    for (uint32_t i = 0u; i < VulkanUtils::eRENDER_OUTPUT_COUNT; ++i)
+    {
+        const VulkanUtils::RenderOutput output = (VulkanUtils::RenderOutput)i;
+        if (!IsOutputEnabled(output))
+            continue;
+        if (output == VulkanUtils::eRENDER_OUTPUT_COLOR && IsConversionEnabled())
+        {
+            RecordConversionCommands(slot, dstBuffer, cmdBuffer);
+            continue;
+        }
+
+        vk::BufferImageCopy copyRegion = {};
+        copyRegion.bufferOffset = m_outputOffsets[i];
+        copyRegion.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+        copyRegion.imageSubresource.layerCount = m_numViews;   // layers are consecutive in the buffer
+        copyRegion.imageExtent.width = m_extent.width;
+        copyRegion.imageExtent.height = m_extent.height;
+        copyRegion.imageExtent.depth = 1;
+
+        cmdBuffer.copyImageToBuffer(
+            GetOutputImage(slot, output).imageHandle.get(), vk::ImageLayout::eTransferSrcOptimal,
+            dstBuffer, copyRegion);
     }
 
-    m_cmdBuffer.get().end();
+    // make the copy (& the converted color) visible to the host
+    vk::BufferMemoryBarrier barrierFromTransferToHost(
+        vk::AccessFlagBits::eTransferWrite | vk::AccessFlagBits::eShaderWrite,
+        vk::AccessFlagBits::eHostRead,
+        VK_QUEUE_FAMILY_IGNORED,
+        VK_QUEUE_FAMILY_IGNORED,
+        dstBuffer,
+        0u, VK_WHOLE_SIZE);
+
+    cmdBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eHost,
+        vk::DependencyFlags(),
+        nullptr, barrierFromTransferToHost, nullptr);
+}
 
-    // submit & wait for the queue now to finish the copy
-    vk::SubmitInfo submitInfo(
-        0, nullptr,
+void 
+HeadlessRenderer::RecordConversionCommands(const FrameSlot& slot, vk::Buffer dstBuffer, vk::CommandBuffer cmdBuffer) const
+{
+    // the slot is no longer used by the device (see RenderBegin) so its descriptor set can be updated
+    vk::DescriptorBufferInfo bufferInfo(
+        dstBuffer, m_outputOffsets[VulkanUtils::eRENDER_OUTPUT_COLOR], m_outputSizes[VulkanUtils::eRENDER_OUTPUT_COLOR]);
+    vk::WriteDescriptorSet descriptorWrite(
+        slot.conversionDescSet.get(),
+        1,		// destination binding
+        0,		// destination array element
+        1,		// descriptor count
+        vk::DescriptorType::eStorageBuffer,
         nullptr,
-        1, &m_cmdBuffer.get(),
-        0, nullptr);
-    m_deviceManager.GetGraphicsQueueInfo().queue.submit(submitInfo, nullptr);
+        &bufferInfo,
+        nullptr);
+    m_deviceManager.GetDevice().updateDescriptorSets(descriptorWrite, nullptr);
 
-    m_deviceManager.GetDevice().waitIdle();
+    cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_conversionPipeline.get());
+    cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_conversionPipelineLayout.get(), 
+        0, slot.conversionDescSet.get(), nullptr);
+    cmdBuffer.pushConstants(m_conversionPipelineLayout.get(), vk::ShaderStageFlagBits::eCompute, 
+        0u, (uint32_t)sizeof(ConversionPushConstants), &m_conversionParams);
+
+    // pixels: each invocation writes one 32bit word of the converted data of a view
+    // JPEG: each work group encodes one 16x16 MCU of a view
+    if (m_colorEncoding == eCOLOR_ENCODING_JPEG_COEFFICIENTS)
+        cmdBuffer.dispatch((m_extent.width + 15u) / 16u, (m_extent.height + 15u) / 16u, m_numViews);
+    else
+        cmdBuffer.dispatch((m_conversionParams.wordsPerLayer + 63u) / 64u, 1u, m_numViews);
 }
 
 bool 
 HeadlessRenderer::GetDstImageInfo(uint32_t& numChannels, uint32_t& width, uint32_t& height) const
 {
-    // TODO
-    numChannels = 4u;
+    numChannels = m_conversionParams.numChannels;
     width = m_extent.width;
     height = m_extent.height;
 
@@ -312,45 +664,405 @@ HeadlessRenderer::GetDstImageInfo(uint32_t& numChannels, uint32_t& width, uint32
 bool 
 HeadlessRenderer::GetDstImageData(char* data) const
 {
-    // Get layout of the image (including row pitch)
-    vk::ImageSubresource subResource = {};
-    subResource.aspectMask = vk::ImageAspectFlagBits::eColor;// VK_IMAGE_ASPECT_COLOR_BIT;
-    vk::SubresourceLayout subResourceLayout;
+    if (m_lastRenderedSlot >= m_frameSlots.size())
+        return false;
+
+    return GetFrameImageData(m_frameSlots[m_lastRenderedSlot].frameID, data);
+}
+
+bool 
+HeadlessRenderer::GetFrameImageData(FrameID frameID, char* data) const
+{
+    return CopyFrameData(frameID, 0u, m_frameDataSize, data);
+}
+
+bool 
+HeadlessRenderer::GetFrameOutputData(FrameID frameID, VulkanUtils::RenderOutput output, char* data) const
+{
+    if (!IsOutputEnabled(output))
+    {
+        HEPHAESTUS_LOG_WARNING("Output %u is not rendered", (uint32_t)output);
+        return false;
+    }
+
+    return CopyFrameData(frameID, m_outputOffsets[output], m_outputSizes[output], data);
+}
+
+bool 
+HeadlessRenderer::CopyFrameData(FrameID frameID, uint32_t offset, uint32_t size, char* data) const
+{
+    const ReadbackBuffer* readbackBuffer = FindReadbackBuffer(frameID);
+    if (readbackBuffer == nullptr)
+    {
+        HEPHAESTUS_LOG_WARNING("Frame %llu is not available for read back", (unsigned long long)frameID);
+        return false;
+    }
+
+    // wait for the frame & its copy to the readback buffer
+    if (!WaitFrame(frameID))
+        return false;
+
+    const char* imagedata = MapReadbackBuffer(*readbackBuffer);
+    if (imagedata == nullptr)
+        return false;
+
+    std::memcpy(data, imagedata + offset, size);
+
+    return true;
+}
+
+uint32_t 
+HeadlessRenderer::GetNumTiles(uint32_t outputWidth, uint32_t outputHeight) const
+{
+    const uint32_t numTilesX = (outputWidth + m_extent.width - 1u) / m_extent.width;
+    const uint32_t numTilesY = (outputHeight + m_extent.height - 1u) / m_extent.height;
+
+    return numTilesX * numTilesY;
+}
+
+bool
+HeadlessRenderer::GetTileRowLayout(uint32_t& topRowOffset, int32_t& rowPitch) const
+{
+    // the sink is given rows of pixels of a single image
+    if (m_colorEncoding != eCOLOR_ENCODING_PIXELS)
+    {
+        HEPHAESTUS_LOG_ERROR("Tiled rendering requires the color to be read back as pixels");
+        return false;
+    }
+    if (m_numViews > 1u)
+    {
+        HEPHAESTUS_LOG_ERROR("Tiled rendering is not supported with multiple views");
+        return false;
+    }
+
+    // flipped rows start with the bottom row of the tile
+    const uint32_t pitch = m_extent.width * m_conversionParams.numChannels;
+    const bool flipY = IsConversionEnabled() && m_conversionParams.flipY != 0u;
+    topRowOffset = flipY ? (m_extent.height - 1u) * pitch : 0u;
+    rowPitch = flipY ? -(int32_t)pitch : (int32_t)pitch;
+
+    return true;
+}
+
+HeadlessRenderer::TileInfo 
+HeadlessRenderer::GetTileInfo(uint32_t tileIndex, uint32_t outputWidth, uint32_t outputHeight) const
+{
+    // tiles are ordered by rows
+    const uint32_t numTilesX = (outputWidth + m_extent.width - 1u) / m_extent.width;
+
+    TileInfo tile;
+    tile.x = (tileIndex % numTilesX) * m_extent.width;
+    tile.y = (tileIndex / numTilesX) * m_extent.height;
+    tile.width = std::min(m_extent.width, outputWidth - tile.x);
+    tile.height = std::min(m_extent.height, outputHeight - tile.y);
+    tile.outputWidth = outputWidth;
+    tile.outputHeight = outputHeight;
+
+    return tile;
+}
+
+std::array<float, 16> 
+HeadlessRenderer::GetTileProjectionMatrix(const std::array<float, 16>& projection, const TileInfo& tile) const
+{
+    // the full extent of the tile in normalized device coordinates is scaled & translated to [-1, 1], i.e. the
+    // projection is pre-multiplied by the scale/translation of x & y
+    const float x0 = 2.f * (float)tile.x / (float)tile.outputWidth - 1.f;
+    const float x1 = 2.f * (float)(tile.x + m_extent.width) / (float)tile.outputWidth - 1.f;
+    const float y0 = 2.f * (float)tile.y / (float)tile.outputHeight - 1.f;
+    const float y1 = 2.f * (float)(tile.y + m_extent.height) / (float)tile.outputHeight - 1.f;
+    const float scaleX = 2.f / (x1 - x0);
+    const float scaleY = 2.f / (y1 - y0);
+    const float offsetX = -(x1 + x0) / (x1 - x0);
+    const float offsetY = -(y1 + y0) / (y1 - y0);
+
+    std::array<float, 16> tileProjection = projection;
+    for (uint32_t c = 0u; c < 4u; ++c)
+    {
+        tileProjection[c * 4u + 0u] = scaleX * projection[c * 4u + 0u] + offsetX * projection[c * 4u + 3u];
+        tileProjection[c * 4u + 1u] = scaleY * projection[c * 4u + 1u] + offsetY * projection[c * 4u + 3u];
+    }
+
+    return tileProjection;
+}
+
+bool 
+HeadlessRenderer::RetainFrame(FrameID frameID, ReadbackCallback callback /*= nullptr*/) const
+{
+    ReadbackBuffer* readbackBuffer = FindReadbackBuffer(frameID);
+    if (readbackBuffer == nullptr)
+    {
+        HEPHAESTUS_LOG_WARNING("Frame %llu cannot be retained, its readback buffer has been re-used", 
+            (unsigned long long)frameID);
+        return false;
+    }
+
+    readbackBuffer->retained = true;
+    readbackBuffer->callback = std::move(callback);
+
+    return true;
+}
+
+void 
+HeadlessRenderer::ReleaseFrame(FrameID frameID) const
+{
+    ReadbackBuffer* readbackBuffer = FindReadbackBuffer(frameID);
+    if (readbackBuffer == nullptr)
+        return;
+
+    readbackBuffer->retained = false;
+    readbackBuffer->callback = nullptr;
+
+    // the buffer is still used by the slot of the frame if the slot has not been re-used yet
+    if (FindFrameSlot(frameID) == nullptr)
+        readbackBuffer->inUse = false;
+}
+
+bool 
+HeadlessRenderer::IsFrameComplete(FrameID frameID) const
+{
+    return WaitFrame(frameID, 0u);
+}
+
+bool 
+HeadlessRenderer::WaitFrame(FrameID frameID, uint64_t timeout /*= UINT64_MAX*/) const
+{
+    if (frameID < m_numCompletedFrames)
+        return true;
+
+    // frames that are no longer in a slot have completed when the slot was re-used
+    const FrameSlot* slot = FindFrameSlot(frameID);
+    if (slot == nullptr || !slot->submitted)
+        return false;
+
+    const vk::Result result = timeout == 0u ? 
+        m_deviceManager.GetDevice().getFenceStatus(slot->fence.get()) :
+        m_deviceManager.GetDevice().waitForFences(slot->fence.get(), VK_TRUE, timeout);
+    if (result != vk::Result::eSuccess)
+        return false;
+
+    m_numCompletedFrames = std::max(m_numCompletedFrames, frameID + 1u);
+
+    return true;
+}
+
+uint32_t 
+HeadlessRenderer::ProcessReadbacks() const
+{
+    // the pool is accessed by index since callbacks are allowed to render new frames (which may grow the pool)
+    uint32_t numProcessed = 0u;
+    for (size_t i = 0; i < m_readbackBuffers.size(); ++i)
+    {
+        if (!m_readbackBuffers[i].inUse || !m_readbackBuffers[i].retained || !m_readbackBuffers[i].callback)
+            continue;
+        const FrameID frameID = m_readbackBuffers[i].frameID;
+        if (!IsFrameComplete(frameID))
+            continue;
+
+        const char* imagedata = MapReadbackBuffer(m_readbackBuffers[i]);
+        if (imagedata == nullptr)
+            continue;
+
+        ReadbackCallback callback = std::move(m_readbackBuffers[i].callback);
+        callback(frameID, imagedata, GetFrameDataSize());
+
+        ReleaseFrame(frameID);
+        ++numProcessed;
+    }
+
+    return numProcessed;
+}
+
+bool 
+HeadlessRenderer::AcquireReadbackBuffer(uint32_t& readbackIndex) const
+{
+    for (uint32_t i = 0u; i < (uint32_t)m_readbackBuffers.size(); ++i)
+    {
+        if (!m_readbackBuffers[i].inUse)
+        {
+            readbackIndex = i;
+            m_readbackBuffers[i].inUse = true;
+            return true;
+        }
+    }
 
-    m_deviceManager.GetDevice().getImageSubresourceLayout(
-        m_dstImageInfo.imageHandle.get(), &subResource, &subResourceLayout);
+    // all buffers are used by retained frames
+    if (m_readbackBuffers.size() >= m_maxReadbackBuffers)
+    {
+        HEPHAESTUS_LOG_ERROR("All %u readback buffers are used by retained frames", m_maxReadbackBuffers);
+        return false;
+    }
 
-    // Map image memory so we can start copying from it
-    const char* imagedata = nullptr;
+    m_readbackBuffers.emplace_back();
+    if (!CreateReadbackBuffer(m_readbackBuffers.back()))
     {
-        void* temp = nullptr;
-        HEPHAESTUS_CHECK_RESULT_RAW(temp, m_deviceManager.GetDevice().mapMemory(
-                                        m_dstImageInfo.deviceMemory.get(), 0, VK_WHOLE_SIZE, vk::MemoryMapFlags()));
+        m_readbackBuffers.pop_back();
+        return false;
+    }
 
-        imagedata = reinterpret_cast<const char*>(temp);
+    readbackIndex = (uint32_t)m_readbackBuffers.size() - 1u;
+    m_readbackBuffers.back().inUse = true;
+
+    return true;
+}
+
+HeadlessRenderer::ReadbackBuffer* 
+HeadlessRenderer::FindReadbackBuffer(FrameID frameID) const
+{
+    for (ReadbackBuffer& readbackBuffer : m_readbackBuffers)
+    {
+        if (readbackBuffer.inUse && readbackBuffer.frameID == frameID)
+            return &readbackBuffer;
     }
-    imagedata += subResourceLayout.offset;
 
-    // If source is BGR (destination is always RGB) and we can't use blit (which does automatic conversion), we'll have to manually swizzle color components
-    // Check if source is BGR and needs swizzle
-    std::vector<VkFormat> formatsBGR = { VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_B8G8R8A8_SNORM };
-    const bool colorSwizzle = (std::find(formatsBGR.begin(), formatsBGR.end(), VK_FORMAT_R8G8B8A8_UNORM) != formatsBGR.end());
+    return nullptr;
+}
+
+const HeadlessRenderer::FrameSlot* 
+HeadlessRenderer::FindFrameSlot(FrameID frameID) const
+{
+    for (const FrameSlot& slot : m_frameSlots)
+    {
+        if (slot.frameID == frameID)
+            return &slot;
+    }
 
-    // TODO
-    if (colorSwizzle)
+    return nullptr;
+}
+
+bool 
+HeadlessRenderer::ImportHostMemory(char* data, VkDeviceSize size)
+{
+    if (!IsHostMemoryImportSupported())
+    {
+        HEPHAESTUS_LOG_WARNING("Importing host memory is not supported by the device");
         return false;
+    }
 
-    for (uint32_t y = 0; y < m_extent.height; y++)
+    if (data == nullptr || 
+        reinterpret_cast<uintptr_t>(data) % m_hostMemoryAlignment != 0u || size % m_hostMemoryAlignment != 0u)
     {
-        // copy the full row using memcpy
-        unsigned int *row = (unsigned int*)imagedata;
-        std::memcpy(data, row, m_extent.width * 4u);
-        data += m_extent.width * 4u;
+        HEPHAESTUS_LOG_WARNING("Host memory should be aligned to %llu bytes", 
+            (unsigned long long)m_hostMemoryAlignment);
+        return false;
+    }
 
-        imagedata += subResourceLayout.rowPitch;
+    if (size < GetFrameDataSize())
+    {
+        HEPHAESTUS_LOG_WARNING("Host memory is too small for the frame image");
+        return false;
     }
 
+    if (FindHostMemoryImport(data) != nullptr)
+        return true;
+
+    const vk::Device& device = m_deviceManager.GetDevice();
+    const vk::ExternalMemoryHandleTypeFlagBits handleType = vk::ExternalMemoryHandleTypeFlagBits::eHostAllocationEXT;
+    HostMemoryImport hostMemory;
+    hostMemory.data = data;
+    hostMemory.size = size;
+
+    // create the buffer as an external memory buffer
+    {
+        vk::ExternalMemoryBufferCreateInfo externalCreateInfo(handleType);
+        vk::BufferCreateInfo bufferCreateInfo(
+            vk::BufferCreateFlags(),
+            size,
+            GetReadbackBufferUsage(),
+            vk::SharingMode::eExclusive);
+        bufferCreateInfo.pNext = &externalCreateInfo;
+
+        HEPHAESTUS_CHECK_RESULT_HANDLE(hostMemory.bufferHandle, device.createBufferUnique(bufferCreateInfo, nullptr));
+    }
+
+    // pick a host coherent memory type that can import the pointer, so that no invalidation is needed
+    uint32_t memoryTypeIndex = UINT32_MAX;
+    {
+        vk::MemoryHostPointerPropertiesEXT hostPointerProperties;
+        if (device.getMemoryHostPointerPropertiesEXT(handleType, data, &hostPointerProperties) != vk::Result::eSuccess)
+        {
+            HEPHAESTUS_LOG_WARNING("Failed to get the properties of the host memory");
+            return false;
+        }
+
+        const vk::MemoryRequirements memoryRequirements = 
+            device.getBufferMemoryRequirements(hostMemory.bufferHandle.get());
+        const uint32_t memoryTypeBits = memoryRequirements.memoryTypeBits & hostPointerProperties.memoryTypeBits;
+        const vk::PhysicalDeviceMemoryProperties memoryProperties = 
+            m_deviceManager.GetPhysicalDevice().getMemoryProperties();
+        for (uint32_t i = 0u; i < memoryProperties.memoryTypeCount; ++i)
+        {
+            if ((memoryTypeBits & (1u << i)) != 0u && 
+                (memoryProperties.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eHostCoherent))
+            {
+                memoryTypeIndex = i;
+                break;
+            }
+        }
+
+        if (memoryTypeIndex == UINT32_MAX)
+        {
+            HEPHAESTUS_LOG_WARNING("No host coherent memory type can import the host memory");
+            return false;
+        }
+    }
+
+    // import the memory & bind it to the buffer
+    {
+        vk::ImportMemoryHostPointerInfoEXT importInfo(handleType, data);
+        vk::MemoryAllocateInfo allocateInfo(size, memoryTypeIndex);
+        allocateInfo.pNext = &importInfo;
+
+        HEPHAESTUS_CHECK_RESULT_HANDLE(hostMemory.memory, device.allocateMemoryUnique(allocateInfo, nullptr));
+
+        if (device.bindBufferMemory(hostMemory.bufferHandle.get(), hostMemory.memory.get(), 0u) != 
+            vk::Result::eSuccess)
+            return false;
+    }
+
+    m_hostMemoryImports.push_back(std::move(hostMemory));
+
     return true;
 }
 
+void 
+HeadlessRenderer::ReleaseHostMemory(const char* data)
+{
+    for (size_t i = 0; i < m_hostMemoryImports.size(); ++i)
+    {
+        if (m_hostMemoryImports[i].data == data)
+        {
+            m_deviceManager.WaitDevice();
+            m_hostMemoryImports.erase(m_hostMemoryImports.begin() + i);
+            return;
+        }
+    }
+}
+
+const HeadlessRenderer::HostMemoryImport* 
+HeadlessRenderer::FindHostMemoryImport(const char* data) const
+{
+    if (data == nullptr)
+        return nullptr;
+
+    for (const HostMemoryImport& hostMemory : m_hostMemoryImports)
+    {
+        if (hostMemory.data == data)
+            return &hostMemory;
+    }
+
+    return nullptr;
+}
+
+const char* 
+HeadlessRenderer::MapReadbackBuffer(const ReadbackBuffer& readbackBuffer) const
+{
+    // the buffer is persistently mapped, only need to make the device writes visible to the host
+    const char* data = readbackBuffer.bufferInfo.GetMappedData();
+    if (data == nullptr)
+        return nullptr;
+    m_deviceManager.GetMemoryAllocator().Invalidate(readbackBuffer.bufferInfo.allocation.Get(), 0, VK_WHOLE_SIZE);
+
+    return data;
+}
+
 } // namespace hephaestus
\ No newline at end of file
@@ -3,6 +3,9 @@
 #include <hephaestus/Log.h>
 #include <hephaestus/VulkanDispatcher.h>
 
+#include <algorithm>
+#include <cstring>
+
 
 namespace hephaestus
 {
@@ -11,36 +14,420 @@ void
 PipelineBase::CreateStageBuffer(uint32_t stageSize)
 {
     VulkanUtils::CreateBuffer(m_deviceManager, stageSize,
-        vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible, m_stageBufferInfo);
+        vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible, m_stageBufferInfo,
+        VulkanMemoryAllocator::eMEMORY_USAGE_CPU_ONLY, true);
 }
 
 bool
-PipelineBase::CreateVertexBuffer(uint32_t size)
+PipelineBase::CreateVertexBuffer(uint32_t size, VertexBufferMode mode /*= eVERTEX_BUFFER_MODE_DYNAMIC*/, 
+    uint32_t numFramesInFlight /*= 3u*/)
 {
-    return VulkanUtils::CreateBuffer(m_deviceManager, size,
-        vk::BufferUsageFlagBits::eVertexBuffer,
-        vk::MemoryPropertyFlagBits::eHostVisible,   // eHostVisible is used to demonstrate updates of CPU mesh buffers 
-        m_vertexBufferInfo);                        // for static meshes it should be more optimal to use eDeviceLocal
+    m_vertexBufferMode = mode;
+    m_vertexBufferCurSize = 0u;
+    m_vertexRanges.Clear();
+    m_vertexStreamData.clear();
+    m_vertexStreamFrameVersions.clear();
+    m_vertexRanges.Init(size);
+
+    switch (mode)
+    {
+    case eVERTEX_BUFFER_MODE_STATIC:
+        // also a transfer source so that the data can be moved to a new buffer
+        return VulkanUtils::CreateBuffer(m_deviceManager, size,
+            GetVertexBufferUsage(), vk::MemoryPropertyFlagBits::eDeviceLocal, m_vertexBufferInfo,
+            VulkanMemoryAllocator::eMEMORY_USAGE_GPU_ONLY);
+    case eVERTEX_BUFFER_MODE_DYNAMIC:
+        return VulkanUtils::CreateBuffer(m_deviceManager, size,
+            GetVertexBufferUsage(),
+            vk::MemoryPropertyFlagBits::eHostVisible, m_vertexBufferInfo,
+            VulkanMemoryAllocator::eMEMORY_USAGE_CPU_TO_GPU, true);
+    case eVERTEX_BUFFER_MODE_STREAM:
+    {
+        HEPHAESTUS_LOG_ASSERT(numFramesInFlight > 0u, "Invalid number of frames in flight");
+
+        // the buffer is used as is by the device, so the frame regions are only aligned to the vertex attributes
+        m_vertexStreamData.assign(size, 0);
+        m_vertexStreamFrameVersions.assign(numFramesInFlight, UINT64_MAX);
+        if (!VulkanUtils::CreateBuffer(m_deviceManager, size * numFramesInFlight,
+            GetVertexBufferUsage(),
+            vk::MemoryPropertyFlagBits::eHostVisible, m_vertexBufferInfo,
+            VulkanMemoryAllocator::eMEMORY_USAGE_CPU_TO_GPU, true))
+            return false;
+        m_vertexBufferInfo.size = size;     // size of a single frame region
+        return true;
+    }
+    default:
+        HEPHAESTUS_LOG_ERROR("Invalid vertex buffer mode %u", (uint32_t)mode);
+        return false;
+    }
 }
 
 void 
-PipelineBase::CreateDescriptorPool(uint32_t uniformSize /*= 5*/, uint32_t combinedImgSamplerSize /*= 5*/)
+PipelineBase::CreateDescriptorPool(uint32_t uniformSize /*= 5*/, uint32_t combinedImgSamplerSize /*= 5*/, 
+    uint32_t dynamicUniformSize /*= 5*/, uint32_t dynamicStorageSize /*= 2*/)
 {
-    VulkanUtils::CreateDescriptorPool(
-        m_deviceManager, uniformSize, combinedImgSamplerSize, m_descriptorPool);
+    VulkanUtils::CreateDescriptorPool(m_deviceManager, 
+        uniformSize, combinedImgSamplerSize, m_descriptorPool, dynamicUniformSize, dynamicStorageSize);
 }
 
 bool
 PipelineBase::AppendVertexData(const VulkanUtils::BufferUpdateInfo& updateInfo)
 {
-    if (!VulkanUtils::CopyBufferDataHost(m_deviceManager, updateInfo, m_vertexBufferInfo))
+    // data are appended as long as no vertex data are freed
+    VkDeviceSize offset = 0u;
+    return AllocateVertexData(updateInfo, 1u, offset);
+}
+
+bool
+PipelineBase::AllocateVertexData(const VulkanUtils::BufferUpdateInfo& updateInfo, VkDeviceSize alignment, 
+    VkDeviceSize& offset)
+{
+    offset = m_vertexRanges.Allocate(updateInfo.dataSize, alignment);
+    if (offset == RangeAllocator::InvalidOffset)
+    {
+        // the new space is appended to the free range at the end, so it can fit the (aligned) data
+        if (!GrowVertexBuffer(m_vertexRanges.GetSize() + updateInfo.dataSize + alignment))
+            return false;
+
+        offset = m_vertexRanges.Allocate(updateInfo.dataSize, alignment);
+        if (offset == RangeAllocator::InvalidOffset)
+        {
+            HEPHAESTUS_LOG_ERROR("Not enough space in the vertex buffer for %u bytes", updateInfo.dataSize);
+            return false;
+        }
+    }
+
+    if (!WriteVertexData(updateInfo, offset))
+    {
+        m_vertexRanges.Free(offset, updateInfo.dataSize);
+        return false;
+    }
+
+    m_vertexBufferCurSize = std::max(m_vertexBufferCurSize, offset + updateInfo.dataSize);
+
+    return true;
+}
+
+void
+PipelineBase::FreeVertexData(VkDeviceSize offset, VkDeviceSize size)
+{
+    // the data may be used by frames in flight, so the range is only re-used once they are done
+    RetireRange(m_vertexRanges, offset, size);
+}
+
+bool
+PipelineBase::CompactVertexData(std::vector<DataRange>& ranges, VkDeviceSize alignment)
+{
+    std::vector<vk::BufferCopy> regions;
+    const VkDeviceSize compactSize = PackDataRanges(m_vertexRanges, ranges, alignment, regions);
+
+    // data only move towards the start of the buffer, so moving them in order never overwrites data yet to be moved
+    switch (m_vertexBufferMode)
+    {
+    case eVERTEX_BUFFER_MODE_STATIC:
+        if (!ReallocateDeviceBuffer(m_vertexBufferInfo, m_vertexBufferInfo.size, GetVertexBufferUsage(), 
+            regions, vk::AccessFlagBits::eVertexAttributeRead, vk::PipelineStageFlagBits::eVertexInput))
+            return false;
+        break;
+    case eVERTEX_BUFFER_MODE_DYNAMIC:
+        for (const vk::BufferCopy& region : regions)
+        {
+            char* mappedData = m_vertexBufferInfo.GetMappedData();
+            std::memmove(mappedData + region.dstOffset, mappedData + region.srcOffset, region.size);
+        }
+        if (compactSize > 0u)
+            m_deviceManager.GetMemoryAllocator().Flush(m_vertexBufferInfo.allocation.Get(), 0u, compactSize);
+        break;
+    case eVERTEX_BUFFER_MODE_STREAM:
+        for (const vk::BufferCopy& region : regions)
+        {
+            std::memmove(m_vertexStreamData.data() + region.dstOffset, 
+                m_vertexStreamData.data() + region.srcOffset, region.size);
+        }
+        ++m_vertexStreamVersion;
+        break;
+    default:
+        break;
+    }
+
+    m_vertexBufferCurSize = compactSize;
+
+    return true;
+}
+
+bool
+PipelineBase::GrowVertexBuffer(VkDeviceSize minSize)
+{
+    HEPHAESTUS_ASSERT(m_vertexBufferInfo.IsValid());
+
+    const VkDeviceSize newSize = GetGrowSize(m_vertexRanges.GetSize(), minSize);
+    if (newSize > UINT32_MAX)
+    {
+        HEPHAESTUS_LOG_ERROR("Vertex buffer cannot grow to %llu bytes", (unsigned long long)newSize);
+        return false;
+    }
+
+    switch (m_vertexBufferMode)
+    {
+    case eVERTEX_BUFFER_MODE_STATIC:
+    {
+        // existing data are copied by the device to the same offsets in the new buffer
+        std::vector<vk::BufferCopy> regions;
+        if (m_vertexBufferCurSize > 0u)
+            regions.emplace_back(0u, 0u, m_vertexBufferCurSize);
+        if (!ReallocateDeviceBuffer(m_vertexBufferInfo, (uint32_t)newSize, GetVertexBufferUsage(), regions, 
+            vk::AccessFlagBits::eVertexAttributeRead, vk::PipelineStageFlagBits::eVertexInput))
+            return false;
+        break;
+    }
+    case eVERTEX_BUFFER_MODE_DYNAMIC:
+    {
+        // same as static buffers, the device copies the data instead of reading back the old mapped memory
+        std::vector<vk::BufferCopy> regions;
+        if (m_vertexBufferCurSize > 0u)
+            regions.emplace_back(0u, 0u, m_vertexBufferCurSize);
+        if (!ReallocateDeviceBuffer(m_vertexBufferInfo, (uint32_t)newSize, GetVertexBufferUsage(), regions, 
+            vk::AccessFlagBits::eVertexAttributeRead, vk::PipelineStageFlagBits::eVertexInput, true))
+            return false;
+        break;
+    }
+    case eVERTEX_BUFFER_MODE_STREAM:
+    {
+        // the data are kept in the host copy, the frame regions are re-written when they are next used so
+        // nothing is copied, the old buffer may still be used by frames in flight
+        const uint32_t numFramesInFlight = (uint32_t)m_vertexStreamFrameVersions.size();
+        VulkanUtils::BufferInfo newBufferInfo;
+        if (!VulkanUtils::CreateBuffer(m_deviceManager, (uint32_t)newSize * numFramesInFlight,
+            GetVertexBufferUsage(),
+            vk::MemoryPropertyFlagBits::eHostVisible, newBufferInfo,
+            VulkanMemoryAllocator::eMEMORY_USAGE_CPU_TO_GPU, true))
+            return false;
+
+        RetireBuffer(m_vertexBufferInfo);
+        m_vertexBufferInfo = std::move(newBufferInfo);
+        m_vertexBufferInfo.size = (uint32_t)newSize;
+        m_vertexStreamData.resize((size_t)newSize, 0);
+        m_vertexStreamFrameVersions.assign(numFramesInFlight, UINT64_MAX);
+        break;
+    }
+    default:
         return false;
+    }
 
-    m_vertexBufferCurSize += updateInfo.dataSize;
+    m_vertexRanges.Grow(newSize);
 
     return true;
 }
 
+VkDeviceSize
+PipelineBase::PackDataRanges(RangeAllocator& allocator, std::vector<DataRange>& ranges, VkDeviceSize alignment,
+    std::vector<vk::BufferCopy>& regions)
+{
+    // re-allocating the ranges in order from an empty allocator packs them at the start
+    allocator.Init(allocator.GetSize());
+    regions.clear();
+
+    VkDeviceSize compactSize = 0u;
+    for (DataRange& range : ranges)
+    {
+        const VkDeviceSize newOffset = allocator.Allocate(range.size, alignment);
+        HEPHAESTUS_LOG_ASSERT(newOffset != RangeAllocator::InvalidOffset && newOffset <= range.offset, 
+            "Ranges need to be sorted by offset");
+
+        regions.emplace_back(range.offset, newOffset, range.size);
+        range.offset = newOffset;
+        compactSize = newOffset + range.size;
+    }
+
+    return compactSize;
+}
+
+bool
+PipelineBase::ReallocateDeviceBuffer(VulkanUtils::BufferInfo& bufferInfo, uint32_t size, vk::BufferUsageFlags usage,
+    const std::vector<vk::BufferCopy>& regions, vk::AccessFlags dstAccessMask, vk::PipelineStageFlags dstStageMask,
+    bool hostVisible /*= false*/)
+{
+    HEPHAESTUS_ASSERT(bufferInfo.IsValid());
+
+    VulkanUtils::BufferInfo newBufferInfo;
+    if (hostVisible)
+    {
+        if (!VulkanUtils::CreateBuffer(m_deviceManager, size, usage, vk::MemoryPropertyFlagBits::eHostVisible, 
+            newBufferInfo, VulkanMemoryAllocator::eMEMORY_USAGE_CPU_TO_GPU, true))
+            return false;
+    }
+    else if (!VulkanUtils::CreateBuffer(m_deviceManager, size, usage, vk::MemoryPropertyFlagBits::eDeviceLocal, 
+        newBufferInfo, VulkanMemoryAllocator::eMEMORY_USAGE_GPU_ONLY))
+        return false;
+
+    // new data are only written to the new buffer once the copy has been executed, the old buffer is retired
+    // since frames in flight may still be reading it
+    VulkanUploadManager& uploadManager = m_deviceManager.GetUploadManager();
+    VulkanUploadManager::Ticket ticket = VulkanUploadManager::InvalidTicket;
+    if (!uploadManager.CopyBuffer(bufferInfo.bufferHandle.get(), newBufferInfo.bufferHandle.get(), regions,
+        dstAccessMask, dstStageMask, ticket))
+        return false;
+    if (!uploadManager.Wait(ticket))
+        return false;
+
+    RetireBuffer(bufferInfo);
+    bufferInfo = std::move(newBufferInfo);
+
+    return true;
+}
+
+void
+PipelineBase::RetireBuffer(VulkanUtils::BufferInfo& bufferInfo, 
+    VulkanUploadManager::Ticket ticket /*= VulkanUploadManager::InvalidTicket*/)
+{
+    RetiredResource resource;
+    resource.ticket = ticket;
+    resource.bufferInfo = std::move(bufferInfo);
+    bufferInfo.Clear();
+    AddRetiredResource(std::move(resource));
+}
+
+void
+PipelineBase::RetireImage(VulkanUtils::ImageInfo& imageInfo, 
+    VulkanUploadManager::Ticket ticket /*= VulkanUploadManager::InvalidTicket*/)
+{
+    RetiredResource resource;
+    resource.ticket = ticket;
+    resource.imageInfo = std::move(imageInfo);
+    imageInfo.Clear();
+    AddRetiredResource(std::move(resource));
+}
+
+void
+PipelineBase::RetireDescriptorSet(VulkanUtils::DescriptorSetInfo& descSetInfo)
+{
+    RetiredResource resource;
+    resource.descriptorSetInfo = std::move(descSetInfo);
+    descSetInfo.Clear();
+    AddRetiredResource(std::move(resource));
+}
+
+void
+PipelineBase::RetireRange(RangeAllocator& allocator, VkDeviceSize offset, VkDeviceSize size)
+{
+    RetiredResource resource;
+    resource.allocator = &allocator;
+    resource.range = { offset, size };
+    AddRetiredResource(std::move(resource));
+}
+
+void
+PipelineBase::AddRetiredResource(RetiredResource&& resource)
+{
+    resource.version = ++m_retireVersion;
+    m_retiredResources.push_back(std::move(resource));
+
+    // nothing to wait for if no frame has been recorded
+    ReleaseCompletedResources();
+}
+
+void
+PipelineBase::ReleaseRetiredResources(uint32_t frameIndex) const
+{
+    // the previous use of the frame has completed, so it does not use any of the resources retired until now
+    if (frameIndex >= m_retireFrameVersions.size())
+        m_retireFrameVersions.resize(frameIndex + 1u, 0u);
+    m_retireFrameVersions[frameIndex] = m_retireVersion;
+
+    if (!m_retiredResources.empty())
+        ReleaseCompletedResources();
+}
+
+void
+PipelineBase::ReleaseAllRetiredResources()
+{
+    for (RetiredResource& resource : m_retiredResources)
+    {
+        if (resource.allocator != nullptr)
+            resource.allocator->Free(resource.range.offset, resource.range.size);
+    }
+    m_retiredResources.clear();
+}
+
+void
+PipelineBase::ReleaseCompletedResources() const
+{
+    // resources retired after the oldest recorded frame may still be used by it
+    uint64_t completedVersion = UINT64_MAX;
+    for (uint64_t frameVersion : m_retireFrameVersions)
+        completedVersion = std::min(completedVersion, frameVersion);
+
+    VulkanUploadManager& uploadManager = m_deviceManager.GetUploadManager();
+    size_t numPending = 0u;
+    for (size_t i = 0; i < m_retiredResources.size(); ++i)
+    {
+        RetiredResource& resource = m_retiredResources[i];
+        if (resource.version > completedVersion || !uploadManager.IsComplete(resource.ticket))
+        {
+            if (i != numPending)
+                m_retiredResources[numPending] = std::move(resource);
+            ++numPending;
+        }
+        else if (resource.allocator != nullptr)
+            resource.allocator->Free(resource.range.offset, resource.range.size);
+    }
+    m_retiredResources.resize(numPending);
+}
+
+bool
+PipelineBase::WriteVertexData(const VulkanUtils::BufferUpdateInfo& updateInfo, VkDeviceSize offset)
+{
+    HEPHAESTUS_ASSERT(m_vertexBufferInfo.IsValid());
+    HEPHAESTUS_ASSERT(offset + updateInfo.dataSize <= m_vertexBufferInfo.size);
+
+    switch (m_vertexBufferMode)
+    {
+    case eVERTEX_BUFFER_MODE_STATIC:
+        return m_deviceManager.GetUploadManager().UploadBuffer(updateInfo.data, updateInfo.dataSize, 
+            m_vertexBufferInfo.bufferHandle.get(), offset, 
+            vk::AccessFlagBits::eVertexAttributeRead, vk::PipelineStageFlagBits::eVertexInput, m_lastUploadTicket);
+    case eVERTEX_BUFFER_MODE_STREAM:
+        std::memcpy(m_vertexStreamData.data() + offset, updateInfo.data, updateInfo.dataSize);
+        ++m_vertexStreamVersion;
+        return true;
+    default:
+        return VulkanUtils::CopyBufferDataHost(m_deviceManager, updateInfo, m_vertexBufferInfo, offset);
+    }
+}
+
+VkDeviceSize
+PipelineBase::PrepareVertexBufferFrame(uint32_t frameIndex) const
+{
+    if (m_vertexBufferMode != eVERTEX_BUFFER_MODE_STREAM)
+        return 0u;
+
+    HEPHAESTUS_LOG_ASSERT(frameIndex < m_vertexStreamFrameVersions.size(), "Frame index out of range");
+
+    // the device is done with the frame region so it is safe to copy the latest vertex data
+    const VkDeviceSize frameOffset = (VkDeviceSize)frameIndex * m_vertexBufferInfo.size;
+    if (m_vertexStreamFrameVersions[frameIndex] != m_vertexStreamVersion && m_vertexBufferCurSize > 0u)
+    {
+        std::memcpy(m_vertexBufferInfo.GetMappedData() + frameOffset, m_vertexStreamData.data(), m_vertexBufferCurSize);
+        m_deviceManager.GetMemoryAllocator().Flush(
+            m_vertexBufferInfo.allocation.Get(), frameOffset, m_vertexBufferCurSize);
+        m_vertexStreamFrameVersions[frameIndex] = m_vertexStreamVersion;
+    }
+
+    return frameOffset;
+}
+
+bool
+PipelineBase::IsUploadComplete() const
+{
+    return m_deviceManager.GetUploadManager().IsComplete(m_lastUploadTicket);
+}
+
+bool
+PipelineBase::WaitUploads() const
+{
+    return m_deviceManager.GetUploadManager().Wait(m_lastUploadTicket);
+}
+
 void 
 PipelineBase::GetShaderModules(
     const PipelineBase::ShaderParams& shaderParams, 
@@ -57,12 +444,20 @@ PipelineBase::Clear()
     HEPHAESTUS_LOG_ASSERT(m_deviceManager.GetDevice(), "No Vulkan device available");
     m_deviceManager.WaitDevice();
 
+    m_retiredResources.clear();     // destroyed before the descriptor pool, ranges are not freed as buffers are cleared
     m_vertexBufferInfo.Clear();
     m_stageBufferInfo.Clear();
 
     m_descriptorPool.reset(nullptr);     // make sure the descriptor pool is destroyed *after* we have destroyed the descriptor sets
 
+    m_vertexBufferMode = eVERTEX_BUFFER_MODE_DYNAMIC;
     m_vertexBufferCurSize = 0u;
+    m_vertexStreamData.clear();
+    m_vertexStreamVersion = 0u;
+    m_vertexStreamFrameVersions.clear();
+    m_lastUploadTicket = VulkanUploadManager::InvalidTicket;
+    m_retireFrameVersions.clear();
+    m_retireVersion = 0u;
 }
 
 } // hephaestus
\ No newline at end of file
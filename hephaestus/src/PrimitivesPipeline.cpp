@@ -12,13 +12,17 @@ namespace hephaestus
 void 
 PrimitivesPipeline::RecordDrawCommands(const VulkanUtils::FrameUpdateInfo& frameInfo) const
 {
+    // the previous use of the frame has completed, resources retired since are not used by the device anymore
+    ReleaseRetiredResources(frameInfo.frameIndex);
+
     // bind pipeline
     frameInfo.drawCmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_vulkanGraphicsPipeline.get());
 
     // draw the vertex buffer
     if (m_vertexBufferInfo.IsValid() && m_vertexBufferCurSize > 0u)
     {
-        frameInfo.drawCmdBuffer.bindVertexBuffers(0, m_vertexBufferInfo.bufferHandle.get(), (VkDeviceSize)0u);
+        const VkDeviceSize vertexFrameOffset = PrepareVertexBufferFrame(frameInfo.frameIndex);
+        frameInfo.drawCmdBuffer.bindVertexBuffers(0, m_vertexBufferInfo.bufferHandle.get(), vertexFrameOffset);
         frameInfo.drawCmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
             m_graphicsPipelineLayout.get(), 0, m_descriptorSetInfo.handle.get(), nullptr);
 
@@ -56,12 +60,12 @@ PrimitivesPipeline::UpdateViewMatrix(
 bool 
 PrimitivesPipeline::AddLineStripData(const VulkanUtils::BufferUpdateInfo& updateInfo)
 {
-    if (!VulkanUtils::CopyBufferDataHost(m_deviceManager, updateInfo, 
-        m_vertexBufferInfo, m_vertexBufferCurSize))
+    // line strip data are never freed, so they are always appended after the previous strip
+    VkDeviceSize offset = 0u;
+    if (!AllocateVertexData(updateInfo, 1u, offset))
         return false;
 
-    m_vertexBufferCurSize += updateInfo.dataSize;
-    m_lineStripOffsets.push_back(m_vertexBufferCurSize);
+    m_lineStripOffsets.push_back(offset + updateInfo.dataSize);
 
     return true;
 }
@@ -246,7 +250,7 @@ PrimitivesPipeline::CreateUniformBuffer()
     return VulkanUtils::CreateBuffer(m_deviceManager, bufferSize,
         vk::BufferUsageFlagBits::eUniformBuffer,
         vk::MemoryPropertyFlagBits::eHostVisible,
-        m_uniformBufferData.bufferInfo);
+        m_uniformBufferData.bufferInfo, VulkanMemoryAllocator::eMEMORY_USAGE_CPU_TO_GPU, true);
 }
 
 bool
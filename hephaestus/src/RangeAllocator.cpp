@@ -0,0 +1,142 @@
+#include <hephaestus/RangeAllocator.h>
+
+#include <hephaestus/Log.h>
+
+#include <algorithm>
+
+
+namespace hephaestus
+{
+
+void
+RangeAllocator::Init(SizeType size)
+{
+    Clear();
+
+    m_size = size;
+    m_freeSize = size;
+    if (size > 0u)
+        m_freeRanges.push_back({ 0u, size });
+}
+
+void
+RangeAllocator::Clear()
+{
+    m_freeRanges.clear();
+    m_size = 0u;
+    m_freeSize = 0u;
+}
+
+RangeAllocator::SizeType
+RangeAllocator::Allocate(SizeType size, SizeType alignment /*= 1u*/)
+{
+    HEPHAESTUS_LOG_ASSERT(alignment > 0u, "Invalid range alignment");
+    if (size == 0u)
+        return InvalidOffset;
+
+    for (size_t i = 0; i < m_freeRanges.size(); ++i)
+    {
+        Range& range = m_freeRanges[i];
+
+        const SizeType alignedOffset = ((range.offset + alignment - 1u) / alignment) * alignment;
+        const SizeType padding = alignedOffset - range.offset;
+        if (padding + size > range.size)
+            continue;
+
+        const SizeType rangeEnd = range.offset + range.size;
+        const SizeType tailOffset = alignedOffset + size;
+
+        if (padding > 0u)
+        {
+            // keep the padding as a free range and add the remaining tail (if any) after it
+            range.size = padding;
+            if (tailOffset < rangeEnd)
+                m_freeRanges.insert(m_freeRanges.begin() + i + 1, { tailOffset, rangeEnd - tailOffset });
+        }
+        else if (tailOffset < rangeEnd)
+        {
+            range.offset = tailOffset;
+            range.size = rangeEnd - tailOffset;
+        }
+        else
+            m_freeRanges.erase(m_freeRanges.begin() + i);
+
+        m_freeSize -= size;
+
+        return alignedOffset;
+    }
+
+    return InvalidOffset;
+}
+
+bool
+RangeAllocator::CanAllocate(SizeType size, SizeType alignment /*= 1u*/) const
+{
+    HEPHAESTUS_LOG_ASSERT(alignment > 0u, "Invalid range alignment");
+    if (size == 0u)
+        return false;
+
+    for (const Range& range : m_freeRanges)
+    {
+        const SizeType alignedOffset = ((range.offset + alignment - 1u) / alignment) * alignment;
+        if (alignedOffset - range.offset + size <= range.size)
+            return true;
+    }
+
+    return false;
+}
+
+void
+RangeAllocator::Free(SizeType offset, SizeType size)
+{
+    HEPHAESTUS_LOG_ASSERT(offset + size <= m_size, "Freeing range out of bounds");
+    if (size == 0u)
+        return;
+
+    // find the first free range after the released one
+    auto next = std::upper_bound(m_freeRanges.begin(), m_freeRanges.end(), offset,
+        [](SizeType value, const Range& range) { return value < range.offset; });
+
+    HEPHAESTUS_LOG_ASSERT(next == m_freeRanges.end() || offset + size <= next->offset,
+        "Freeing range that overlaps with a free range");
+
+    const bool mergeWithNext = next != m_freeRanges.end() && offset + size == next->offset;
+    const bool mergeWithPrev = next != m_freeRanges.begin() &&
+        (next - 1)->offset + (next - 1)->size == offset;
+
+    if (mergeWithPrev && mergeWithNext)
+    {
+        (next - 1)->size += size + next->size;
+        m_freeRanges.erase(next);
+    }
+    else if (mergeWithPrev)
+        (next - 1)->size += size;
+    else if (mergeWithNext)
+    {
+        next->offset = offset;
+        next->size += size;
+    }
+    else
+        m_freeRanges.insert(next, { offset, size });
+
+    m_freeSize += size;
+}
+
+void
+RangeAllocator::Grow(SizeType newSize)
+{
+    HEPHAESTUS_LOG_ASSERT(newSize >= m_size, "Range allocator cannot shrink");
+    if (newSize == m_size)
+        return;
+
+    const SizeType addedSize = newSize - m_size;
+    if (!m_freeRanges.empty() && m_freeRanges.back().offset + m_freeRanges.back().size == m_size)
+        m_freeRanges.back().size += addedSize;
+    else
+        m_freeRanges.push_back({ m_size, addedSize });
+
+    m_size = newSize;
+    m_freeSize += addedSize;
+}
+
+} // hephaestus
@@ -38,7 +38,7 @@ RendererBase::Init(const InitInfo& info)
     }
 
     if (!VulkanUtils::CreateRenderPass(m_deviceManager,
-        info.colorFormat, info.outputImageLayout, m_renderPass))
+        info.colorFormat, info.outputImageLayout, m_renderPass, info.numViews, info.auxFormats))
         return false;
 
     return true;
@@ -113,6 +113,7 @@ SwapChainRenderer::RenderBegin(RenderInfo& renderInfo, RenderStats& stats)
         renderInfo.frameInfo.image = m_swapChainInfo.imageRefs[imageIndex].image;
         renderInfo.frameInfo.view = m_swapChainInfo.imageRefs[imageIndex].view.get();
         renderInfo.frameInfo.renderPass = m_renderPass.get();
+        renderInfo.frameInfo.frameIndex = renderInfo.virtualFrameIndex;
     }
 
     // begin recording commands
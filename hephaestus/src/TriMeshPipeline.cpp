@@ -2,6 +2,8 @@
 
 #include <hephaestus/Log.h>
 
+#include <algorithm>
+#include <cstring>
 #include <vector>
 
 
@@ -11,57 +13,254 @@ namespace hephaestus
 void 
 TriMeshPipeline::RecordDrawCommands(const VulkanUtils::FrameUpdateInfo& frameInfo) const
 {
+    // the previous use of the frame has completed, resources retired since are not used by the device anymore
+    ReleaseRetiredResources(frameInfo.frameIndex);
+
     // bind pipeline
     frameInfo.drawCmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_vulkanPipeline.get());
 
+    if (m_indirectDraw)
+    {
+        RecordIndirectDrawCommands(frameInfo);
+        return;
+    }
+
     // draw the indexed vertex buffer
     if (m_vertexBufferInfo.bufferHandle && m_indexBufferInfo.bufferHandle)
     {
-        frameInfo.drawCmdBuffer.bindVertexBuffers(0, m_vertexBufferInfo.bufferHandle.get(), (VkDeviceSize)0u);
+        HEPHAESTUS_LOG_ASSERT(frameInfo.frameIndex < m_numFramesInFlight, "Frame index out of range");
+        UpdateSceneUniformBuffer(frameInfo.frameIndex);
+        if (!m_pushConstantTransforms)
+            UpdateMeshUniformBuffer(frameInfo.frameIndex);
+        const uint32_t sceneUBOffset = frameInfo.frameIndex * m_sceneUBStride;
+        const uint32_t frameUBOffset = frameInfo.frameIndex * m_meshUBFrameSize;
+
+        const VkDeviceSize vertexFrameOffset = PrepareVertexBufferFrame(frameInfo.frameIndex);
+        frameInfo.drawCmdBuffer.bindVertexBuffers(0, m_vertexBufferInfo.bufferHandle.get(), vertexFrameOffset);
+        if (m_instancing)
+        {
+            const VkDeviceSize instanceFrameOffset = UpdateInstanceBuffer(frameInfo.frameIndex);
+            frameInfo.drawCmdBuffer.bindVertexBuffers(1, m_instanceBufferInfo.bufferHandle.get(), instanceFrameOffset);
+        }
         frameInfo.drawCmdBuffer.bindIndexBuffer(
             m_indexBufferInfo.bufferHandle.get(), (VkDeviceSize)0u, vk::IndexType::eUint32);
         
         // bind descriptor set 0 to scene uniform data for all meshes (view, projection, etc)
         frameInfo.drawCmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_pipelineLayout.get(), 
             0, // set 0 
-            m_sceneDescSetInfo.handle.get(), nullptr);
+            m_sceneDescSetInfo.handle.get(), sceneUBOffset);
 
         for (size_t i = 0; i < m_meshInfos.size(); ++i)
         {
+            // skip meshes without index data, as in the indirect draw commands
             const MeshInfo& info = m_meshInfos[i];
-            if (info.visible)
+            if (info.visible && info.indexOffset >= 0 && info.indexSize > 0u)
             {
-                HEPHAESTUS_LOG_ASSERT(info.indexOffset >= 0, "Cannot bind sub mesh without valid index offset");
                 HEPHAESTUS_LOG_ASSERT(info.descriptorSetInfo.handle, "Cannot bind sub mesh without valid descriptor set");
 
-                // bind descriptor set 1 to mesh uniform buffer & texture
-                frameInfo.drawCmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_pipelineLayout.get(), 
-                    1, // set 1
-                    info.descriptorSetInfo.handle.get(), nullptr);
+                if (m_pushConstantTransforms)
+                {
+                    // bind descriptor set 1 to mesh texture, the mesh data are recorded in the command buffer
+                    frameInfo.drawCmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_pipelineLayout.get(), 
+                        1, // set 1
+                        info.descriptorSetInfo.handle.get(), nullptr);
+
+                    MeshTransformPushConstants pushConstants = {};
+                    pushConstants.meshID = (MeshIDType)i;
+                    pushConstants.materialIndex = info.materialIndex;
+                    std::memcpy(pushConstants.model.data(), info.ubData.data(), sizeof(MeshUBData));
+                    frameInfo.drawCmdBuffer.pushConstants(m_pipelineLayout.get(), 
+                        vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, 
+                        0u, (uint32_t)sizeof(MeshTransformPushConstants), &pushConstants);
+                }
+                else
+                {
+                    // bind descriptor set 1 to mesh texture & the mesh data in the frame region of the uniform buffer
+                    const uint32_t meshUBOffset = frameUBOffset + (uint32_t)i * m_meshUBStride;
+                    frameInfo.drawCmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_pipelineLayout.get(), 
+                        1, // set 1
+                        info.descriptorSetInfo.handle.get(), meshUBOffset);
+
+                    const MeshPushConstants pushConstants = { (MeshIDType)i };
+                    frameInfo.drawCmdBuffer.pushConstants(m_pipelineLayout.get(), vk::ShaderStageFlagBits::eFragment, 
+                        0u, (uint32_t)sizeof(MeshPushConstants), &pushConstants);
+                }
 
                 // compute offsets & index size from bytes to vertex indices as expected by drawIndexed()
-                const uint32_t meshIndexSize =
-                    (i + 1 == m_meshInfos.size() ? 
-                    (uint32_t)m_indexBufferCurSize : 
-                    (uint32_t)m_meshInfos[i + 1].indexOffset) - (uint32_t)info.indexOffset;
-
-                const uint32_t indicesCount = meshIndexSize / VertexData::IndexSize;
+                const uint32_t indicesCount = (uint32_t)info.indexSize / VertexData::IndexSize;
                 const uint32_t indexOffset = (uint32_t)info.indexOffset / VertexData::IndexSize;
                 const uint32_t vertexOffset = (int32_t)info.vertexOffset / sizeof(VertexData);
 
-                frameInfo.drawCmdBuffer.drawIndexed(indicesCount, 1, indexOffset, vertexOffset, 0);
+                // all instances of the mesh in one draw
+                const uint32_t instanceCount = m_instancing ? std::max(1u, (uint32_t)info.instances.size()) : 1u;
+                const uint32_t firstInstance = m_instancing ? info.instanceOffset : 0u;
+
+                frameInfo.drawCmdBuffer.drawIndexed(indicesCount, instanceCount, indexOffset, vertexOffset, firstInstance);
             }
         }
     }
 }
 
+void 
+TriMeshPipeline::RecordIndirectDrawCommands(const VulkanUtils::FrameUpdateInfo& frameInfo) const
+{
+    if (!m_vertexBufferInfo.bufferHandle || !m_indexBufferInfo.bufferHandle)
+        return;
+
+    HEPHAESTUS_LOG_ASSERT(frameInfo.frameIndex < m_numFramesInFlight, "Frame index out of range");
+    UpdateSceneUniformBuffer(frameInfo.frameIndex);
+    UpdateMeshUniformBuffer(frameInfo.frameIndex);
+    UpdateIndirectBuffer(frameInfo.frameIndex);
+    const uint32_t drawCount = m_drawFrameCounts[frameInfo.frameIndex];
+    if (drawCount == 0u)
+        return;
+
+    const VkDeviceSize vertexFrameOffset = PrepareVertexBufferFrame(frameInfo.frameIndex);
+    frameInfo.drawCmdBuffer.bindVertexBuffers(0, m_vertexBufferInfo.bufferHandle.get(), vertexFrameOffset);
+    if (m_instancing)
+    {
+        const VkDeviceSize instanceFrameOffset = UpdateInstanceBuffer(frameInfo.frameIndex);
+        frameInfo.drawCmdBuffer.bindVertexBuffers(1, m_instanceBufferInfo.bufferHandle.get(), instanceFrameOffset);
+    }
+    frameInfo.drawCmdBuffer.bindIndexBuffer(
+        m_indexBufferInfo.bufferHandle.get(), (VkDeviceSize)0u, vk::IndexType::eUint32);
+
+    // set 0 has the scene uniform data & the model transforms of all meshes for the frame
+    const uint32_t dynamicOffsets[2] = { 
+        frameInfo.frameIndex * m_sceneUBStride, frameInfo.frameIndex * m_meshUBFrameSize };
+    frameInfo.drawCmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_pipelineLayout.get(), 
+        0, 1, &m_sceneDescSetInfo.handle.get(), 2, dynamicOffsets);
+    if (m_bindlessTextures)
+    {
+        // textures of all meshes, indexed by the mesh ID in the shader
+        UpdateBindlessDescriptorSet(frameInfo.frameIndex);
+        frameInfo.drawCmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_pipelineLayout.get(), 
+            1, m_bindlessDescSetInfos[frameInfo.frameIndex].handle.get(), nullptr);
+    }
+
+    // all draws in a single call if multi draws are supported, otherwise one call per draw but still without
+    // any state changes between draws
+    const uint32_t commandSize = (uint32_t)sizeof(vk::DrawIndexedIndirectCommand);
+    const VkDeviceSize frameOffset = (VkDeviceSize)frameInfo.frameIndex * m_meshUBCapacity * commandSize;
+    if (m_deviceManager.GetEnabledFeatures().multiDrawIndirect)
+    {
+        const uint32_t maxDrawCount = std::max(1u, 
+            m_deviceManager.GetPhysicalDevice().getProperties().limits.maxDrawIndirectCount);
+        for (uint32_t first = 0u; first < drawCount; first += maxDrawCount)
+        {
+            frameInfo.drawCmdBuffer.drawIndexedIndirect(m_indirectBufferInfo.bufferHandle.get(), 
+                frameOffset + (VkDeviceSize)first * commandSize, std::min(maxDrawCount, drawCount - first), 
+                commandSize);
+        }
+    }
+    else
+    {
+        for (uint32_t i = 0u; i < drawCount; ++i)
+        {
+            frameInfo.drawCmdBuffer.drawIndexedIndirect(m_indirectBufferInfo.bufferHandle.get(), 
+                frameOffset + (VkDeviceSize)i * commandSize, 1u, commandSize);
+        }
+    }
+}
+
+void
+TriMeshPipeline::UpdateIndirectBuffer(uint32_t frameIndex) const
+{
+    // same as the uniform data, the commands of the frame region are only rewritten when they have changed
+    if (m_drawFrameVersions[frameIndex] == m_drawVersion)
+        return;
+
+    const uint32_t commandSize = (uint32_t)sizeof(vk::DrawIndexedIndirectCommand);
+    const VkDeviceSize frameOffset = (VkDeviceSize)frameIndex * m_meshUBCapacity * commandSize;
+    vk::DrawIndexedIndirectCommand* commands = reinterpret_cast<vk::DrawIndexedIndirectCommand*>(
+        m_indirectBufferInfo.GetMappedData() + frameOffset);
+    uint32_t drawCount = 0u;
+    for (size_t i = 0; i < m_meshInfos.size(); ++i)
+    {
+        const MeshInfo& info = m_meshInfos[i];
+        if (!info.visible || info.indexOffset < 0 || info.indexSize == 0u)
+            continue;
+        if (m_bindlessTextures && i >= m_bindlessTextureCount)
+            continue;
+
+        // the first instance is the mesh ID, used by the shaders to index the mesh data, with instancing the
+        // shaders get the mesh ID from the instance data instead
+        vk::DrawIndexedIndirectCommand& command = commands[drawCount++];
+        command.indexCount = (uint32_t)info.indexSize / VertexData::IndexSize;
+        command.instanceCount = m_instancing ? std::max(1u, (uint32_t)info.instances.size()) : 1u;
+        command.firstIndex = (uint32_t)info.indexOffset / VertexData::IndexSize;
+        command.vertexOffset = (int32_t)(info.vertexOffset / sizeof(VertexData));
+        command.firstInstance = m_instancing ? info.instanceOffset : (uint32_t)i;
+    }
+
+    if (drawCount > 0u)
+    {
+        m_deviceManager.GetMemoryAllocator().Flush(
+            m_indirectBufferInfo.allocation.Get(), frameOffset, (VkDeviceSize)drawCount * commandSize);
+    }
+
+    m_drawFrameCounts[frameIndex] = drawCount;
+    m_drawFrameVersions[frameIndex] = m_drawVersion;
+}
+
 bool 
 TriMeshPipeline::SetupPipeline(vk::RenderPass renderPass, 
     const PipelineBase::ShaderParams& shaderParams,
     const TriMeshPipeline::SetupParams& params)
 {
-    if (!SetupDescriptorSets())
+    if (params.indirectDraw && !m_deviceManager.GetEnabledFeatures().drawIndirectFirstInstance)
+    {
+        HEPHAESTUS_LOG_ERROR("Indirect draws require the drawIndirectFirstInstance feature");
+        return false;
+    }
+    if (params.pushConstantTransforms && params.indirectDraw)
+    {
+        HEPHAESTUS_LOG_ERROR("Push constant transforms are not supported with indirect draws");
+        return false;
+    }
+    if (params.pushConstantTransforms && params.instancing)
+    {
+        HEPHAESTUS_LOG_ERROR("Push constant transforms are not supported with instancing");
+        return false;
+    }
+    if (params.pushConstantTransforms && 
+        m_deviceManager.GetPhysicalDevice().getProperties().limits.maxPushConstantsSize < sizeof(MeshTransformPushConstants))
+    {
+        HEPHAESTUS_LOG_ERROR("Push constant transforms exceed the max push constants size");
         return false;
+    }
+    if (params.bindlessTextures)
+    {
+        const vk::PhysicalDeviceDescriptorIndexingFeaturesEXT& indexingFeatures = 
+            m_deviceManager.GetEnabledDescriptorIndexingFeatures();
+        if (!params.indirectDraw)
+        {
+            HEPHAESTUS_LOG_ERROR("Bindless textures are only supported with indirect draws");
+            return false;
+        }
+        if (!indexingFeatures.shaderSampledImageArrayNonUniformIndexing || 
+            !indexingFeatures.descriptorBindingPartiallyBound || !indexingFeatures.runtimeDescriptorArray)
+        {
+            HEPHAESTUS_LOG_ERROR("Bindless textures require non uniform indexing & partially bound runtime arrays");
+            return false;
+        }
+    }
+
+    // the modes are only set once all the params are validated
+    m_indirectDraw = params.indirectDraw;
+    m_instancing = params.instancing;
+    m_pushConstantTransforms = params.pushConstantTransforms;
+    m_bindlessTextures = params.bindlessTextures;
+
+    if (!SetupDescriptorSets(params))
+        return false;
+
+    if (m_instancing)
+    {
+        UpdateInstanceOffsets();
+        if (!CreateInstanceBuffer(params.numFramesInFlight, m_numInstances))
+            return false;
+    }
 
     if (!CreatePipeline(renderPass, shaderParams, params))
         return false;
@@ -70,7 +269,7 @@ TriMeshPipeline::SetupPipeline(vk::RenderPass renderPass,
 }
 
 bool 
-TriMeshPipeline::SetupDescriptorSets()
+TriMeshPipeline::SetupDescriptorSets(const SetupParams& params)
 {
     if (!m_descriptorPool)
         return false;
@@ -80,10 +279,19 @@ TriMeshPipeline::SetupDescriptorSets()
         std::vector<vk::DescriptorSetLayoutBinding> layoutBindings;
         layoutBindings.emplace_back(    // view binding
                 0,
-                vk::DescriptorType::eUniformBuffer,
+                vk::DescriptorType::eUniformBufferDynamic,
+                1,
+                vk::ShaderStageFlagBits::eVertex,
+                nullptr);
+        if (m_indirectDraw)
+        {
+            layoutBindings.emplace_back(    // model transforms of all meshes
+                1,
+                vk::DescriptorType::eStorageBufferDynamic,
                 1,
                 vk::ShaderStageFlagBits::eVertex,
                 nullptr);
+        }
         
         vk::DescriptorSetLayoutCreateInfo layoutCreateInfo(
             vk::DescriptorSetLayoutCreateFlagBits(), (uint32_t)layoutBindings.size(), layoutBindings.data());
@@ -92,15 +300,18 @@ TriMeshPipeline::SetupDescriptorSets()
             m_deviceManager.GetDevice().createDescriptorSetLayoutUnique(layoutCreateInfo, nullptr));
     }
 
-    // create mesh desc set layout (1)
+    // create mesh desc set layout (1), the model transform is a push constant with push constant transforms
     {
         std::vector<vk::DescriptorSetLayoutBinding> layoutBindings;
-        layoutBindings.emplace_back(    // model transform binding
-            0,
-            vk::DescriptorType::eUniformBuffer,
-            1,
-            vk::ShaderStageFlagBits::eVertex,
-            nullptr);
+        if (!m_pushConstantTransforms)
+        {
+            layoutBindings.emplace_back(    // model transform binding
+                0,
+                vk::DescriptorType::eUniformBufferDynamic,
+                1,
+                vk::ShaderStageFlagBits::eVertex,
+                nullptr);
+        }
         layoutBindings.emplace_back(    // texture binding
             1,		// binding
             vk::DescriptorType::eCombinedImageSampler,
@@ -115,90 +326,328 @@ TriMeshPipeline::SetupDescriptorSets()
             m_deviceManager.GetDevice().createDescriptorSetLayoutUnique(layoutCreateInfo, nullptr));
     }
 
-    // setup view descriptor set
+    // setup view descriptor set, the scene data of each frame in flight are addressed with a dynamic offset
     {
-        if (!CreateUniformBuffer(m_sceneUBData.bufferInfo, SceneUBData::UniformSize))
-            return false;
-
-        // allocate descriptor set
+        const VkDeviceSize alignment = GetUniformBufferAlignment();
+        if (params.numViews == 0u || params.numViews > MaxNumViews)
         {
-            vk::DescriptorSetAllocateInfo allocInfo(
-                m_descriptorPool.get(), 1, &m_sceneDescSetLayout.get());
-            std::vector<vk::DescriptorSet> descSet;
-            HEPHAESTUS_CHECK_RESULT_RAW(descSet, m_deviceManager.GetDevice().allocateDescriptorSets(allocInfo));
-            vk::PoolFree<vk::Device, vk::DescriptorPool, VulkanDispatcher> deleter(
-                m_deviceManager.GetDevice(), m_descriptorPool.get());
-            m_sceneDescSetInfo.handle = VulkanUtils::DescriptorSetHandle(descSet.front(), deleter);
+            HEPHAESTUS_LOG_ERROR("Invalid number of views %u", params.numViews);
+            return false;
         }
+        m_numViews = params.numViews;
+        m_viewUBData.resize(m_numViews > 1u ? m_numViews : 0u);
+        m_sceneUBStride = (uint32_t)(((GetSceneUniformSize() + alignment - 1u) / alignment) * alignment);
+        m_sceneUBFrameVersions.assign(params.numFramesInFlight, UINT64_MAX);
+        if (!CreateUniformBuffer(m_sceneUBData.bufferInfo, params.numFramesInFlight * m_sceneUBStride))
+            return false;
+
+        if (!AllocateSceneDescriptorSet())
+            return false;
+    }
+
+    // setup mesh descriptor sets, all pointing to the same uniform buffer (only the texture with push constants)
+    if (m_pushConstantTransforms)
+        m_numFramesInFlight = params.numFramesInFlight;
+    else if (!CreateMeshUniformBuffer(params.numFramesInFlight, (uint32_t)m_meshInfos.size()))
+        return false;
+    if (m_indirectDraw)
+    {
+        // no descriptor sets per mesh
+        UpdateSceneMeshDataDescriptor();
+        if (m_bindlessTextures && !SetupBindlessDescriptorSet(params))
+            return false;
+        return CreateIndirectBuffer(params.numFramesInFlight, m_meshUBCapacity);
+    }
+    if (!CreateDefaultTexture())
+        return false;
+    for (MeshInfo& info : m_meshInfos)
+    {
+        if (!info.removed && !SetupMeshDescriptorSet(info.descriptorSetInfo, m_meshUBBufferInfo, info.textureInfo))
+            return false;
+    }
+
+    return true;
+}
+
+bool
+TriMeshPipeline::SetupBindlessDescriptorSet(const SetupParams& params)
+{
+    const vk::PhysicalDeviceLimits& limits = m_deviceManager.GetPhysicalDevice().getProperties().limits;
+    m_bindlessTextureCount = std::min(std::max(1u, params.maxBindlessTextures), 
+        std::min(limits.maxPerStageDescriptorSampledImages, limits.maxDescriptorSetSampledImages));
+    if (m_meshInfos.size() > m_bindlessTextureCount)
+    {
+        HEPHAESTUS_LOG_ERROR("Number of meshes exceeds the max number of bindless textures %u", m_bindlessTextureCount);
+        return false;
+    }
+
+    // a set per frame in flight, so that texture changes are written to the set of the frame being recorded
+    // instead of waiting for the sets used by frames in flight
+    const uint32_t numSets = std::max(1u, params.numFramesInFlight);
+    {
+        vk::DescriptorPoolSize poolSize(vk::DescriptorType::eCombinedImageSampler, numSets * m_bindlessTextureCount);
+        vk::DescriptorPoolCreateInfo poolCreateInfo(
+            vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet, numSets, 1u, &poolSize);
+        HEPHAESTUS_CHECK_RESULT_HANDLE(m_bindlessDescPool, 
+            m_deviceManager.GetDevice().createDescriptorPoolUnique(poolCreateInfo, nullptr));
+    }
+
+    // create layout for the bindless textures desc set (1), textures of removed meshes are never accessed
+    {
+        vk::DescriptorSetLayoutBinding layoutBinding(
+            0,		// binding
+            vk::DescriptorType::eCombinedImageSampler,
+            m_bindlessTextureCount,		// count
+            vk::ShaderStageFlagBits::eFragment,
+            nullptr);		// immutable samplers
+        vk::DescriptorBindingFlagsEXT bindingFlags = vk::DescriptorBindingFlagBitsEXT::ePartiallyBound;
+        vk::DescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsCreateInfo(1, &bindingFlags);
+
+        vk::DescriptorSetLayoutCreateInfo layoutCreateInfo(vk::DescriptorSetLayoutCreateFlagBits(), 1, &layoutBinding);
+        layoutCreateInfo.pNext = &bindingFlagsCreateInfo;
+
+        HEPHAESTUS_CHECK_RESULT_HANDLE(m_bindlessDescSetLayout,
+            m_deviceManager.GetDevice().createDescriptorSetLayoutUnique(layoutCreateInfo, nullptr));
+    }
+
+    // allocate descriptor sets
+    {
+        std::vector<vk::DescriptorSetLayout> layouts(numSets, m_bindlessDescSetLayout.get());
+        vk::DescriptorSetAllocateInfo allocInfo(m_bindlessDescPool.get(), numSets, layouts.data());
+        std::vector<vk::DescriptorSet> descSets;
+        HEPHAESTUS_CHECK_RESULT_RAW(descSets, m_deviceManager.GetDevice().allocateDescriptorSets(allocInfo));
+        vk::PoolFree<vk::Device, vk::DescriptorPool, VulkanDispatcher> deleter(
+            m_deviceManager.GetDevice(), m_bindlessDescPool.get());
+        m_bindlessDescSetInfos.resize(numSets);
+        for (uint32_t i = 0u; i < numSets; ++i)
+            m_bindlessDescSetInfos[i].handle = VulkanUtils::DescriptorSetHandle(descSets[i], deleter);
+        m_bindlessFrameVersions.assign(numSets, 0u);
+    }
+
+    if (!CreateDefaultTexture())
+        return false;
+
+    for (MeshIDType meshId = 0u; meshId < (MeshIDType)m_meshInfos.size(); ++meshId)
+    {
+        if (!m_meshInfos[meshId].removed)
+            MarkBindlessTexture(meshId);
+    }
+
+    return true;
+}
+
+bool
+TriMeshPipeline::CreateDefaultTexture()
+{
+    // default texture for meshes without texture, keeps the vertex color
+    if (!VulkanUtils::CreateImageTextureInfo(m_deviceManager, 1u, 1u, m_defaultTextureInfo))
+        return false;
+    const uint32_t white = 0xFFFFFFFFu;
+    return m_deviceManager.GetUploadManager().UploadImage(reinterpret_cast<const char*>(&white), sizeof(white), 
+        m_defaultTextureInfo.imageHandle.get(), 1u, 1u, m_lastUploadTicket);
+}
+
+void
+TriMeshPipeline::MarkBindlessTexture(MeshIDType meshId)
+{
+    HEPHAESTUS_LOG_ASSERT(meshId < m_bindlessTextureCount, "Sub mesh ID out of bindless textures range");
+
+    // the array element is written to the set of each frame when the frame is next recorded
+    m_meshInfos[meshId].bindlessVersion = ++m_bindlessVersion;
+}
+
+void
+TriMeshPipeline::UpdateBindlessDescriptorSet(uint32_t frameIndex) const
+{
+    // same as the uniform data, the set of the frame is no longer used by the device when the frame is recorded 
+    // & only the textures changed since its last update are written
+    const uint64_t frameVersion = m_bindlessFrameVersions[frameIndex];
+    if (frameVersion == m_bindlessVersion)
+        return;
+
+    const uint32_t numMeshes = std::min((uint32_t)m_meshInfos.size(), m_bindlessTextureCount);
+    std::vector<vk::DescriptorImageInfo> imageInfos;
+    std::vector<MeshIDType> meshIds;
+    for (MeshIDType meshId = 0u; meshId < numMeshes; ++meshId)
+    {
+        const MeshInfo& info = m_meshInfos[meshId];
+        if (info.removed || info.bindlessVersion <= frameVersion)
+            continue;
 
-        vk::DescriptorImageInfo imageInfo;
-        vk::DescriptorBufferInfo bufferInfo(
-            m_sceneUBData.bufferInfo.bufferHandle.get(),
-            0,		// offset
-            m_sceneUBData.bufferInfo.size);
+        const VulkanUtils::ImageInfo& textureInfo = info.textureInfo.imageHandle ? 
+            info.textureInfo : m_defaultTextureInfo;
+        imageInfos.emplace_back(
+            textureInfo.sampler.get(),
+            textureInfo.view.get(),
+            vk::ImageLayout::eShaderReadOnlyOptimal);
+        meshIds.push_back(meshId);
+    }
 
-        std::vector<vk::WriteDescriptorSet> descriptorWrites;
+    std::vector<vk::WriteDescriptorSet> descriptorWrites;
+    descriptorWrites.reserve(imageInfos.size());
+    for (size_t i = 0; i < imageInfos.size(); ++i)
+    {
         descriptorWrites.emplace_back(
-            m_sceneDescSetInfo.handle.get(),
-            0,		// destination binding
-            0,		// destination array element
-            1,		// descriptor count
-            vk::DescriptorType::eUniformBuffer,
+            m_bindlessDescSetInfos[frameIndex].handle.get(),
+            0,		        // destination binding
+            meshIds[i],	    // destination array element
+            1,		        // descriptor count
+            vk::DescriptorType::eCombinedImageSampler,
+            &imageInfos[i], // image info
             nullptr,
-            &bufferInfo,	// buffer info
             nullptr);
-
+    }
+    if (!descriptorWrites.empty())
         m_deviceManager.GetDevice().updateDescriptorSets(descriptorWrites, nullptr);
+
+    m_bindlessFrameVersions[frameIndex] = m_bindlessVersion;
+}
+
+bool
+TriMeshPipeline::AllocateSceneDescriptorSet()
+{
+    // retired scene sets may still hold the pool memory, running out of it is expected so the result is not asserted
+    vk::DescriptorSetAllocateInfo allocInfo(m_descriptorPool.get(), 1, &m_sceneDescSetLayout.get());
+    auto result = m_deviceManager.GetDevice().allocateDescriptorSets(allocInfo);
+    if (result.result != vk::Result::eSuccess)
+    {
+        HEPHAESTUS_LOG_ERROR("Failed to allocate scene descriptor set");
+        return false;
     }
+    vk::PoolFree<vk::Device, vk::DescriptorPool, VulkanDispatcher> deleter(
+        m_deviceManager.GetDevice(), m_descriptorPool.get());
+    m_sceneDescSetInfo.handle = VulkanUtils::DescriptorSetHandle(result.value.front(), deleter);
+
+    vk::DescriptorBufferInfo bufferInfo(
+        m_sceneUBData.bufferInfo.bufferHandle.get(),
+        0,		// offset, the dynamic offset is added when binding
+        GetSceneUniformSize());
+
+    vk::WriteDescriptorSet descriptorWrite(
+        m_sceneDescSetInfo.handle.get(),
+        0,		// destination binding
+        0,		// destination array element
+        1,		// descriptor count
+        vk::DescriptorType::eUniformBufferDynamic,
+        nullptr,
+        &bufferInfo,	// buffer info
+        nullptr);
+
+    m_deviceManager.GetDevice().updateDescriptorSets(descriptorWrite, nullptr);
 
-    // setup mesh descriptor sets
-    for (MeshInfo& info : m_meshInfos)
+    return true;
+}
+
+void
+TriMeshPipeline::UpdateSceneMeshDataDescriptor()
+{
+    // the frame region of the mesh data is addressed with a dynamic offset
+    vk::DescriptorBufferInfo bufferInfo(
+        m_meshUBBufferInfo.bufferHandle.get(),
+        0,		// offset, the dynamic offset is added when binding
+        m_meshUBFrameSize);
+
+    vk::WriteDescriptorSet descriptorWrite(
+        m_sceneDescSetInfo.handle.get(),
+        1,		// destination binding
+        0,		// destination array element
+        1,		// descriptor count
+        vk::DescriptorType::eStorageBufferDynamic,
+        nullptr,
+        &bufferInfo,	// buffer info
+        nullptr);
+
+    m_deviceManager.GetDevice().updateDescriptorSets(descriptorWrite, nullptr);
+}
+
+bool
+TriMeshPipeline::AllocateMeshDescriptorSet(VulkanUtils::DescriptorSetInfo& descSetInfo)
+{
+    // try the pools from the largest, running out of pool memory is expected so the result is not asserted
+    vk::DescriptorSet descSet;
+    vk::DescriptorPool pool;
+    for (auto it = m_meshDescPools.rbegin(); !descSet && it != m_meshDescPools.rend(); ++it)
     {
-        if(!CreateUniformBuffer(info.ubData.bufferInfo, MeshUBData::UniformSize))
+        vk::DescriptorSetAllocateInfo allocInfo(it->get(), 1, &m_meshDescSetLayout.get());
+        auto result = m_deviceManager.GetDevice().allocateDescriptorSets(allocInfo);
+        if (result.result == vk::Result::eSuccess)
+        {
+            descSet = result.value.front();
+            pool = it->get();
+        }
+    }
+
+    // all pools are full, add a pool with twice the sets of the last one
+    if (!descSet)
+    {
+        const uint32_t poolSize = std::max(64u, 2u * m_meshDescPoolSize);
+        std::vector<vk::DescriptorPoolSize> poolSizes;
+        poolSizes.emplace_back(vk::DescriptorType::eCombinedImageSampler, poolSize);
+        if (!m_pushConstantTransforms)
+            poolSizes.emplace_back(vk::DescriptorType::eUniformBufferDynamic, poolSize);
+        vk::DescriptorPoolCreateInfo poolCreateInfo(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet, poolSize,
+            (uint32_t)poolSizes.size(), poolSizes.data());
+        VulkanUtils::DescriptorPoolHandle poolHandle;
+        HEPHAESTUS_CHECK_RESULT_HANDLE(poolHandle,
+            m_deviceManager.GetDevice().createDescriptorPoolUnique(poolCreateInfo, nullptr));
+        if (!poolHandle)
+        {
+            HEPHAESTUS_LOG_ERROR("Failed to create mesh descriptor pool");
+            return false;
+        }
+
+        vk::DescriptorSetAllocateInfo allocInfo(poolHandle.get(), 1, &m_meshDescSetLayout.get());
+        auto result = m_deviceManager.GetDevice().allocateDescriptorSets(allocInfo);
+        if (result.result != vk::Result::eSuccess)
+        {
+            HEPHAESTUS_LOG_ERROR("Failed to allocate mesh descriptor set");
             return false;
-        SetupMeshDescriptorSet(info.descriptorSetInfo, info.ubData.bufferInfo, info.textureInfo);
+        }
+        descSet = result.value.front();
+        pool = poolHandle.get();
+        m_meshDescPools.push_back(std::move(poolHandle));
+        m_meshDescPoolSize = poolSize;
     }
 
+    vk::PoolFree<vk::Device, vk::DescriptorPool, VulkanDispatcher> deleter(m_deviceManager.GetDevice(), pool);
+    descSetInfo.handle = VulkanUtils::DescriptorSetHandle(descSet, deleter);
+
     return true;
 }
 
-void 
+bool
 TriMeshPipeline::SetupMeshDescriptorSet(VulkanUtils::DescriptorSetInfo& descSetInfo,
     const VulkanUtils::BufferInfo& bufferInfo, const VulkanUtils::ImageInfo& textureInfo)
 {
-    // allocate descriptor set
-    {
-        vk::DescriptorSetAllocateInfo allocInfo(
-            m_descriptorPool.get(), 1, &m_meshDescSetLayout.get());
-        std::vector<vk::DescriptorSet> descSet;
-        HEPHAESTUS_CHECK_RESULT_RAW(descSet, m_deviceManager.GetDevice().allocateDescriptorSets(allocInfo));
-        vk::PoolFree<vk::Device, vk::DescriptorPool, VulkanDispatcher> deleter(
-            m_deviceManager.GetDevice(), m_descriptorPool.get());
-        descSetInfo.handle = VulkanUtils::DescriptorSetHandle(descSet.front(), deleter);
-    }
+    if (!AllocateMeshDescriptorSet(descSetInfo))
+        return false;
 
     vk::DescriptorImageInfo imageInfo;
     vk::DescriptorBufferInfo descBufferInfo(
         bufferInfo.bufferHandle.get(),
-        0,		// offset
-        bufferInfo.size);
+        0,		// offset, the dynamic offset is added when binding
+        sizeof(MeshUBData));
 
     std::vector<vk::WriteDescriptorSet> descriptorWrites;
     {
         // uniform binding for model transform
-        descriptorWrites.emplace_back(
-            descSetInfo.handle.get(),
-            0,		// destination binding
-            0,		// destination array element
-            1,		// descriptor count
-            vk::DescriptorType::eUniformBuffer,
-            nullptr,
-            &descBufferInfo,	// buffer info
-            nullptr);
-        // sampler binding for texture
+        if (!m_pushConstantTransforms)
+        {
+            descriptorWrites.emplace_back(
+                descSetInfo.handle.get(),
+                0,		// destination binding
+                0,		// destination array element
+                1,		// descriptor count
+                vk::DescriptorType::eUniformBufferDynamic,
+                nullptr,
+                &descBufferInfo,	// buffer info
+                nullptr);
+        }
+        // sampler binding for texture, the default one until the mesh texture is created
+        const VulkanUtils::ImageInfo& meshTextureInfo = textureInfo.imageHandle ? textureInfo : m_defaultTextureInfo;
         imageInfo = vk::DescriptorImageInfo(
-            textureInfo.sampler.get(),
-            textureInfo.view.get(),
+            meshTextureInfo.sampler.get(),
+            meshTextureInfo.view.get(),
             vk::ImageLayout::eShaderReadOnlyOptimal);
 
         descriptorWrites.emplace_back(
@@ -213,6 +662,8 @@ TriMeshPipeline::SetupMeshDescriptorSet(VulkanUtils::DescriptorSetInfo& descSetI
     }
 
     m_deviceManager.GetDevice().updateDescriptorSets(descriptorWrites, nullptr);
+
+    return true;
 }
 
 void
@@ -220,12 +671,21 @@ TriMeshPipeline::CreatePipelineLayout()
 {
     HEPHAESTUS_LOG_ASSERT(m_sceneDescSetLayout, "Descriptor set layout is null");
 
-    // separate sets for the scene transform (view, projection) and each mesh transform & texture
-    vk::DescriptorSetLayout layouts[2] = { m_sceneDescSetLayout.get(), m_meshDescSetLayout.get() };
+    // separate sets for the scene transform (view, projection) and each mesh transform & texture, indirect draws
+    // only use the scene set & optionally the bindless textures set
+    vk::DescriptorSetLayout layouts[2] = { m_sceneDescSetLayout.get(), 
+        m_bindlessTextures ? m_bindlessDescSetLayout.get() : m_meshDescSetLayout.get() };
+    vk::PushConstantRange pushConstantRange(
+        vk::ShaderStageFlagBits::eFragment, 0u, (uint32_t)sizeof(MeshPushConstants));
+    if (m_pushConstantTransforms)
+    {
+        pushConstantRange = vk::PushConstantRange(vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, 
+            0u, (uint32_t)sizeof(MeshTransformPushConstants));
+    }
     vk::PipelineLayoutCreateInfo layoutCreateInfo(
         vk::PipelineLayoutCreateFlags(),
-        2, layouts,
-        0, nullptr);
+        m_indirectDraw && !m_bindlessTextures ? 1u : 2u, layouts,
+        m_indirectDraw ? 0u : 1u, &pushConstantRange);
     HEPHAESTUS_CHECK_RESULT_HANDLE(m_pipelineLayout,
         m_deviceManager.GetDevice().createPipelineLayoutUnique(layoutCreateInfo, nullptr));
 }
@@ -284,9 +744,30 @@ TriMeshPipeline::CreatePipeline(vk::RenderPass renderPass,
             vk::Format::eR32G32B32Sfloat,
             (uint32_t)offsetof(struct VertexData, r));
 
+    // instance data, one 4x4 transform (a vec4 attribute per column) & the mesh ID per instance
+    vk::VertexInputBindingDescription bindingDescriptions[2] = {
+        vertexBindingDescription,
+        vk::VertexInputBindingDescription(1, sizeof(InstanceData), vk::VertexInputRate::eInstance) };
+    if (params.instancing)
+    {
+        for (uint32_t column = 0u; column < 4u; ++column)
+        {
+            vertexAttributeDescription.emplace_back(
+                4u + column,                    // instance transform column
+                bindingDescriptions[1].binding,
+                vk::Format::eR32G32B32A32Sfloat,
+                (uint32_t)(offsetof(struct InstanceData, transform) + column * 4u * sizeof(float)));
+        }
+        vertexAttributeDescription.emplace_back(
+            8,                                  // mesh ID
+            bindingDescriptions[1].binding,
+            vk::Format::eR32Uint,
+            (uint32_t)offsetof(struct InstanceData, meshID));
+    }
+
     vk::PipelineVertexInputStateCreateInfo vertexInputStateCreateInfo(
         vk::PipelineVertexInputStateCreateFlags(),
-        1, &vertexBindingDescription,
+        params.instancing ? 2u : 1u, bindingDescriptions,
         (uint32_t)vertexAttributeDescription.size(), vertexAttributeDescription.data());
 
     vk::PipelineInputAssemblyStateCreateInfo inputAssermblyCreateinfo(
@@ -326,10 +807,13 @@ TriMeshPipeline::CreatePipeline(vk::RenderPass renderPass,
             vk::ColorComponentFlagBits::eB |
             vk::ColorComponentFlagBits::eA));
 
+    // same state for all outputs, there is an attachment for each output location if any aux output is rendered
+    const std::vector<vk::PipelineColorBlendAttachmentState> colorBlendAttachmentStates(
+        params.renderOutputs ? VulkanUtils::eRENDER_OUTPUT_COUNT : 1u, colorBlendAttachmentState);
     vk::PipelineColorBlendStateCreateInfo colorBlendStateCreateInfo(
         vk::PipelineColorBlendStateCreateFlags(),
         VK_FALSE, vk::LogicOp::eCopy,		// logicOp
-        1, &colorBlendAttachmentState,
+        (uint32_t)colorBlendAttachmentStates.size(), colorBlendAttachmentStates.data(),
         { 0.f, 0.f, 0.f, 0.f });			// blendConstants
 
 
@@ -398,7 +882,207 @@ TriMeshPipeline::CreateUniformBuffer(VulkanUtils::BufferInfo& bufferInfo, uint32
     return VulkanUtils::CreateBuffer(m_deviceManager, bufferSize,
         vk::BufferUsageFlagBits::eUniformBuffer,
         vk::MemoryPropertyFlagBits::eHostVisible,
-        bufferInfo);
+        bufferInfo, VulkanMemoryAllocator::eMEMORY_USAGE_CPU_TO_GPU, true);
+}
+
+bool
+TriMeshPipeline::CreateMeshUniformBuffer(uint32_t numFramesInFlight, uint32_t capacity)
+{
+    SetMeshUniformLayout(numFramesInFlight, capacity);
+
+    const uint32_t bufferSize = numFramesInFlight * m_meshUBFrameSize;
+
+    return VulkanUtils::CreateBuffer(m_deviceManager, bufferSize,
+        m_indirectDraw ? vk::BufferUsageFlagBits::eStorageBuffer : vk::BufferUsageFlagBits::eUniformBuffer,
+        vk::MemoryPropertyFlagBits::eHostVisible,
+        m_meshUBBufferInfo, VulkanMemoryAllocator::eMEMORY_USAGE_CPU_TO_GPU, true);
+}
+
+void
+TriMeshPipeline::SetMeshUniformLayout(uint32_t numFramesInFlight, uint32_t capacity)
+{
+    HEPHAESTUS_LOG_ASSERT(numFramesInFlight > 0u, "Invalid number of frames in flight");
+
+    // with indirect draws the data are an array in the shader & only the frame regions need to be aligned
+    const VkDeviceSize alignment = m_indirectDraw ? GetStorageBufferAlignment() : GetUniformBufferAlignment();
+    m_meshUBStride = m_indirectDraw ? 
+        (uint32_t)sizeof(MeshUBData) : (uint32_t)(((sizeof(MeshUBData) + alignment - 1u) / alignment) * alignment);
+    m_numFramesInFlight = numFramesInFlight;
+    m_meshUBCapacity = std::max(1u, capacity);
+    m_meshUBFrameSize = (uint32_t)(((m_meshUBCapacity * m_meshUBStride + alignment - 1u) / alignment) * alignment);
+
+    // force a full update of every frame region on first use
+    m_meshUBFrameVersions.assign(numFramesInFlight, UINT64_MAX);
+}
+
+VkDeviceSize
+TriMeshPipeline::GetUniformBufferAlignment() const
+{
+    return std::max<VkDeviceSize>(
+        m_deviceManager.GetPhysicalDevice().getProperties().limits.minUniformBufferOffsetAlignment, 1u);
+}
+
+VkDeviceSize
+TriMeshPipeline::GetStorageBufferAlignment() const
+{
+    return std::max<VkDeviceSize>(
+        m_deviceManager.GetPhysicalDevice().getProperties().limits.minStorageBufferOffsetAlignment, 1u);
+}
+
+bool
+TriMeshPipeline::CreateIndirectBuffer(uint32_t numFramesInFlight, uint32_t capacity)
+{
+    // host visible, the commands of a frame are written when recording it
+    m_drawFrameVersions.assign(numFramesInFlight, UINT64_MAX);
+    m_drawFrameCounts.assign(numFramesInFlight, 0u);
+
+    const uint32_t bufferSize = numFramesInFlight * capacity * (uint32_t)sizeof(vk::DrawIndexedIndirectCommand);
+
+    return VulkanUtils::CreateBuffer(m_deviceManager, bufferSize,
+        vk::BufferUsageFlagBits::eIndirectBuffer,
+        vk::MemoryPropertyFlagBits::eHostVisible,
+        m_indirectBufferInfo, VulkanMemoryAllocator::eMEMORY_USAGE_CPU_TO_GPU, true);
+}
+
+bool
+TriMeshPipeline::CreateInstanceBuffer(uint32_t numFramesInFlight, uint32_t capacity)
+{
+    m_instanceCapacity = std::max(1u, capacity);
+
+    // force a full update of every frame region on first use
+    m_instanceFrameVersions.assign(numFramesInFlight, UINT64_MAX);
+
+    const uint32_t bufferSize = numFramesInFlight * m_instanceCapacity * (uint32_t)sizeof(InstanceData);
+
+    return VulkanUtils::CreateBuffer(m_deviceManager, bufferSize,
+        vk::BufferUsageFlagBits::eVertexBuffer,
+        vk::MemoryPropertyFlagBits::eHostVisible,
+        m_instanceBufferInfo, VulkanMemoryAllocator::eMEMORY_USAGE_CPU_TO_GPU, true);
+}
+
+bool
+TriMeshPipeline::UpdateInstanceOffsets()
+{
+    // instances are packed by mesh ID, meshes without instances still have a single (identity) instance
+    uint32_t numInstances = 0u;
+    for (MeshInfo& info : m_meshInfos)
+    {
+        info.instanceOffset = numInstances;
+        if (!info.removed)
+            numInstances += std::max(1u, (uint32_t)info.instances.size());
+    }
+    m_numInstances = numInstances;
+    ++m_instanceVersion;
+    ++m_drawVersion;
+
+    // the previous buffer may be used by frames in flight, it is retired once the new one is created
+    if (m_instanceBufferInfo.IsValid() && m_numInstances > m_instanceCapacity)
+    {
+        const uint32_t capacity = m_instanceCapacity;
+        VulkanUtils::BufferInfo prevBufferInfo = std::move(m_instanceBufferInfo);
+        if (CreateInstanceBuffer(m_numFramesInFlight, std::max(2u * capacity, m_numInstances)))
+        {
+            RetireBuffer(prevBufferInfo);
+            return true;
+        }
+
+        // on failure the previous buffer is restored & the caller reverts the instance changes
+        m_instanceBufferInfo.Clear();
+        m_instanceBufferInfo = std::move(prevBufferInfo);
+        m_instanceCapacity = capacity;
+        m_instanceFrameVersions.assign(m_numFramesInFlight, UINT64_MAX);
+        return false;
+    }
+
+    return true;
+}
+
+VkDeviceSize
+TriMeshPipeline::UpdateInstanceBuffer(uint32_t frameIndex) const
+{
+    const VkDeviceSize frameOffset = (VkDeviceSize)frameIndex * m_instanceCapacity * sizeof(InstanceData);
+
+    // same as the uniform data, the frame region is only rewritten when the instances have changed
+    if (m_instanceFrameVersions[frameIndex] == m_instanceVersion)
+        return frameOffset;
+
+    const Matrix4x4f identity = { { 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f } };
+    InstanceData* instanceData = reinterpret_cast<InstanceData*>(m_instanceBufferInfo.GetMappedData() + frameOffset);
+    for (size_t i = 0; i < m_meshInfos.size(); ++i)
+    {
+        const MeshInfo& info = m_meshInfos[i];
+        if (info.removed)
+            continue;
+
+        InstanceData* meshInstanceData = instanceData + info.instanceOffset;
+        if (info.instances.empty())
+        {
+            meshInstanceData->transform = identity;
+            meshInstanceData->meshID = (MeshIDType)i;
+        }
+        for (size_t k = 0; k < info.instances.size(); ++k)
+        {
+            meshInstanceData[k].transform = info.instances[k];
+            meshInstanceData[k].meshID = (MeshIDType)i;
+        }
+    }
+
+    if (m_numInstances > 0u)
+    {
+        m_deviceManager.GetMemoryAllocator().Flush(
+            m_instanceBufferInfo.allocation.Get(), frameOffset, (VkDeviceSize)m_numInstances * sizeof(InstanceData));
+    }
+
+    m_instanceFrameVersions[frameIndex] = m_instanceVersion;
+
+    return frameOffset;
+}
+
+uint32_t
+TriMeshPipeline::GetSceneUniformSize() const
+{
+    // the multiview shader declares the data of all views
+    return m_numViews > 1u ? 
+        SceneUBData::UniformSize + MaxNumViews * (uint32_t)sizeof(ViewUBData) : SceneUBData::UniformSize;
+}
+
+void
+TriMeshPipeline::UpdateSceneUniformBuffer(uint32_t frameIndex) const
+{
+    // same as the mesh data, the frame region is only written once the device is done with it
+    if (m_sceneUBFrameVersions[frameIndex] == m_sceneUBVersion)
+        return;
+
+    const VkDeviceSize frameUBOffset = (VkDeviceSize)frameIndex * m_sceneUBStride;
+    std::memcpy(m_sceneUBData.bufferInfo.GetMappedData() + frameUBOffset, 
+        m_sceneUBData.raw.data(), SceneUBData::UniformSize);
+    if (!m_viewUBData.empty())
+    {
+        std::memcpy(m_sceneUBData.bufferInfo.GetMappedData() + frameUBOffset + SceneUBData::UniformSize, 
+            m_viewUBData.data(), m_viewUBData.size() * sizeof(ViewUBData));
+    }
+    m_deviceManager.GetMemoryAllocator().Flush(
+        m_sceneUBData.bufferInfo.allocation.Get(), frameUBOffset, m_sceneUBStride);
+
+    m_sceneUBFrameVersions[frameIndex] = m_sceneUBVersion;
+}
+
+void
+TriMeshPipeline::UpdateMeshUniformBuffer(uint32_t frameIndex) const
+{
+    // the device is done with the frame region so it is safe to copy the latest mesh data
+    if (m_meshUBFrameVersions[frameIndex] == m_meshUBVersion)
+        return;
+
+    const VkDeviceSize frameUBOffset = (VkDeviceSize)frameIndex * m_meshUBFrameSize;
+    char* frameUBData = m_meshUBBufferInfo.GetMappedData() + frameUBOffset;
+    for (size_t i = 0; i < m_meshInfos.size(); ++i)
+        std::memcpy(frameUBData + i * m_meshUBStride, m_meshInfos[i].ubData.data(), sizeof(MeshUBData));
+
+    m_deviceManager.GetMemoryAllocator().Flush(
+        m_meshUBBufferInfo.allocation.Get(), frameUBOffset, m_meshInfos.size() * m_meshUBStride);
+
+    m_meshUBFrameVersions[frameIndex] = m_meshUBVersion;
 }
 
 bool 
@@ -408,7 +1092,9 @@ TriMeshPipeline::MeshSetTextureData(MeshIDType meshId,
     HEPHAESTUS_LOG_ASSERT(meshId < m_meshInfos.size(), "Sub mesh ID out of range");
 
     MeshInfo& meshIdInfo = m_meshInfos[meshId];
-    return VulkanUtils::CopyImageDataStage(m_deviceManager, m_stageBufferInfo, meshIdInfo.textureInfo, textureUpdateInfo);
+    return m_deviceManager.GetUploadManager().UploadImage(textureUpdateInfo.data, textureUpdateInfo.dataSize, 
+        meshIdInfo.textureInfo.imageHandle.get(), textureUpdateInfo.width, textureUpdateInfo.height, 
+        m_lastUploadTicket);
 }
 
 void 
@@ -417,7 +1103,30 @@ TriMeshPipeline::MeshSetVisible(uint32_t meshId, bool visible)
     HEPHAESTUS_LOG_ASSERT(meshId < m_meshInfos.size(), "Sub mesh ID out of range");
 
     MeshInfo& meshIdInfo = m_meshInfos[meshId];
-    meshIdInfo.visible = visible;
+    HEPHAESTUS_LOG_ASSERT(!meshIdInfo.removed, "Cannot show removed sub mesh");
+    meshIdInfo.visible = visible && !meshIdInfo.removed;
+    ++m_drawVersion;
+}
+
+bool
+TriMeshPipeline::MeshSetInstances(MeshIDType meshId, const Matrix4x4f* transforms, uint32_t count)
+{
+    HEPHAESTUS_LOG_ASSERT(meshId < m_meshInfos.size(), "Sub mesh ID out of range");
+
+    // only update the host copy, the instance data are packed in the frame region when it is recorded
+    MeshInfo& meshIdInfo = m_meshInfos[meshId];
+    HEPHAESTUS_LOG_ASSERT(!meshIdInfo.removed, "Updating removed sub mesh");
+    std::vector<Matrix4x4f> prevInstances(transforms, transforms + count);
+    meshIdInfo.instances.swap(prevInstances);
+
+    if (!UpdateInstanceOffsets())
+    {
+        meshIdInfo.instances.swap(prevInstances);
+        UpdateInstanceOffsets();
+        return false;
+    }
+
+    return true;
 }
 
 void 
@@ -426,18 +1135,53 @@ TriMeshPipeline::Clear()
     HEPHAESTUS_LOG_ASSERT(m_deviceManager.GetDevice(), "No Vulkan device available");
     m_deviceManager.WaitDevice();
 
+    // the retired descriptor sets are destroyed before their pools
+    ReleaseAllRetiredResources();
+
     m_indexBufferInfo.Clear();
     m_indexBufferCurSize = 0u;
 
     m_sceneDescSetInfo.Clear();
     m_sceneUBData.bufferInfo.Clear();
+    m_sceneUBFrameVersions.clear();
+    m_sceneUBStride = 0u;
+    m_numViews = 1u;
+    m_viewUBData.clear();
+    m_meshUBBufferInfo.Clear();
+    m_meshUBFrameVersions.clear();
+    m_meshUBStride = 0u;
+    m_meshUBCapacity = 0u;
+    m_meshUBFrameSize = 0u;
+    m_numFramesInFlight = 0u;
+    m_indirectBufferInfo.Clear();
+    m_indirectDraw = false;
+    m_drawFrameVersions.clear();
+    m_drawFrameCounts.clear();
+    m_instanceBufferInfo.Clear();
+    m_instancing = false;
+    m_instanceCapacity = 0u;
+    m_numInstances = 0u;
+    m_instanceFrameVersions.clear();
+    m_bindlessDescSetInfos.clear();
+    m_defaultTextureInfo.Clear();
+    m_bindlessTextures = false;
+    m_bindlessTextureCount = 0u;
+    m_bindlessVersion = 0u;
+    m_bindlessFrameVersions.clear();
+    m_pushConstantTransforms = false;
     for (MeshInfo& info : m_meshInfos)
         info.Clear();
     m_meshInfos.clear();
+    m_freeMeshIDs.clear();
+    m_indexRanges.Clear();
 
     // make sure the descriptor pool is destroyed *after* we have destroyed the descriptor sets
     m_sceneDescSetLayout.reset(nullptr);
     m_meshDescSetLayout.reset(nullptr);
+    m_meshDescPools.clear();
+    m_meshDescPoolSize = 0u;
+    m_bindlessDescSetLayout.reset(nullptr);
+    m_bindlessDescPool.reset(nullptr);
 
     m_pipelineLayout.reset(nullptr);
     m_vulkanPipeline.reset(nullptr);
@@ -447,18 +1191,146 @@ TriMeshPipeline::Clear()
 bool 
 TriMeshPipeline::CreateIndexBuffer(uint32_t size)
 {
-    return VulkanUtils::CreateBuffer(m_deviceManager, size,
-        vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst,
+    m_indexBufferCurSize = 0u;
+    m_indexRanges.Init(size);
+
+    // also a transfer source so that the data can be moved to a new buffer
+    return VulkanUtils::CreateBuffer(m_deviceManager, size, GetIndexBufferUsage(),
         vk::MemoryPropertyFlagBits::eDeviceLocal, m_indexBufferInfo);
 }
 
+bool
+TriMeshPipeline::GrowIndexBuffer(VkDeviceSize minSize)
+{
+    HEPHAESTUS_ASSERT(m_indexBufferInfo.IsValid());
+
+    const VkDeviceSize newSize = GetGrowSize(m_indexRanges.GetSize(), minSize);
+    if (newSize > UINT32_MAX)
+    {
+        HEPHAESTUS_LOG_ERROR("Index buffer cannot grow to %llu bytes", (unsigned long long)newSize);
+        return false;
+    }
+
+    // existing data keep their offsets in the new buffer
+    std::vector<vk::BufferCopy> regions;
+    if (m_indexBufferCurSize > 0u)
+        regions.emplace_back(0u, 0u, m_indexBufferCurSize);
+    if (!ReallocateDeviceBuffer(m_indexBufferInfo, (uint32_t)newSize, GetIndexBufferUsage(), regions,
+        vk::AccessFlagBits::eIndexRead, vk::PipelineStageFlagBits::eVertexInput))
+        return false;
+
+    m_indexRanges.Grow(newSize);
+
+    return true;
+}
+
 TriMeshPipeline::MeshIDType 
 TriMeshPipeline::CreateMeshID()
 {
-    m_meshInfos.push_back({});
-    m_meshInfos.back().vertexOffset = m_vertexBufferCurSize;    // create always pointing at currently 
-                                                                // available vertex buffer
-    return (MeshIDType)(m_meshInfos.size() - 1);
+    MeshIDType meshId = 0u;
+    const bool reusedId = !m_freeMeshIDs.empty();
+    if (reusedId)
+    {
+        meshId = m_freeMeshIDs.back();
+        m_freeMeshIDs.pop_back();
+        m_meshInfos[meshId].removed = false;
+        m_meshInfos[meshId].visible = true;
+    }
+    else
+    {
+        meshId = (MeshIDType)m_meshInfos.size();
+        m_meshInfos.push_back({});
+
+        // meshes created after the pipeline setup need more space in the uniform buffer
+        if (m_meshUBBufferInfo.IsValid() && m_meshInfos.size() > m_meshUBCapacity && !GrowMeshUniformBuffer())
+        {
+            m_meshInfos.pop_back();
+            return InvalidMeshID;
+        }
+    }
+
+    // meshes created after the pipeline setup need their own descriptor set, with the default texture
+    if (m_sceneDescSetInfo.handle && !m_indirectDraw &&
+        !SetupMeshDescriptorSet(m_meshInfos[meshId].descriptorSetInfo, m_meshUBBufferInfo, m_meshInfos[meshId].textureInfo))
+    {
+        ReleaseMeshID(meshId, reusedId);
+        return InvalidMeshID;
+    }
+
+    // start with identity model transform
+    const Matrix4x4f identity = { { 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f } };
+    std::memcpy(m_meshInfos[meshId].ubData.data(), identity.data(), sizeof(MeshUBData));
+    ++m_meshUBVersion;
+    ++m_drawVersion;
+
+    // the new mesh has a single instance
+    if (m_instancing && !UpdateInstanceOffsets())
+    {
+        ReleaseMeshID(meshId, reusedId);
+        UpdateInstanceOffsets();
+        return InvalidMeshID;
+    }
+
+    // the new mesh uses the default texture
+    if (m_bindlessTextures)
+    {
+        if (meshId < m_bindlessTextureCount)
+            MarkBindlessTexture(meshId);
+        else
+        {
+            HEPHAESTUS_LOG_ERROR("Sub mesh %u exceeds the max number of bindless textures & will not be drawn", meshId);
+        }
+    }
+
+    return meshId;
+}
+
+void
+TriMeshPipeline::ReleaseMeshID(MeshIDType meshId, bool reusedId)
+{
+    // revert a mesh ID that failed to be created
+    if (reusedId)
+    {
+        m_meshInfos[meshId].Clear();
+        m_meshInfos[meshId].visible = false;
+        m_meshInfos[meshId].removed = true;
+        m_freeMeshIDs.push_back(meshId);
+    }
+    else
+    {
+        m_meshInfos.pop_back();
+    }
+}
+
+bool
+TriMeshPipeline::MeshRemove(MeshIDType meshId)
+{
+    HEPHAESTUS_LOG_ASSERT(meshId < m_meshInfos.size(), "Sub mesh ID out of range");
+
+    MeshInfo& meshIdInfo = m_meshInfos[meshId];
+    HEPHAESTUS_LOG_ASSERT(!meshIdInfo.removed, "Sub mesh has already been removed");
+
+    // the resources may be used by frames in flight, so they are retired instead of destroyed
+    if (meshIdInfo.vertexSize > 0u)
+        FreeVertexData(meshIdInfo.vertexOffset, meshIdInfo.vertexSize);
+    if (meshIdInfo.indexOffset >= 0)
+        RetireRange(m_indexRanges, (VkDeviceSize)meshIdInfo.indexOffset, meshIdInfo.indexSize);
+    if (meshIdInfo.descriptorSetInfo.handle)
+        RetireDescriptorSet(meshIdInfo.descriptorSetInfo);
+    if (meshIdInfo.textureInfo.imageHandle)
+        RetireImage(meshIdInfo.textureInfo, m_lastUploadTicket);
+
+    meshIdInfo.Clear();
+    meshIdInfo.visible = false;
+    meshIdInfo.removed = true;
+    m_freeMeshIDs.push_back(meshId);
+    ++m_drawVersion;
+
+    // the next frames use the default texture in the slot of the removed mesh
+    if (m_bindlessTextures && meshId < m_bindlessTextureCount)
+        MarkBindlessTexture(meshId);
+
+    return !m_instancing || UpdateInstanceOffsets();
 }
 
 bool 
@@ -467,7 +1339,145 @@ TriMeshPipeline::MeshCreateTexture(MeshIDType meshId, uint32_t width, uint32_t h
     HEPHAESTUS_LOG_ASSERT(meshId < m_meshInfos.size(), "Sub mesh ID out of range");
 
     MeshInfo& meshIdInfo = m_meshInfos[meshId];
-    return VulkanUtils::CreateImageTextureInfo(m_deviceManager, width, height, meshIdInfo.textureInfo);
+
+    VulkanUtils::ImageInfo textureInfo;
+    if (!VulkanUtils::CreateImageTextureInfo(m_deviceManager, width, height, textureInfo))
+        return false;
+
+    // a new descriptor set points to the new texture
+    VulkanUtils::DescriptorSetInfo descSetInfo;
+    if (m_sceneDescSetInfo.handle && !m_indirectDraw && 
+        !SetupMeshDescriptorSet(descSetInfo, m_meshUBBufferInfo, textureInfo))
+        return false;
+
+    // the previous texture & descriptor set may be used by frames in flight
+    if (meshIdInfo.textureInfo.imageHandle)
+        RetireImage(meshIdInfo.textureInfo, m_lastUploadTicket);
+    meshIdInfo.textureInfo = std::move(textureInfo);
+    if (descSetInfo.handle)
+    {
+        if (meshIdInfo.descriptorSetInfo.handle)
+            RetireDescriptorSet(meshIdInfo.descriptorSetInfo);
+        meshIdInfo.descriptorSetInfo = std::move(descSetInfo);
+    }
+    if (m_bindlessTextures && meshId < m_bindlessTextureCount)
+        MarkBindlessTexture(meshId);
+
+    return true;
+}
+
+bool
+TriMeshPipeline::GrowMeshUniformBuffer()
+{
+    // the previous buffers may be used by frames in flight, they are retired once the new ones are created
+    const uint32_t capacity = m_meshUBCapacity;
+    VulkanUtils::BufferInfo prevMeshUBBufferInfo = std::move(m_meshUBBufferInfo);
+    VulkanUtils::BufferInfo prevIndirectBufferInfo = std::move(m_indirectBufferInfo);
+    if (!RecreateMeshBuffers(std::max(2u * capacity, (uint32_t)m_meshInfos.size())))
+    {
+        // on failure the previous buffers are restored, their frame regions are rewritten on next use
+        m_meshUBBufferInfo.Clear();
+        m_indirectBufferInfo.Clear();
+        m_meshUBBufferInfo = std::move(prevMeshUBBufferInfo);
+        m_indirectBufferInfo = std::move(prevIndirectBufferInfo);
+        SetMeshUniformLayout(m_numFramesInFlight, capacity);
+        m_drawFrameVersions.assign(m_drawFrameVersions.size(), UINT64_MAX);
+        return false;
+    }
+    RetireBuffer(prevMeshUBBufferInfo);
+    if (prevIndirectBufferInfo.IsValid())
+        RetireBuffer(prevIndirectBufferInfo);
+
+    // the descriptor sets pointing to the buffer are replaced, as the previous ones may be used by frames in flight
+    if (m_indirectDraw)
+    {
+        RetireDescriptorSet(m_sceneDescSetInfo);
+        if (!AllocateSceneDescriptorSet())
+        {
+            // the pool only fits a few scene sets, wait for the retired ones to be released
+            m_deviceManager.WaitDevice();
+            ReleaseAllRetiredResources();
+            if (!AllocateSceneDescriptorSet())
+                return false;
+        }
+        UpdateSceneMeshDataDescriptor();
+    }
+    for (MeshInfo& info : m_meshInfos)
+    {
+        if (!info.descriptorSetInfo.handle)
+            continue;
+
+        VulkanUtils::DescriptorSetInfo descSetInfo;
+        if (!SetupMeshDescriptorSet(descSetInfo, m_meshUBBufferInfo, info.textureInfo))
+            return false;
+        RetireDescriptorSet(info.descriptorSetInfo);
+        info.descriptorSetInfo = std::move(descSetInfo);
+    }
+
+    return true;
+}
+
+bool
+TriMeshPipeline::RecreateMeshBuffers(uint32_t capacity)
+{
+    if (!CreateMeshUniformBuffer(m_numFramesInFlight, capacity))
+        return false;
+
+    // the draw commands need the same capacity
+    return !m_indirectDraw || CreateIndirectBuffer(m_numFramesInFlight, m_meshUBCapacity);
+}
+
+bool
+TriMeshPipeline::Compact()
+{
+    // the buffers may be used by frames in flight, after waiting for them all the retired ranges are free
+    m_deviceManager.WaitDevice();
+    ReleaseAllRetiredResources();
+
+    // collect the ranges of all meshes sorted by offset so that data only move towards the start of the buffers
+    std::vector<MeshIDType> meshIds;
+    std::vector<DataRange> ranges;
+    for (MeshIDType meshId = 0u; meshId < (MeshIDType)m_meshInfos.size(); ++meshId)
+    {
+        if (m_meshInfos[meshId].vertexSize > 0u)
+            meshIds.push_back(meshId);
+    }
+    std::sort(meshIds.begin(), meshIds.end(), [this](MeshIDType a, MeshIDType b) 
+        { return m_meshInfos[a].vertexOffset < m_meshInfos[b].vertexOffset; });
+    for (MeshIDType meshId : meshIds)
+        ranges.push_back({ m_meshInfos[meshId].vertexOffset, m_meshInfos[meshId].vertexSize });
+
+    if (m_vertexBufferInfo.IsValid() && !CompactVertexData(ranges, sizeof(VertexData)))
+        return false;
+    for (size_t i = 0; i < meshIds.size(); ++i)
+        m_meshInfos[meshIds[i]].vertexOffset = ranges[i].offset;
+
+    // same for the index data
+    meshIds.clear();
+    ranges.clear();
+    for (MeshIDType meshId = 0u; meshId < (MeshIDType)m_meshInfos.size(); ++meshId)
+    {
+        if (m_meshInfos[meshId].indexOffset >= 0)
+            meshIds.push_back(meshId);
+    }
+    std::sort(meshIds.begin(), meshIds.end(), [this](MeshIDType a, MeshIDType b) 
+        { return m_meshInfos[a].indexOffset < m_meshInfos[b].indexOffset; });
+    for (MeshIDType meshId : meshIds)
+        ranges.push_back({ (VkDeviceSize)m_meshInfos[meshId].indexOffset, m_meshInfos[meshId].indexSize });
+
+    if (m_indexBufferInfo.IsValid())
+    {
+        std::vector<vk::BufferCopy> regions;
+        m_indexBufferCurSize = PackDataRanges(m_indexRanges, ranges, VertexData::IndexSize, regions);
+        if (!ReallocateDeviceBuffer(m_indexBufferInfo, m_indexBufferInfo.size, GetIndexBufferUsage(), regions,
+            vk::AccessFlagBits::eIndexRead, vk::PipelineStageFlagBits::eVertexInput))
+            return false;
+    }
+    for (size_t i = 0; i < meshIds.size(); ++i)
+        m_meshInfos[meshIds[i]].indexOffset = (int64_t)ranges[i].offset;
+    ++m_drawVersion;
+
+    return true;
 }
 
 bool
@@ -479,12 +1489,32 @@ TriMeshPipeline::MeshSetIndexData(MeshIDType meshId,
     MeshInfo& meshIdInfo = m_meshInfos[meshId];
     HEPHAESTUS_LOG_ASSERT(meshIdInfo.indexOffset < 0, "Updating sub mesh index data but it has already been set");
 
-    meshIdInfo.indexOffset = m_indexBufferCurSize;
-    if (!VulkanUtils::CopyBufferDataStage(m_deviceManager, m_stageBufferInfo, updateInfo, m_indexBufferInfo, 
-        vk::AccessFlagBits::eIndexRead, vk::PipelineStageFlagBits::eVertexInput, m_indexBufferCurSize))
+    VkDeviceSize indexOffset = m_indexRanges.Allocate(updateInfo.dataSize, VertexData::IndexSize);
+    if (indexOffset == RangeAllocator::InvalidOffset)
+    {
+        if (!GrowIndexBuffer(m_indexRanges.GetSize() + updateInfo.dataSize + VertexData::IndexSize))
+            return false;
+
+        indexOffset = m_indexRanges.Allocate(updateInfo.dataSize, VertexData::IndexSize);
+        if (indexOffset == RangeAllocator::InvalidOffset)
+        {
+            HEPHAESTUS_LOG_ERROR("Not enough space in the index buffer for %u bytes", updateInfo.dataSize);
+            return false;
+        }
+    }
+
+    if (!m_deviceManager.GetUploadManager().UploadBuffer(updateInfo.data, updateInfo.dataSize, 
+        m_indexBufferInfo.bufferHandle.get(), indexOffset, 
+        vk::AccessFlagBits::eIndexRead, vk::PipelineStageFlagBits::eVertexInput, m_lastUploadTicket))
+    {
+        m_indexRanges.Free(indexOffset, updateInfo.dataSize);
         return false;
+    }
 
-    m_indexBufferCurSize += updateInfo.dataSize;
+    meshIdInfo.indexOffset = (int64_t)indexOffset;
+    meshIdInfo.indexSize = updateInfo.dataSize;
+    ++m_drawVersion;
+    m_indexBufferCurSize = std::max(m_indexBufferCurSize, indexOffset + updateInfo.dataSize);
 
     return true;
 }
@@ -497,12 +1527,21 @@ TriMeshPipeline::MeshSetVertexData(MeshIDType meshId,
 
     MeshInfo& meshIdInfo = m_meshInfos[meshId];
 
-    meshIdInfo.vertexOffset = m_vertexBufferCurSize;
-    if (!VulkanUtils::CopyBufferDataHost(m_deviceManager, updateInfo, 
-        m_vertexBufferInfo, m_vertexBufferCurSize))
+    // replacing the vertex data of the mesh, the previous range is re-used once the frames in flight are done
+    if (meshIdInfo.vertexSize > 0u)
+    {
+        FreeVertexData(meshIdInfo.vertexOffset, meshIdInfo.vertexSize);
+        meshIdInfo.vertexSize = 0u;
+    }
+
+    // offsets need to be a multiple of the vertex size as they are passed to the draw as vertex indices
+    VkDeviceSize vertexOffset = 0u;
+    if (!AllocateVertexData(updateInfo, sizeof(VertexData), vertexOffset))
         return false;
 
-    m_vertexBufferCurSize += updateInfo.dataSize;
+    meshIdInfo.vertexOffset = vertexOffset;
+    meshIdInfo.vertexSize = updateInfo.dataSize;
+    ++m_drawVersion;
 
     return true;
 }
@@ -514,49 +1553,83 @@ TriMeshPipeline::MeshUpdateVertexData(MeshIDType meshId,
     HEPHAESTUS_LOG_ASSERT(meshId < m_meshInfos.size(), "Sub mesh ID out of range");
 
     MeshInfo& meshIdInfo = m_meshInfos[meshId];
-    return VulkanUtils::CopyBufferDataHost(
-        m_deviceManager, updateInfo, m_vertexBufferInfo, meshIdInfo.vertexOffset);
+    return WriteVertexData(updateInfo, meshIdInfo.vertexOffset);
 }
 
 bool
-TriMeshPipeline::UpdateProjectionMatrix(const Matrix4x4f& projectionMatrix, vk::CommandBuffer copyCmdBuffer)
+TriMeshPipeline::UpdateProjectionMatrix(const Matrix4x4f& projectionMatrix, vk::CommandBuffer /*copyCmdBuffer*/)
 {
     std::memcpy(m_sceneUBData.raw.data(), projectionMatrix.data(), 16u * sizeof(float));
-    return VulkanUtils::UpdateUniformBufferData(m_deviceManager, m_sceneUBData, copyCmdBuffer);
+    ++m_sceneUBVersion;
+    return true;
 }
 
 bool
-TriMeshPipeline::UpdateViewMatrix(const Matrix4x4f& viewMatrix, vk::CommandBuffer copyCmdBuffer)
+TriMeshPipeline::UpdateViewMatrix(const Matrix4x4f& viewMatrix, vk::CommandBuffer /*copyCmdBuffer*/)
 {
     std::memcpy(&m_sceneUBData.raw[16 * sizeof(float)], viewMatrix.data(), 16u * sizeof(float));
-    return VulkanUtils::UpdateUniformBufferData(m_deviceManager, m_sceneUBData, copyCmdBuffer);
+    ++m_sceneUBVersion;
+    return true;
 }
 
 bool
 TriMeshPipeline::UpdateViewAndProjectionMatrix(
-    const Matrix4x4f& viewMatrix, const Matrix4x4f& projectionMatrix, vk::CommandBuffer copyCmdBuffer)
+    const Matrix4x4f& viewMatrix, const Matrix4x4f& projectionMatrix, vk::CommandBuffer /*copyCmdBuffer*/)
 {
     std::memcpy(m_sceneUBData.raw.data(), projectionMatrix.data(), 16u * sizeof(float));
     std::memcpy(&m_sceneUBData.raw[16 * sizeof(float)], viewMatrix.data(), 16u * sizeof(float));
-    return VulkanUtils::UpdateUniformBufferData(m_deviceManager, m_sceneUBData, copyCmdBuffer);
+    ++m_sceneUBVersion;
+    return true;
 }
 
 bool
-TriMeshPipeline::UpdateLightPos(const Vector4f& lightPos, vk::CommandBuffer copyCmdBuffer)
+TriMeshPipeline::UpdateViewAndProjectionMatrix(
+    uint32_t viewIndex, const Matrix4x4f& viewMatrix, const Matrix4x4f& projectionMatrix)
+{
+    if (viewIndex >= m_viewUBData.size())
+    {
+        HEPHAESTUS_LOG_WARNING("View index %u out of range, the pipeline is setup with %u views", 
+            viewIndex, (uint32_t)m_viewUBData.size());
+        return false;
+    }
+
+    std::memcpy(m_viewUBData[viewIndex].data(), projectionMatrix.data(), 16u * sizeof(float));
+    std::memcpy(&m_viewUBData[viewIndex][16 * sizeof(float)], viewMatrix.data(), 16u * sizeof(float));
+    ++m_sceneUBVersion;
+    return true;
+}
+
+bool
+TriMeshPipeline::UpdateLightPos(const Vector4f& lightPos, vk::CommandBuffer /*copyCmdBuffer*/)
 {
     std::memcpy(&m_sceneUBData.raw[32 * sizeof(float)], lightPos.data(), 4 * sizeof(float));
-    return VulkanUtils::UpdateUniformBufferData(m_deviceManager, m_sceneUBData, copyCmdBuffer);
+    ++m_sceneUBVersion;
+    return true;
 }
 
 bool 
 TriMeshPipeline::UpdateModelMatrix(MeshIDType meshId, 
-    const Matrix4x4f& modelMatrix, vk::CommandBuffer copyCmdBuffer)
+    const Matrix4x4f& modelMatrix, vk::CommandBuffer /*copyCmdBuffer*/)
+{
+    HEPHAESTUS_LOG_ASSERT(meshId < m_meshInfos.size(), "Sub mesh ID out of range");
+
+    // only update the host copy, the data are copied to the uniform buffer when recording the next frame
+    MeshInfo& meshIdInfo = m_meshInfos[meshId];
+    HEPHAESTUS_LOG_ASSERT(!meshIdInfo.removed, "Updating removed sub mesh");
+    std::memcpy(meshIdInfo.ubData.data(), modelMatrix.data(), 16u * sizeof(float));
+    ++m_meshUBVersion;
+
+    return true;
+}
+
+void
+TriMeshPipeline::MeshSetMaterialIndex(MeshIDType meshId, uint32_t materialIndex)
 {
     HEPHAESTUS_LOG_ASSERT(meshId < m_meshInfos.size(), "Sub mesh ID out of range");
 
     MeshInfo& meshIdInfo = m_meshInfos[meshId];
-    std::memcpy(meshIdInfo.ubData.raw.data(), modelMatrix.data(), 16u * sizeof(float));
-    return VulkanUtils::UpdateUniformBufferData(m_deviceManager, meshIdInfo.ubData, copyCmdBuffer);
+    HEPHAESTUS_LOG_ASSERT(!meshIdInfo.removed, "Updating removed sub mesh");
+    meshIdInfo.materialIndex = materialIndex;
 }
 
 } // hephaestus
\ No newline at end of file
@@ -4,6 +4,8 @@
 #include <hephaestus/VulkanDispatcher.h>
 #include <hephaestus/VulkanValidate.h>
 
+#include <cstring>
+
 
 namespace hephaestus
 {
@@ -39,6 +41,18 @@ VulkanDeviceManager::GetDeviceRequiredExtensions()
     return extensions;
 }
 
+std::vector<char const*>
+VulkanDeviceManager::GetDeviceOptionalExtensions()
+{
+    std::vector<char const*> extensions;
+
+    extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);   // used by the memory allocator
+    extensions.push_back(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);   // used for readback to host memory
+    extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);    // used for bindless textures
+
+    return extensions;
+}
+
 std::vector<char const*>
 VulkanDeviceManager::GetInstanceRequiredExtensions(bool enableValidationLayers)
 {
@@ -125,9 +139,14 @@ VulkanDeviceManager::CreateDevice(bool createPresentQueue /*= true*/)
 
     HEPHAESTUS_LOG_ASSERT(VulkanValidate::CheckPhysicalDevicePropertiesAndFeatures(m_physicalDevice),
         "No support for Vulkan physical device required properties and features");
-    const std::vector<const char*>& deviceExtensions = GetDeviceRequiredExtensions();
+    std::vector<const char*> deviceExtensions = GetDeviceRequiredExtensions();
     HEPHAESTUS_LOG_ASSERT(VulkanValidate::CheckPhysicalDeviceRequiredExtensions(deviceExtensions, m_physicalDevice),
         "No support for Vulkan physical device required extensions");
+    for (const char* extensionName : GetDeviceOptionalExtensions())
+    {
+        if (VulkanValidate::IsPhysicalDeviceExtensionSupported(extensionName, m_physicalDevice))
+            deviceExtensions.push_back(extensionName);
+    }
 
     if (!SetupQueueFamilies(createPresentQueue))
         return false;
@@ -148,9 +167,46 @@ VulkanDeviceManager::CreateDevice(bool createPresentQueue /*= true*/)
         deviceQueueCreateInfos.data());
     deviceCreateInfo.enabledExtensionCount = (uint32_t)deviceExtensions.size();
     deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
+
+    // optional features, enabled only if supported
+    auto supportedFeatures = m_physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, 
+        vk::PhysicalDeviceMultiviewFeatures, vk::PhysicalDeviceDescriptorIndexingFeaturesEXT>();
+    vk::PhysicalDeviceMultiviewFeatures multiviewFeatures;
+    multiviewFeatures.multiview = supportedFeatures.get<vk::PhysicalDeviceMultiviewFeatures>().multiview;
+    deviceCreateInfo.pNext = &multiviewFeatures;
+    vk::PhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingFeatures;
+    m_enabledDeviceExtensions = deviceExtensions;
+    if (IsDeviceExtensionEnabled(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME))
+    {
+        const vk::PhysicalDeviceDescriptorIndexingFeaturesEXT& supportedIndexingFeatures = 
+            supportedFeatures.get<vk::PhysicalDeviceDescriptorIndexingFeaturesEXT>();
+        descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = 
+            supportedIndexingFeatures.shaderSampledImageArrayNonUniformIndexing;
+        descriptorIndexingFeatures.descriptorBindingPartiallyBound = 
+            supportedIndexingFeatures.descriptorBindingPartiallyBound;
+        descriptorIndexingFeatures.runtimeDescriptorArray = supportedIndexingFeatures.runtimeDescriptorArray;
+        multiviewFeatures.pNext = &descriptorIndexingFeatures;
+    }
+    const vk::PhysicalDeviceFeatures& supportedCoreFeatures = supportedFeatures.get<vk::PhysicalDeviceFeatures2>().features;
+    vk::PhysicalDeviceFeatures enabledFeatures;
+    enabledFeatures.multiDrawIndirect = supportedCoreFeatures.multiDrawIndirect;
+    enabledFeatures.drawIndirectFirstInstance = supportedCoreFeatures.drawIndirectFirstInstance;
+    deviceCreateInfo.pEnabledFeatures = &enabledFeatures;
+
     HEPHAESTUS_CHECK_RESULT_HANDLE(m_device, m_physicalDevice.createDeviceUnique(deviceCreateInfo, nullptr));
 
     VulkanDispatcher::GetInstance().LoadDeviceFunctions(m_device.get());
+    m_enabledFeatures = enabledFeatures;
+    m_enabledDescriptorIndexingFeatures = descriptorIndexingFeatures;
+    m_enabledDescriptorIndexingFeatures.pNext = nullptr;
+
+    m_maxMultiviewViewCount = 0u;
+    if (multiviewFeatures.multiview)
+    {
+        auto properties = 
+            m_physicalDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceMultiviewProperties>();
+        m_maxMultiviewViewCount = properties.get<vk::PhysicalDeviceMultiviewProperties>().maxMultiviewViewCount;
+    }
 
     return true;
 }
@@ -217,11 +273,29 @@ VulkanDeviceManager::WaitDevice() const
         m_device->waitIdle();
 }
 
+bool
+VulkanDeviceManager::IsDeviceExtensionEnabled(const char* extensionName) const
+{
+    for (const char* enabledExtensionName : m_enabledDeviceExtensions)
+    {
+        if (std::strcmp(extensionName, enabledExtensionName) == 0)
+            return true;
+    }
+
+    return false;
+}
+
 void 
 VulkanDeviceManager::Clear()
 {
     m_presentSurface.reset(nullptr);
+    m_uploadManager.Clear();
+    m_memoryAllocator.Clear();
     m_device.reset(nullptr);
+    m_enabledDeviceExtensions.clear();
+    m_maxMultiviewViewCount = 0u;
+    m_enabledFeatures = vk::PhysicalDeviceFeatures();
+    m_enabledDescriptorIndexingFeatures = vk::PhysicalDeviceDescriptorIndexingFeaturesEXT();
     m_instance.reset(nullptr);
 }
 
@@ -258,6 +332,13 @@ VulkanDeviceManager::Init(const PlatformWindowInfo& windowInfo, bool enableValid
     if (!CreateQueues(createPresentQueue))
         return false;
 
+    if (!m_memoryAllocator.Init(m_physicalDevice, m_device.get(), 
+            IsDeviceExtensionEnabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)))
+        return false;
+
+    if (!m_uploadManager.Init(*this))
+        return false;
+
     return true;
 }
 
@@ -79,6 +79,9 @@ VulkanDispatcher::LoadInstanceFunctions(const vk::Instance& instance)
     HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkGetDeviceProcAddr, instance);
     HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkDestroyInstance, instance);
     HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkGetPhysicalDeviceMemoryProperties, instance);
+    HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkGetPhysicalDeviceMemoryProperties2, instance);
+    HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkGetPhysicalDeviceProperties2, instance);
+    HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkGetPhysicalDeviceFeatures2, instance);
     HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkEnumerateDeviceExtensionProperties, instance);
     HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkGetPhysicalDeviceSurfaceSupportKHR, instance);
     HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkGetPhysicalDeviceSurfaceCapabilitiesKHR, instance);
@@ -131,6 +134,7 @@ VulkanDispatcher::LoadDeviceFunctions(const vk::Device& device)
     HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkCreateShaderModule, device);
     HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkCreatePipelineLayout, device);
     HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkCreateGraphicsPipelines, device);
+    HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkCreateComputePipelines, device);
     HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkCmdBeginRenderPass, device);
     HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkCmdBindPipeline, device);
     HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkCmdDraw, device);
@@ -150,12 +154,14 @@ VulkanDispatcher::LoadDeviceFunctions(const vk::Device& device)
     HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkBindBufferMemory, device);
     HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkMapMemory, device);
     HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkFlushMappedMemoryRanges, device);
+    HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkInvalidateMappedMemoryRanges, device);
     HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkUnmapMemory, device);
     HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkCmdSetViewport, device);
     HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkCmdSetScissor, device);
     HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkCmdBindVertexBuffers, device);
     HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkWaitForFences, device);
     HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkResetFences, device);
+    HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkGetFenceStatus, device);
     HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkFreeMemory, device);
     HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkDestroyBuffer, device);
     HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkDestroyFence, device);
@@ -177,12 +183,16 @@ VulkanDispatcher::LoadDeviceFunctions(const vk::Device& device)
 
     HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkCmdBindIndexBuffer, device);
     HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkCmdDrawIndexed, device);
+    HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkCmdDrawIndexedIndirect, device);
     HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkCmdPushConstants, device);
     HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkResetCommandPool, device);
 
     HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkCmdSetLineWidth, device);
     HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkCmdCopyImage, device);
     HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkGetImageSubresourceLayout, device);
+    HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkCmdCopyImageToBuffer, device);
+    HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkCmdDispatch, device);
+    HEPHAESTUS_VK_DISPATCHER_LOAD_OBJECT_FUNCTION(vkGetMemoryHostPointerPropertiesEXT, device);
 }
 
 }
\ No newline at end of file
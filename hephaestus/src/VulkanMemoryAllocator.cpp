@@ -0,0 +1,552 @@
+#include <hephaestus/VulkanMemoryAllocator.h>
+
+#include <hephaestus/Log.h>
+#include <hephaestus/VulkanDispatcher.h>
+#include <hephaestus/VulkanUtils.h>
+
+#include <algorithm>
+
+
+namespace hephaestus
+{
+
+static VkDeviceSize
+s_AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return ((value + alignment - 1u) / alignment) * alignment;
+}
+
+static uint32_t
+s_CountBits(vk::MemoryPropertyFlags flags)
+{
+    uint32_t count = 0u;
+    for (VkMemoryPropertyFlags bits = (VkMemoryPropertyFlags)flags; bits != 0u; bits &= bits - 1u)
+        ++count;
+    return count;
+}
+
+static VulkanMemoryAllocator::MemoryUsage
+s_GetDefaultUsage(vk::MemoryPropertyFlags requiredFlags)
+{
+    if (!(requiredFlags & vk::MemoryPropertyFlagBits::eHostVisible))
+        return VulkanMemoryAllocator::eMEMORY_USAGE_GPU_ONLY;
+    if (requiredFlags & vk::MemoryPropertyFlagBits::eHostCached)
+        return VulkanMemoryAllocator::eMEMORY_USAGE_GPU_TO_CPU;
+
+    return VulkanMemoryAllocator::eMEMORY_USAGE_CPU_TO_GPU;
+}
+
+// memory properties that make a memory type a better or worse fit for each usage
+static void
+s_GetUsageFlags(VulkanMemoryAllocator::MemoryUsage usage,
+    vk::MemoryPropertyFlags& preferredFlags, vk::MemoryPropertyFlags& unwantedFlags)
+{
+    // never pick these unless explicitly required
+    unwantedFlags = vk::MemoryPropertyFlagBits::eLazilyAllocated | vk::MemoryPropertyFlagBits::eProtected;
+
+    switch (usage)
+    {
+    case VulkanMemoryAllocator::eMEMORY_USAGE_GPU_ONLY:
+        // avoid wasting the (usually small) host visible device local heap
+        preferredFlags = vk::MemoryPropertyFlagBits::eDeviceLocal;
+        unwantedFlags |= vk::MemoryPropertyFlagBits::eHostVisible;
+        break;
+    case VulkanMemoryAllocator::eMEMORY_USAGE_CPU_TO_GPU:
+        // device local host visible memory (UMA, ReBAR) avoids the bus on every GPU read,
+        // write combined memory is better than cached memory for sequential host writes
+        preferredFlags = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent |
+            vk::MemoryPropertyFlagBits::eDeviceLocal;
+        unwantedFlags |= vk::MemoryPropertyFlagBits::eHostCached;
+        break;
+    case VulkanMemoryAllocator::eMEMORY_USAGE_CPU_ONLY:
+        preferredFlags = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+        unwantedFlags |= vk::MemoryPropertyFlagBits::eDeviceLocal;
+        break;
+    case VulkanMemoryAllocator::eMEMORY_USAGE_GPU_TO_CPU:
+        // host reads from uncached memory are very slow
+        preferredFlags = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCached;
+        break;
+    default:
+        preferredFlags = vk::MemoryPropertyFlags();
+        break;
+    }
+}
+
+void*
+VulkanMemoryAllocator::AllocationHandle::Map()
+{
+    HEPHAESTUS_LOG_ASSERT(m_allocator, "Mapping invalid allocation");
+
+    if (m_mappedData == nullptr)
+        m_mappedData = m_allocator->Map(m_allocation);
+
+    return m_mappedData;
+}
+
+void
+VulkanMemoryAllocator::AllocationHandle::Unmap()
+{
+    if (m_mappedData != nullptr)
+        m_allocator->Unmap(m_allocation);
+
+    m_mappedData = nullptr;
+}
+
+void
+VulkanMemoryAllocator::AllocationHandle::Reset()
+{
+    if (m_allocator != nullptr)
+    {
+        Unmap();
+        m_allocator->Free(m_allocation);
+    }
+
+    m_allocator = nullptr;
+    m_allocation = Allocation();
+}
+
+void
+VulkanMemoryAllocator::AllocationHandle::Swap(AllocationHandle& other)
+{
+    std::swap(m_allocator, other.m_allocator);
+    std::swap(m_allocation, other.m_allocation);
+    std::swap(m_mappedData, other.m_mappedData);
+}
+
+VulkanMemoryAllocator::~VulkanMemoryAllocator()
+{
+    Clear();
+}
+
+bool
+VulkanMemoryAllocator::Init(vk::PhysicalDevice physicalDevice, vk::Device device, bool useMemoryBudget,
+    VkDeviceSize blockSize /*= DefaultBlockSize*/)
+{
+    HEPHAESTUS_LOG_ASSERT(physicalDevice, "No Vulkan physical device available");
+    HEPHAESTUS_LOG_ASSERT(device, "No Vulkan device available");
+    HEPHAESTUS_LOG_ASSERT(blockSize > 0u, "Invalid memory block size");
+
+    Clear();
+
+    m_device = device;
+    m_physicalDevice = physicalDevice;
+    m_memoryProperties = physicalDevice.getMemoryProperties();
+    m_blockSize = blockSize;
+    m_useMemoryBudget = useMemoryBudget;
+
+    const vk::PhysicalDeviceLimits& limits = physicalDevice.getProperties().limits;
+    m_nonCoherentAtomSize = std::max<VkDeviceSize>(limits.nonCoherentAtomSize, 1u);
+    m_maxAllocationCount = limits.maxMemoryAllocationCount;
+
+    UpdateBudget();
+
+    return true;
+}
+
+void
+VulkanMemoryAllocator::Clear()
+{
+    for (Block& block : m_blocks)
+    {
+        HEPHAESTUS_LOG_ASSERT(block.allocationCount == 0u, "Releasing memory block with live allocations");
+        ReleaseBlock(block);
+    }
+    m_blocks.clear();
+    m_liveBlockCount = 0u;
+    m_device = nullptr;
+    m_physicalDevice = nullptr;
+    m_useMemoryBudget = false;
+
+    for (uint32_t i = 0; i < VK_MAX_MEMORY_HEAPS; ++i)
+    {
+        m_heapBlockBytes[i] = 0u;
+        m_heapAllocationBytes[i] = 0u;
+        m_heapBudgets[i] = HeapBudget();
+    }
+}
+
+bool
+VulkanMemoryAllocator::Allocate(const vk::MemoryRequirements& requirements, uint32_t memoryTypeIndex, bool linear,
+    AllocationHandle& allocationHandle)
+{
+    HEPHAESTUS_LOG_ASSERT(m_device, "Memory allocator is not initialized");
+    HEPHAESTUS_LOG_ASSERT(memoryTypeIndex < m_memoryProperties.memoryTypeCount, "Invalid memory type index");
+
+    allocationHandle.Reset();
+
+    const vk::MemoryPropertyFlags propertyFlags = m_memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+
+    VkDeviceSize size = 0u;
+    VkDeviceSize alignment = 1u;
+    GetAllocationSize(requirements, memoryTypeIndex, size, alignment);
+
+    const VkDeviceSize preferredBlockSize = GetPreferredBlockSize(memoryTypeIndex);
+    const bool dedicated = size > preferredBlockSize / 2u;
+
+    uint32_t blockIndex = InvalidIndex;
+    VkDeviceSize offset = RangeAllocator::InvalidOffset;
+
+    // try to fit the allocation in one of the existing blocks
+    if (!dedicated)
+    {
+        for (uint32_t i = 0; i < (uint32_t)m_blocks.size(); ++i)
+        {
+            Block& block = m_blocks[i];
+            if (!block.memory || block.dedicated ||
+                block.memoryTypeIndex != memoryTypeIndex || block.linear != linear)
+                continue;
+
+            offset = block.ranges.Allocate(size, alignment);
+            if (offset != RangeAllocator::InvalidOffset)
+            {
+                blockIndex = i;
+                break;
+            }
+        }
+    }
+
+    // otherwise create a new block
+    if (blockIndex == InvalidIndex)
+    {
+        blockIndex = CreateBlock(dedicated ? size : preferredBlockSize, memoryTypeIndex, linear, dedicated);
+        if (blockIndex == InvalidIndex)
+            return false;
+
+        offset = m_blocks[blockIndex].ranges.Allocate(size, alignment);
+        HEPHAESTUS_LOG_ASSERT(offset != RangeAllocator::InvalidOffset, "Failed to allocate from new memory block");
+    }
+
+    Block& block = m_blocks[blockIndex];
+    ++block.allocationCount;
+    m_heapAllocationBytes[m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex] += size;
+
+    allocationHandle.m_allocator = this;
+    allocationHandle.m_allocation.memory = block.memory;
+    allocationHandle.m_allocation.offset = offset;
+    allocationHandle.m_allocation.size = size;
+    allocationHandle.m_allocation.memoryTypeIndex = memoryTypeIndex;
+    allocationHandle.m_allocation.blockIndex = blockIndex;
+    allocationHandle.m_allocation.propertyFlags = propertyFlags;
+
+    return true;
+}
+
+bool
+VulkanMemoryAllocator::Allocate(const vk::MemoryRequirements& requirements, vk::MemoryPropertyFlags requiredFlags,
+    MemoryUsage usage, bool linear, AllocationHandle& allocationHandle)
+{
+    const uint32_t memoryTypeIndex = FindMemoryTypeIndex(requirements, requiredFlags, usage, linear);
+    if (memoryTypeIndex == InvalidIndex)
+    {
+        HEPHAESTUS_LOG_ERROR("No memory type available with the required properties");
+        return false;
+    }
+
+    return Allocate(requirements, memoryTypeIndex, linear, allocationHandle);
+}
+
+uint32_t
+VulkanMemoryAllocator::FindMemoryTypeIndex(const vk::MemoryRequirements& requirements, 
+    vk::MemoryPropertyFlags requiredFlags, MemoryUsage usage, bool linear) const
+{
+    if (usage == eMEMORY_USAGE_AUTO)
+        usage = s_GetDefaultUsage(requiredFlags);
+
+    vk::MemoryPropertyFlags preferredFlags;
+    vk::MemoryPropertyFlags unwantedFlags;
+    s_GetUsageFlags(usage, preferredFlags, unwantedFlags);
+    unwantedFlags &= ~requiredFlags;
+
+    uint32_t bestIndex = InvalidIndex;
+    int32_t bestScore = INT32_MIN;
+    bool bestFitsBudget = false;
+    for (uint32_t memoryTypeIndex = 0; memoryTypeIndex < m_memoryProperties.memoryTypeCount; ++memoryTypeIndex)
+    {
+        const vk::MemoryPropertyFlags flags = m_memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+        if (!(requirements.memoryTypeBits & (1u << memoryTypeIndex)) || (flags & requiredFlags) != requiredFlags)
+            continue;
+
+        // score by the preferred/unwanted properties with a small bonus for exact matches,
+        // ties are resolved by the type order which the spec sorts by performance
+        int32_t score = 2 * (int32_t)s_CountBits(flags & preferredFlags) - 2 * (int32_t)s_CountBits(flags & unwantedFlags);
+        if (flags == (requiredFlags | preferredFlags))
+            ++score;
+
+        // the budget usage counts whole blocks, so sub-allocations from existing blocks do not add to it
+        VkDeviceSize size = 0u;
+        VkDeviceSize alignment = 1u;
+        GetAllocationSize(requirements, memoryTypeIndex, size, alignment);
+        const HeapBudget& heapBudget = m_heapBudgets[m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex];
+        const bool fitsBudget = 
+            heapBudget.usage + GetBlockAllocationSize(memoryTypeIndex, size, alignment, linear) <= heapBudget.budget;
+
+        if ((fitsBudget && !bestFitsBudget) || (fitsBudget == bestFitsBudget && score > bestScore))
+        {
+            bestIndex = memoryTypeIndex;
+            bestScore = score;
+            bestFitsBudget = fitsBudget;
+        }
+    }
+
+    if (bestIndex != InvalidIndex && !bestFitsBudget)
+        HEPHAESTUS_LOG_WARNING("Selected memory type %d is over the heap budget", bestIndex);
+
+    return bestIndex;
+}
+
+void*
+VulkanMemoryAllocator::Map(const Allocation& allocation)
+{
+    HEPHAESTUS_LOG_ASSERT(allocation.blockIndex < m_blocks.size(), "Invalid allocation");
+    HEPHAESTUS_LOG_ASSERT(allocation.propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible,
+        "Mapping memory that is not host visible");
+
+    Block& block = m_blocks[allocation.blockIndex];
+    if (block.mapCount == 0u)
+    {
+        HEPHAESTUS_CHECK_RESULT_RAW(block.mappedData,
+            m_device.mapMemory(block.memory, 0, VK_WHOLE_SIZE, vk::MemoryMapFlags()));
+        if (block.mappedData == nullptr)
+        {
+            HEPHAESTUS_LOG_ERROR("Failed to map memory block");
+            return nullptr;
+        }
+    }
+    ++block.mapCount;
+
+    return reinterpret_cast<char*>(block.mappedData) + allocation.offset;
+}
+
+void
+VulkanMemoryAllocator::Unmap(const Allocation& allocation)
+{
+    HEPHAESTUS_LOG_ASSERT(allocation.blockIndex < m_blocks.size(), "Invalid allocation");
+
+    Block& block = m_blocks[allocation.blockIndex];
+    HEPHAESTUS_LOG_ASSERT(block.mapCount > 0u, "Unmapping memory block that is not mapped");
+    if (--block.mapCount == 0u)
+    {
+        m_device.unmapMemory(block.memory);
+        block.mappedData = nullptr;
+    }
+}
+
+void
+VulkanMemoryAllocator::Flush(const Allocation& allocation, VkDeviceSize offset, VkDeviceSize size) const
+{
+    if (allocation.propertyFlags & vk::MemoryPropertyFlagBits::eHostCoherent)
+        return;
+
+    m_device.flushMappedMemoryRanges(GetMappedRange(allocation, offset, size));
+}
+
+void
+VulkanMemoryAllocator::Invalidate(const Allocation& allocation, VkDeviceSize offset, VkDeviceSize size) const
+{
+    if (allocation.propertyFlags & vk::MemoryPropertyFlagBits::eHostCoherent)
+        return;
+
+    m_device.invalidateMappedMemoryRanges(GetMappedRange(allocation, offset, size));
+}
+
+VulkanMemoryAllocator::Stats
+VulkanMemoryAllocator::GetStats() const
+{
+    Stats stats;
+    for (const Block& block : m_blocks)
+    {
+        if (!block.memory)
+            continue;
+
+        ++stats.blockCount;
+        stats.allocationCount += block.allocationCount;
+        stats.blockBytes += block.size;
+        stats.usedBytes += block.size - block.ranges.GetFreeSize();
+    }
+
+    return stats;
+}
+
+void
+VulkanMemoryAllocator::GetHeapBudgets(std::vector<HeapBudget>& heapBudgets) const
+{
+    UpdateBudget();
+
+    heapBudgets.assign(m_heapBudgets, m_heapBudgets + m_memoryProperties.memoryHeapCount);
+}
+
+void
+VulkanMemoryAllocator::Free(const Allocation& allocation)
+{
+    HEPHAESTUS_LOG_ASSERT(allocation.blockIndex < m_blocks.size(), "Invalid allocation");
+
+    Block& block = m_blocks[allocation.blockIndex];
+    HEPHAESTUS_LOG_ASSERT(block.allocationCount > 0u, "Freeing allocation from empty memory block");
+
+    block.ranges.Free(allocation.offset, allocation.size);
+    --block.allocationCount;
+    m_heapAllocationBytes[m_memoryProperties.memoryTypes[allocation.memoryTypeIndex].heapIndex] -= allocation.size;
+
+    // dedicated blocks are not shared so release them straight away,
+    // shared blocks are kept around for future allocations
+    if (block.dedicated && block.allocationCount == 0u)
+        ReleaseBlock(block);
+}
+
+uint32_t
+VulkanMemoryAllocator::CreateBlock(VkDeviceSize size, uint32_t memoryTypeIndex, bool linear, bool dedicated)
+{
+    if (m_liveBlockCount >= m_maxAllocationCount)
+    {
+        HEPHAESTUS_LOG_ERROR("Reached the maximum number of device memory allocations (%d)", m_maxAllocationCount);
+        return InvalidIndex;
+    }
+
+    vk::DeviceMemory memory;
+    vk::MemoryAllocateInfo allocateInfo(size, memoryTypeIndex);
+    HEPHAESTUS_CHECK_RESULT_RAW(memory, m_device.allocateMemory(allocateInfo, nullptr));
+    if (!memory)
+    {
+        HEPHAESTUS_LOG_ERROR("Failed to allocate device memory block of size %d", (uint32_t)size);
+        return InvalidIndex;
+    }
+
+    // re-use empty slots so that block indices stay stable
+    uint32_t blockIndex = 0u;
+    while (blockIndex < (uint32_t)m_blocks.size() && m_blocks[blockIndex].memory)
+        ++blockIndex;
+    if (blockIndex == (uint32_t)m_blocks.size())
+        m_blocks.emplace_back();
+
+    Block& block = m_blocks[blockIndex];
+    block.memory = memory;
+    block.size = size;
+    block.memoryTypeIndex = memoryTypeIndex;
+    block.linear = linear;
+    block.dedicated = dedicated;
+    block.ranges.Init(size);
+    block.allocationCount = 0u;
+    block.mappedData = nullptr;
+    block.mapCount = 0u;
+
+    ++m_liveBlockCount;
+    m_heapBlockBytes[m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex] += size;
+    UpdateBudget();
+
+    return blockIndex;
+}
+
+void
+VulkanMemoryAllocator::ReleaseBlock(Block& block)
+{
+    if (!block.memory)
+        return;
+
+    if (block.mapCount > 0u)
+        m_device.unmapMemory(block.memory);
+    m_device.freeMemory(block.memory, nullptr);
+    m_heapBlockBytes[m_memoryProperties.memoryTypes[block.memoryTypeIndex].heapIndex] -= block.size;
+
+    block = Block();
+    --m_liveBlockCount;
+    UpdateBudget();
+}
+
+VkDeviceSize
+VulkanMemoryAllocator::GetPreferredBlockSize(uint32_t memoryTypeIndex) const
+{
+    // use smaller blocks for small heaps (e.g. host visible device local memory)
+    const uint32_t heapIndex = m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+    const VkDeviceSize heapSize = m_memoryProperties.memoryHeaps[heapIndex].size;
+
+    return std::min(m_blockSize, std::max<VkDeviceSize>(heapSize / 8u, 1u));
+}
+
+void
+VulkanMemoryAllocator::GetAllocationSize(const vk::MemoryRequirements& requirements, uint32_t memoryTypeIndex,
+    VkDeviceSize& size, VkDeviceSize& alignment) const
+{
+    // align non coherent memory to the atom size so that flushing an allocation does not touch its neighbours
+    const vk::MemoryPropertyFlags propertyFlags = m_memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+    alignment = std::max<VkDeviceSize>(requirements.alignment, 1u);
+    size = requirements.size;
+    if ((propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible) &&
+        !(propertyFlags & vk::MemoryPropertyFlagBits::eHostCoherent))
+    {
+        alignment = s_AlignUp(alignment, m_nonCoherentAtomSize);
+        size = s_AlignUp(size, m_nonCoherentAtomSize);
+    }
+}
+
+VkDeviceSize
+VulkanMemoryAllocator::GetBlockAllocationSize(uint32_t memoryTypeIndex, VkDeviceSize size, VkDeviceSize alignment,
+    bool linear) const
+{
+    // same placement as Allocate()
+    const VkDeviceSize preferredBlockSize = GetPreferredBlockSize(memoryTypeIndex);
+    if (size > preferredBlockSize / 2u)
+        return size;
+
+    for (const Block& block : m_blocks)
+    {
+        if (block.memory && !block.dedicated && block.memoryTypeIndex == memoryTypeIndex && block.linear == linear &&
+            block.ranges.CanAllocate(size, alignment))
+            return 0u;
+    }
+
+    return preferredBlockSize;
+}
+
+vk::MappedMemoryRange
+VulkanMemoryAllocator::GetMappedRange(const Allocation& allocation, VkDeviceSize offset, VkDeviceSize size) const
+{
+    HEPHAESTUS_LOG_ASSERT(allocation.blockIndex < m_blocks.size(), "Invalid allocation");
+
+    // expand the range to the atom size, non coherent allocations are already aligned to it
+    const Block& block = m_blocks[allocation.blockIndex];
+    const VkDeviceSize rangeStart = ((allocation.offset + offset) / m_nonCoherentAtomSize) * m_nonCoherentAtomSize;
+    const VkDeviceSize rangeEnd = s_AlignUp(
+        allocation.offset + offset + std::min(size, allocation.size - offset), m_nonCoherentAtomSize);
+
+    return vk::MappedMemoryRange(block.memory, rangeStart, 
+        rangeEnd >= block.size ? VK_WHOLE_SIZE : rangeEnd - rangeStart);
+}
+
+void
+VulkanMemoryAllocator::UpdateBudget() const
+{
+    if (!m_physicalDevice)
+        return;
+
+    if (m_useMemoryBudget)
+    {
+        // the driver reports the usage of the whole process, including memory not allocated by us
+        auto memoryProperties = m_physicalDevice.getMemoryProperties2<
+            vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+        const vk::PhysicalDeviceMemoryBudgetPropertiesEXT& budgetProperties =
+            memoryProperties.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+
+        for (uint32_t i = 0; i < m_memoryProperties.memoryHeapCount; ++i)
+        {
+            m_heapBudgets[i].usage = budgetProperties.heapUsage[i];
+            m_heapBudgets[i].budget = std::min(budgetProperties.heapBudget[i], m_memoryProperties.memoryHeaps[i].size);
+        }
+    }
+    else
+    {
+        // without the extension use a heuristic similar to what most drivers report
+        for (uint32_t i = 0; i < m_memoryProperties.memoryHeapCount; ++i)
+        {
+            m_heapBudgets[i].usage = m_heapBlockBytes[i];
+            m_heapBudgets[i].budget = (m_memoryProperties.memoryHeaps[i].size * 8u) / 10u;
+        }
+    }
+
+    for (uint32_t i = 0; i < m_memoryProperties.memoryHeapCount; ++i)
+    {
+        m_heapBudgets[i].blockBytes = m_heapBlockBytes[i];
+        m_heapBudgets[i].allocationBytes = m_heapAllocationBytes[i];
+    }
+}
+
+} // hephaestus
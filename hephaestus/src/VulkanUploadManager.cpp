@@ -0,0 +1,539 @@
+#include <hephaestus/VulkanUploadManager.h>
+
+#include <hephaestus/Log.h>
+#include <hephaestus/VulkanDeviceManager.h>
+#include <hephaestus/VulkanDispatcher.h>
+
+#include <algorithm>
+#include <cstring>
+
+
+namespace hephaestus
+{
+
+bool
+VulkanUploadManager::Init(const VulkanDeviceManager& deviceManager, VkDeviceSize stagingSize /*= DefaultStagingSize*/)
+{
+    HEPHAESTUS_LOG_ASSERT(deviceManager.GetDevice(), "No Vulkan device available");
+    HEPHAESTUS_LOG_ASSERT(stagingSize > 0u && stagingSize <= UINT32_MAX, "Invalid staging size");
+
+    Clear();
+
+    m_deviceManager = &deviceManager;
+
+    // command buffers are short lived & reset every time they are re-used
+    {
+        vk::CommandPoolCreateInfo cmdPoolCreateInfo(
+            vk::CommandPoolCreateFlagBits::eResetCommandBuffer |
+            vk::CommandPoolCreateFlagBits::eTransient,
+            deviceManager.GetGraphicsQueueInfo().familyIndex);
+        HEPHAESTUS_CHECK_RESULT_HANDLE(m_commandPool,
+            deviceManager.GetDevice().createCommandPoolUnique(cmdPoolCreateInfo, nullptr));
+    }
+
+    if (!VulkanUtils::CreateBuffer(deviceManager, (uint32_t)stagingSize,
+        vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible, m_stagingBufferInfo,
+        VulkanMemoryAllocator::eMEMORY_USAGE_CPU_ONLY, true))
+        return false;
+    m_stagingRanges.Init(stagingSize);
+
+    // offsets of buffer to image copies need to be a multiple of the texel size (4 bytes for the textures used)
+    const vk::PhysicalDeviceLimits limits = deviceManager.GetPhysicalDevice().getProperties().limits;
+    m_stagingAlignment = std::max<VkDeviceSize>({ 4u,
+        limits.optimalBufferCopyOffsetAlignment, limits.nonCoherentAtomSize });
+
+    // two chunks per staging window, so that at least one chunk can be copied while the next one is executed
+    m_chunkSize = std::max(m_stagingAlignment, (GetStagingWindowSize() / 2u / m_stagingAlignment) * m_stagingAlignment);
+
+    return true;
+}
+
+void
+VulkanUploadManager::Clear()
+{
+    if (m_deviceManager != nullptr && m_deviceManager->GetDevice())
+    {
+        Ticket ticket = InvalidTicket;
+        if (IsBatchOpen())
+            FlushBatch(ticket);
+        WaitAll();
+    }
+
+    m_pendingSubmissions.clear();
+    m_freeSubmissions.clear();
+    m_submissions.clear();      // command buffers need to be released before the pool
+
+    m_stagingRanges.Clear();
+    m_stagingBufferInfo.Clear();
+    m_commandPool.reset(nullptr);
+
+    m_lastTicket = InvalidTicket;
+    m_completedTicket = InvalidTicket;
+    m_batchSubmission = InvalidSubmission;
+    m_deviceManager = nullptr;
+}
+
+bool
+VulkanUploadManager::UploadBuffer(const char* data, VkDeviceSize dataSize, vk::Buffer dstBuffer, VkDeviceSize dstOffset,
+    vk::AccessFlags dstAccessMask, vk::PipelineStageFlags dstStageMask, Ticket& ticket)
+{
+    HEPHAESTUS_LOG_ASSERT(m_deviceManager != nullptr, "Upload manager has not been initialized");
+    HEPHAESTUS_LOG_ASSERT(dstBuffer, "Invalid upload destination buffer");
+
+    // uploads are always recorded in a batch, which is only submitted here if it was not started by the caller
+    const bool ownBatch = !IsBatchOpen();
+    if (ownBatch && !BeginBatch())
+        return false;
+
+    // memory barrier to wait for previous reads of the region before it is overwritten
+    bool success = dataSize > 0u;
+    if (success)
+    {
+        vk::BufferMemoryBarrier bufferMemoryBarrier(
+            dstAccessMask,
+            vk::AccessFlagBits::eTransferWrite,
+            VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED,
+            dstBuffer,
+            dstOffset, dataSize);
+        GetBatchCmdBuffer().pipelineBarrier(
+            dstStageMask,
+            vk::PipelineStageFlagBits::eTransfer,
+            vk::DependencyFlags(),
+            nullptr,
+            bufferMemoryBarrier,
+            nullptr);
+    }
+
+    // split the data in chunks that are streamed through the staging memory
+    for (VkDeviceSize chunkOffset = 0u; success && chunkOffset < dataSize; chunkOffset += m_chunkSize)
+    {
+        const VkDeviceSize chunkSize = std::min(m_chunkSize, dataSize - chunkOffset);
+
+        VkDeviceSize stagingOffset = 0u;
+        success = StageChunk(data + chunkOffset, chunkSize, stagingOffset);
+        if (success)
+        {
+            vk::BufferCopy copyInfo(stagingOffset, dstOffset + chunkOffset, chunkSize);
+            GetBatchCmdBuffer().copyBuffer(m_stagingBufferInfo.bufferHandle.get(), dstBuffer, copyInfo);
+        }
+    }
+
+    // memory barrier to change access after the copy, also covers chunks copied in previous submissions
+    if (success)
+    {
+        vk::BufferMemoryBarrier bufferMemoryBarrier(
+            vk::AccessFlagBits::eTransferWrite,
+            dstAccessMask,
+            VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED,
+            dstBuffer,
+            dstOffset, dataSize);
+        GetBatchCmdBuffer().pipelineBarrier(
+            vk::PipelineStageFlagBits::eTransfer,
+            dstStageMask,
+            vk::DependencyFlags(),
+            nullptr,
+            bufferMemoryBarrier,
+            nullptr);
+    }
+
+    return EndUpload(ownBatch, success, ticket);
+}
+
+bool
+VulkanUploadManager::UploadImage(const char* data, VkDeviceSize dataSize, vk::Image dstImage,
+    uint32_t width, uint32_t height, Ticket& ticket)
+{
+    HEPHAESTUS_LOG_ASSERT(m_deviceManager != nullptr, "Upload manager has not been initialized");
+    HEPHAESTUS_LOG_ASSERT(dstImage, "Invalid upload destination image");
+    HEPHAESTUS_LOG_ASSERT(height > 0u && dataSize % height == 0u, "Image data are not tightly packed");
+
+    // chunks are split at row boundaries so that each one is a separate region of the image
+    const VkDeviceSize rowPitch = dataSize / height;
+    if (rowPitch == 0u || rowPitch > GetStagingWindowSize())
+    {
+        HEPHAESTUS_LOG_ERROR("Image row of %llu bytes does not fit in the staging memory", 
+            (unsigned long long)rowPitch);
+        return false;
+    }
+    const uint32_t chunkRows = (uint32_t)std::max<VkDeviceSize>(1u, m_chunkSize / rowPitch);
+
+    const bool ownBatch = !IsBatchOpen();
+    if (ownBatch && !BeginBatch())
+        return false;
+
+    vk::ImageSubresourceRange imageSubresourceRange(
+        vk::ImageAspectFlagBits::eColor,
+        0, 1, 0, 1);
+    {
+        vk::ImageMemoryBarrier barrierFromUndefinedToTransferDst(
+            vk::AccessFlags(),
+            vk::AccessFlagBits::eTransferWrite,
+            vk::ImageLayout::eUndefined,
+            vk::ImageLayout::eTransferDstOptimal,
+            VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED,
+            dstImage,
+            imageSubresourceRange);
+        GetBatchCmdBuffer().pipelineBarrier(
+            vk::PipelineStageFlagBits::eTopOfPipe,
+            vk::PipelineStageFlagBits::eTransfer,
+            vk::DependencyFlags(),
+            nullptr,
+            nullptr,
+            barrierFromUndefinedToTransferDst);
+    }
+
+    bool success = true;
+    for (uint32_t row = 0u; success && row < height; row += chunkRows)
+    {
+        const uint32_t rows = std::min(chunkRows, height - row);
+
+        VkDeviceSize stagingOffset = 0u;
+        success = StageChunk(data + row * rowPitch, rows * rowPitch, stagingOffset);
+        if (success)
+        {
+            vk::BufferImageCopy copyInfo(
+                stagingOffset, 0, 0,                                // buffer offset
+                { vk::ImageAspectFlagBits::eColor, 0, 0, 1 },       // subresource
+                { 0, (int32_t)row, 0 },                             // image offset
+                { width, rows, 1 });                                // image extent
+            GetBatchCmdBuffer().copyBufferToImage(
+                m_stagingBufferInfo.bufferHandle.get(),
+                dstImage,
+                vk::ImageLayout::eTransferDstOptimal,
+                copyInfo);
+        }
+    }
+
+    // the layout transition is recorded even on failure so that the image is left in a valid layout
+    {
+        vk::ImageMemoryBarrier barrierFromTransferToShader(
+            vk::AccessFlagBits::eTransferWrite,
+            vk::AccessFlagBits::eShaderRead,
+            vk::ImageLayout::eTransferDstOptimal,
+            vk::ImageLayout::eShaderReadOnlyOptimal,
+            VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED,
+            dstImage,
+            imageSubresourceRange);
+        GetBatchCmdBuffer().pipelineBarrier(
+            vk::PipelineStageFlagBits::eTransfer,
+            vk::PipelineStageFlagBits::eFragmentShader,
+            vk::DependencyFlags(),
+            nullptr,
+            nullptr,
+            barrierFromTransferToShader);
+    }
+
+    return EndUpload(ownBatch, success, ticket);
+}
+
+bool
+VulkanUploadManager::CopyBuffer(vk::Buffer srcBuffer, vk::Buffer dstBuffer, const std::vector<vk::BufferCopy>& regions,
+    vk::AccessFlags dstAccessMask, vk::PipelineStageFlags dstStageMask, Ticket& ticket)
+{
+    HEPHAESTUS_LOG_ASSERT(m_deviceManager != nullptr, "Upload manager has not been initialized");
+    HEPHAESTUS_LOG_ASSERT(srcBuffer && dstBuffer, "Invalid copy buffers");
+
+    const bool ownBatch = !IsBatchOpen();
+    if (ownBatch && !BeginBatch())
+        return false;
+
+    if (!regions.empty())
+    {
+        vk::CommandBuffer cmdBuffer = GetBatchCmdBuffer();
+
+        // make previous writes to the source (e.g. uploads in the same batch) visible to the copy
+        vk::MemoryBarrier memoryBarrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eTransferRead);
+        cmdBuffer.pipelineBarrier(
+            vk::PipelineStageFlagBits::eTransfer,
+            vk::PipelineStageFlagBits::eTransfer,
+            vk::DependencyFlags(),
+            memoryBarrier,
+            nullptr,
+            nullptr);
+
+        cmdBuffer.copyBuffer(srcBuffer, dstBuffer, regions);
+
+        vk::BufferMemoryBarrier bufferMemoryBarrier(
+            vk::AccessFlagBits::eTransferWrite,
+            dstAccessMask,
+            VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED,
+            dstBuffer,
+            0, VK_WHOLE_SIZE);
+        cmdBuffer.pipelineBarrier(
+            vk::PipelineStageFlagBits::eTransfer,
+            dstStageMask,
+            vk::DependencyFlags(),
+            nullptr,
+            bufferMemoryBarrier,
+            nullptr);
+    }
+
+    return EndUpload(ownBatch, true, ticket);
+}
+
+bool
+VulkanUploadManager::BeginBatch()
+{
+    HEPHAESTUS_LOG_ASSERT(m_deviceManager != nullptr, "Upload manager has not been initialized");
+    HEPHAESTUS_LOG_ASSERT(!IsBatchOpen(), "Upload batch has already been started");
+
+    return BeginSubmission(m_batchSubmission);
+}
+
+bool
+VulkanUploadManager::FlushBatch(Ticket& ticket)
+{
+    HEPHAESTUS_LOG_ASSERT(IsBatchOpen(), "No upload batch has been started");
+
+    const uint32_t submissionIndex = m_batchSubmission;
+    m_batchSubmission = InvalidSubmission;
+
+    return EndSubmission(submissionIndex, ticket);
+}
+
+bool
+VulkanUploadManager::IsComplete(Ticket ticket)
+{
+    HEPHAESTUS_LOG_ASSERT(ticket <= m_lastTicket + (IsBatchOpen() ? 1u : 0u), "Upload ticket has not been submitted");
+
+    if (ticket <= m_completedTicket)
+        return true;
+    if (ticket > m_lastTicket)
+        return false;   // batch is still being recorded
+
+    RetireSubmissions(false);
+
+    return ticket <= m_completedTicket;
+}
+
+bool
+VulkanUploadManager::Wait(Ticket ticket, uint64_t timeout /*= UINT64_MAX*/)
+{
+    if (IsComplete(ticket))
+        return true;
+
+    // the ticket belongs to the open batch, submit it now (new uploads will be recorded in a new batch)
+    if (ticket > m_lastTicket && !RestartBatch())
+        return false;
+
+    // wait on the fence of the submission with the ticket, previous submissions are retired afterwards
+    for (uint32_t submissionIndex : m_pendingSubmissions)
+    {
+        const Submission& submission = m_submissions[submissionIndex];
+        if (submission.ticket < ticket)
+            continue;
+
+        if (m_deviceManager->GetDevice().waitForFences(
+            submission.fence.get(), VK_TRUE, timeout) != vk::Result::eSuccess)
+        {
+            HEPHAESTUS_LOG_WARNING("Timed out waiting for upload %llu", (unsigned long long)ticket);
+            return false;
+        }
+        break;
+    }
+
+    // the fence also guarantees that all previous submissions to the queue have completed
+    return IsComplete(ticket);
+}
+
+bool
+VulkanUploadManager::StageChunk(const char* data, VkDeviceSize dataSize, VkDeviceSize& stagingOffset)
+{
+    // keep each submission within the staging window so that the next one can be filled while it is executed
+    if (m_submissions[m_batchSubmission].stagingSize + dataSize > GetStagingWindowSize() && 
+        !m_submissions[m_batchSubmission].stagingRanges.empty())
+    {
+        if (!RestartBatch())
+            return false;
+    }
+
+    // allocate first since running out of staging memory may also submit the open batch
+    if (!AllocateStaging(dataSize, stagingOffset))
+        return false;
+
+    std::memcpy(m_stagingBufferInfo.GetMappedData() + stagingOffset, data, dataSize);
+    m_deviceManager->GetMemoryAllocator().Flush(m_stagingBufferInfo.allocation.Get(), stagingOffset, dataSize);
+
+    Submission& submission = m_submissions[m_batchSubmission];
+    submission.stagingRanges.push_back({ stagingOffset, dataSize });
+    submission.stagingSize += dataSize;
+
+    return true;
+}
+
+bool
+VulkanUploadManager::EndUpload(bool ownBatch, bool success, Ticket& ticket)
+{
+    // the batch is submitted even on failure since it may contain other uploads
+    if (ownBatch)
+        return FlushBatch(ticket) && success;
+
+    // uploads in a batch started by the caller get the ticket that the batch will be submitted with
+    ticket = m_lastTicket + 1u;
+    return success;
+}
+
+bool
+VulkanUploadManager::RestartBatch()
+{
+    Ticket batchTicket = InvalidTicket;
+    return FlushBatch(batchTicket) && BeginBatch();
+}
+
+bool
+VulkanUploadManager::AllocateStaging(VkDeviceSize size, VkDeviceSize& offset)
+{
+    if (size == 0u || size > GetStagingWindowSize())
+    {
+        HEPHAESTUS_LOG_ERROR("Upload of %llu bytes does not fit in the staging window (%llu bytes)",
+            (unsigned long long)size, (unsigned long long)GetStagingWindowSize());
+        return false;
+    }
+
+    offset = m_stagingRanges.Allocate(size, m_stagingAlignment);
+    if (offset != RangeAllocator::InvalidOffset)
+        return true;
+
+    // recycle completed submissions and wait for the oldest ones until there is enough staging memory
+    RetireSubmissions(false);
+    while ((offset = m_stagingRanges.Allocate(size, m_stagingAlignment)) == RangeAllocator::InvalidOffset)
+    {
+        if (m_pendingSubmissions.empty())
+        {
+            // the rest of the staging memory is used by the open batch, submit it & continue in a new one
+            if (!IsBatchOpen() || m_submissions[m_batchSubmission].stagingRanges.empty())
+            {
+                HEPHAESTUS_LOG_ERROR("Failed to allocate %llu bytes of staging memory", (unsigned long long)size);
+                return false;
+            }
+
+            if (!RestartBatch())
+                return false;
+        }
+        else if (!RetireSubmissions(true))
+            return false;
+    }
+
+    return true;
+}
+
+bool
+VulkanUploadManager::BeginSubmission(uint32_t& submissionIndex)
+{
+    vk::Device device = m_deviceManager->GetDevice();
+
+    if (m_freeSubmissions.empty())
+        RetireSubmissions(false);
+
+    if (!m_freeSubmissions.empty())
+    {
+        submissionIndex = m_freeSubmissions.back();
+        m_freeSubmissions.pop_back();
+        device.resetFences(m_submissions[submissionIndex].fence.get());
+    }
+    else
+    {
+        // all submissions are in flight, create a new one
+        Submission submission;
+        {
+            vk::CommandBufferAllocateInfo cmdBufferAllocateInfo(
+                m_commandPool.get(), vk::CommandBufferLevel::ePrimary, 1);
+            std::vector<vk::CommandBuffer> buffer;
+            HEPHAESTUS_CHECK_RESULT_RAW(buffer, device.allocateCommandBuffers(cmdBufferAllocateInfo));
+            if (buffer.empty())
+                return false;
+            vk::PoolFree<vk::Device, vk::CommandPool, VulkanDispatcher> deleter(device, m_commandPool.get());
+            submission.cmdBuffer = VulkanUtils::CommandBufferHandle(buffer.front(), deleter);
+        }
+        {
+            vk::FenceCreateInfo fenceCreateInfo;
+            HEPHAESTUS_CHECK_RESULT_HANDLE(submission.fence, device.createFenceUnique(fenceCreateInfo, nullptr));
+            if (!submission.fence)
+                return false;
+        }
+
+        submissionIndex = (uint32_t)m_submissions.size();
+        m_submissions.push_back(std::move(submission));
+    }
+
+    // begin also resets the command buffer
+    vk::CommandBufferBeginInfo beginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+    m_submissions[submissionIndex].cmdBuffer->begin(beginInfo);
+
+    return true;
+}
+
+bool
+VulkanUploadManager::EndSubmission(uint32_t submissionIndex, Ticket& ticket)
+{
+    Submission& submission = m_submissions[submissionIndex];
+    vk::CommandBuffer cmdBuffer = submission.cmdBuffer.get();
+    cmdBuffer.end();
+
+    vk::SubmitInfo submitInfo(
+        0, nullptr,
+        nullptr,
+        1, &cmdBuffer,
+        0, nullptr);
+    if (m_deviceManager->GetGraphicsQueueInfo().queue.submit(submitInfo, submission.fence.get()) != vk::Result::eSuccess)
+    {
+        HEPHAESTUS_LOG_ERROR("Failed to submit upload commands");
+        ReleaseStaging(submission);
+        m_freeSubmissions.push_back(submissionIndex);
+        return false;
+    }
+
+    submission.ticket = ++m_lastTicket;
+    m_pendingSubmissions.push_back(submissionIndex);
+    ticket = submission.ticket;
+
+    return true;
+}
+
+bool
+VulkanUploadManager::RetireSubmissions(bool waitOldest)
+{
+    vk::Device device = m_deviceManager->GetDevice();
+
+    while (!m_pendingSubmissions.empty())
+    {
+        const uint32_t submissionIndex = m_pendingSubmissions.front();
+        Submission& submission = m_submissions[submissionIndex];
+
+        if (waitOldest)
+        {
+            waitOldest = false;
+            if (device.waitForFences(submission.fence.get(), VK_TRUE, UINT64_MAX) != vk::Result::eSuccess)
+            {
+                HEPHAESTUS_LOG_ERROR("Failed to wait for upload %llu", (unsigned long long)submission.ticket);
+                return false;
+            }
+        }
+        else if (device.getFenceStatus(submission.fence.get()) != vk::Result::eSuccess)
+            return true;
+
+        ReleaseStaging(submission);
+        m_completedTicket = submission.ticket;
+
+        m_pendingSubmissions.pop_front();
+        m_freeSubmissions.push_back(submissionIndex);
+    }
+
+    return true;
+}
+
+void
+VulkanUploadManager::ReleaseStaging(Submission& submission)
+{
+    for (const StagingRange& range : submission.stagingRanges)
+        m_stagingRanges.Free(range.offset, range.size);
+    submission.stagingRanges.clear();
+    submission.stagingSize = 0u;
+}
+
+} // hephaestus
@@ -4,6 +4,7 @@
 #include <hephaestus/VulkanDeviceManager.h>
 #include <hephaestus/VulkanDispatcher.h>
 
+#include <algorithm>
 #include <fstream>
 #include <vector>
 
@@ -11,6 +12,53 @@
 namespace hephaestus
 {
 
+// write to the memory of a host visible buffer, only maps the memory if it is not already mapped
+static bool
+s_WriteBufferMemory(const VulkanDeviceManager& deviceManager, const VulkanUtils::BufferInfo& bufferInfo,
+    VkDeviceSize offset, const char* data, VkDeviceSize dataSize)
+{
+    VulkanMemoryAllocator& allocator = deviceManager.GetMemoryAllocator();
+    const VulkanMemoryAllocator::Allocation& allocation = bufferInfo.allocation.Get();
+
+    char* mappedData = bufferInfo.GetMappedData();
+    const bool temporaryMap = mappedData == nullptr;
+    if (temporaryMap)
+        mappedData = reinterpret_cast<char*>(allocator.Map(allocation));
+    if (mappedData == nullptr)
+        return false;
+
+    std::memcpy(mappedData + offset, data, dataSize);
+    allocator.Flush(allocation, offset, dataSize);
+
+    if (temporaryMap)
+        allocator.Unmap(allocation);
+
+    return true;
+}
+
+// submit the commands to the graphics queue and block on a fence until they are executed,
+// unlike waiting for the device to be idle this does not wait for any other work in flight
+static bool
+s_SubmitAndWait(const VulkanDeviceManager& deviceManager, vk::CommandBuffer cmdBuffer)
+{
+    VulkanUtils::FenceHandle fence;
+    vk::FenceCreateInfo fenceCreateInfo;
+    HEPHAESTUS_CHECK_RESULT_HANDLE(fence, 
+        deviceManager.GetDevice().createFenceUnique(fenceCreateInfo, nullptr));
+    if (!fence)
+        return false;
+
+    vk::SubmitInfo submitInfo(
+        0, nullptr,
+        nullptr,
+        1, &cmdBuffer,
+        0, nullptr);
+    if (deviceManager.GetGraphicsQueueInfo().queue.submit(submitInfo, fence.get()) != vk::Result::eSuccess)
+        return false;
+
+    return deviceManager.GetDevice().waitForFences(fence.get(), VK_TRUE, UINT64_MAX) == vk::Result::eSuccess;
+}
+
 // copy from common utils to avoid dependency
 bool
 s_GetBinaryFileContents(const char* filename, std::vector<char>& fileContents)
@@ -54,7 +102,7 @@ VulkanUtils::CreateShaderModule(const VulkanDeviceManager& deviceManager, const
 
 bool 
 VulkanUtils::CreateDepthImage(const VulkanDeviceManager& deviceManager, 
-    uint32_t width, uint32_t height, ImageInfo& depthImageInfo)
+    uint32_t width, uint32_t height, ImageInfo& depthImageInfo, uint32_t numLayers /*= 1u*/)
 {
     vk::Format format = vk::Format::eD32Sfloat;
 
@@ -64,7 +112,7 @@ VulkanUtils::CreateDepthImage(const VulkanDeviceManager& deviceManager,
         format,
         { (uint32_t)width, (uint32_t)height, 1 },	// extend 3D
         1,      // mip levels
-        1,      // array layers
+        numLayers,
         vk::SampleCountFlagBits::e1,
         vk::ImageTiling::eOptimal,
         vk::ImageUsageFlagBits::eDepthStencilAttachment,
@@ -80,12 +128,12 @@ VulkanUtils::CreateDepthImage(const VulkanDeviceManager& deviceManager,
         return false;
 
     deviceManager.GetDevice().bindImageMemory(
-        depthImageInfo.imageHandle.get(), depthImageInfo.deviceMemory.get(), 0);
+        depthImageInfo.imageHandle.get(), depthImageInfo.allocation->memory, depthImageInfo.allocation->offset);
 
     vk::ImageViewCreateInfo viewCreateInfo(
         vk::ImageViewCreateFlags(),
         depthImageInfo.imageHandle.get(),
-        vk::ImageViewType::e2D,
+        numLayers > 1u ? vk::ImageViewType::e2DArray : vk::ImageViewType::e2D,
         format,
         {
             vk::ComponentSwizzle::eIdentity,
@@ -93,7 +141,7 @@ VulkanUtils::CreateDepthImage(const VulkanDeviceManager& deviceManager,
             vk::ComponentSwizzle::eIdentity,
             vk::ComponentSwizzle::eIdentity
         },
-        { vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1 });   // sub resource range
+        { vk::ImageAspectFlagBits::eDepth, 0, 1, 0, numLayers });   // sub resource range
     HEPHAESTUS_CHECK_RESULT_HANDLE(depthImageInfo.view,
         deviceManager.GetDevice().createImageViewUnique(viewCreateInfo, nullptr));
 
@@ -102,7 +150,8 @@ VulkanUtils::CreateDepthImage(const VulkanDeviceManager& deviceManager,
 
 bool 
 VulkanUtils::CreateBuffer(const VulkanDeviceManager& deviceManager, uint32_t size, 	
-    vk::BufferUsageFlags usage, vk::MemoryPropertyFlags memoryProperty,	BufferInfo& bufferInfo)
+    vk::BufferUsageFlags usage, vk::MemoryPropertyFlags memoryProperty,	BufferInfo& bufferInfo,
+    VulkanMemoryAllocator::MemoryUsage memoryUsage, bool persistentlyMapped)
 {
     bufferInfo.size = size;
 
@@ -115,63 +164,42 @@ VulkanUtils::CreateBuffer(const VulkanDeviceManager& deviceManager, uint32_t siz
 
     HEPHAESTUS_CHECK_RESULT_HANDLE(bufferInfo.bufferHandle, 
         deviceManager.GetDevice().createBufferUnique(bufferCreateInfo, nullptr));
-    if (!VulkanUtils::AllocateBufferMemory(deviceManager, memoryProperty, bufferInfo))
+    if (!VulkanUtils::AllocateBufferMemory(deviceManager, memoryProperty, bufferInfo, memoryUsage))
         return false;
 
     deviceManager.GetDevice().bindBufferMemory(
-        bufferInfo.bufferHandle.get(), bufferInfo.deviceMemory.get(), 0);
+        bufferInfo.bufferHandle.get(), bufferInfo.allocation->memory, bufferInfo.allocation->offset);
+
+    if (persistentlyMapped && bufferInfo.allocation.Map() == nullptr)
+        return false;
 
     return true;
 }
 
 bool 
 VulkanUtils::AllocateBufferMemory(const VulkanDeviceManager& deviceManager, 
-    vk::MemoryPropertyFlags requiredMemoryProperty, BufferInfo& bufferInfo)
+    vk::MemoryPropertyFlags requiredMemoryProperty, BufferInfo& bufferInfo, 
+    VulkanMemoryAllocator::MemoryUsage memoryUsage)
 {
     vk::MemoryRequirements bufferMemoryRequirements = 
         deviceManager.GetDevice().getBufferMemoryRequirements(
             bufferInfo.bufferHandle.get());
-    vk::PhysicalDeviceMemoryProperties memoryProperties = 
-        deviceManager.GetPhysicalDevice().getMemoryProperties();
-
-    for (uint32_t memoryTypeIndex = 0; memoryTypeIndex < memoryProperties.memoryTypeCount; ++memoryTypeIndex)
-    {
-        if ((bufferMemoryRequirements.memoryTypeBits & (1 << memoryTypeIndex)) && 
-            (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & requiredMemoryProperty))
-        {
-            vk::MemoryAllocateInfo allocateInfo(bufferMemoryRequirements.size, memoryTypeIndex);
-            HEPHAESTUS_CHECK_RESULT_HANDLE(bufferInfo.deviceMemory, 
-                deviceManager.GetDevice().allocateMemoryUnique(allocateInfo, nullptr));
-            return true;
-        }
-    }
 
-    return false;
+    return deviceManager.GetMemoryAllocator().Allocate(
+        bufferMemoryRequirements, requiredMemoryProperty, memoryUsage, true, bufferInfo.allocation);
 }
 
 bool 
 VulkanUtils::AllocateImageMemory(const VulkanDeviceManager& deviceManager, 
-    vk::MemoryPropertyFlags requiredMemoryProperty, ImageInfo& imageInfo)
+    vk::MemoryPropertyFlags requiredMemoryProperty, ImageInfo& imageInfo, bool linearTiling, 
+    VulkanMemoryAllocator::MemoryUsage memoryUsage)
 {
-    vk::MemoryRequirements bufferMemoryRequirements =
+    vk::MemoryRequirements imageMemoryRequirements =
         deviceManager.GetDevice().getImageMemoryRequirements(
             imageInfo.imageHandle.get());
-    vk::PhysicalDeviceMemoryProperties memoryProperties =
-        deviceManager.GetPhysicalDevice().getMemoryProperties();
 
-    for (uint32_t memoryTypeIndex = 0; memoryTypeIndex < memoryProperties.memoryTypeCount; ++memoryTypeIndex)
-    {
-        if ((bufferMemoryRequirements.memoryTypeBits & (1 << memoryTypeIndex)) &&
-            (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & requiredMemoryProperty))
-        {
-            vk::MemoryAllocateInfo allocateInfo(bufferMemoryRequirements.size, memoryTypeIndex);
-            HEPHAESTUS_CHECK_RESULT_HANDLE(imageInfo.deviceMemory, 
-                deviceManager.GetDevice().allocateMemoryUnique(allocateInfo, nullptr));
-            return true;
-        }
-    }
-
-    return false;
+    return deviceManager.GetMemoryAllocator().Allocate(
+        imageMemoryRequirements, requiredMemoryProperty, memoryUsage, linearTiling, imageInfo.allocation);
 }
 
 bool
@@ -200,7 +228,7 @@ VulkanUtils::CreateImageTextureInfo(const VulkanDeviceManager& deviceManager,
         return false;
 
     deviceManager.GetDevice().bindImageMemory(
-        textureInfo.imageHandle.get(), textureInfo.deviceMemory.get(), 0);
+        textureInfo.imageHandle.get(), textureInfo.allocation->memory, textureInfo.allocation->offset);
 
     vk::ImageViewCreateInfo viewCreateInfo(
         vk::ImageViewCreateFlags(),
@@ -248,26 +276,8 @@ VulkanUtils::CopyBufferDataStage(const VulkanDeviceManager& deviceManager, const
 
     // copy vertex data to the stage buffer
     {
-        void* stageBufferPtr = nullptr;
-        HEPHAESTUS_CHECK_RESULT_RAW(stageBufferPtr, deviceManager.GetDevice().mapMemory(
-                                                        stageBufferInfo.deviceMemory.get(),
-                                                        0,  // offset
-                                                        updateInfo.dataSize,
-                                                        vk::MemoryMapFlags()));
-
-        if (stageBufferPtr == nullptr)
+        if (!s_WriteBufferMemory(deviceManager, stageBufferInfo, 0, updateInfo.data, updateInfo.dataSize))
             return false;
-        std::memcpy(stageBufferPtr, updateInfo.data, updateInfo.dataSize);
-
-        vk::MappedMemoryRange flushRange = 
-        { 
-            stageBufferInfo.deviceMemory.get(), 
-            0, 
-            updateInfo.dataSize 
-        };
-        deviceManager.GetDevice().flushMappedMemoryRanges(flushRange);
-
-        deviceManager.GetDevice().unmapMemory(stageBufferInfo.deviceMemory.get());
     }
 
     // use temporarily a command buffer to copy the data to the device local buffer
@@ -300,17 +310,8 @@ VulkanUtils::CopyBufferDataStage(const VulkanDeviceManager& deviceManager, const
         updateInfo.copyCmdBuffer.end();
     }
 
-    // submit & wait for the queue now to finish the copy
-    vk::SubmitInfo submitInfo(
-        0, nullptr,
-        nullptr,
-        1, &updateInfo.copyCmdBuffer,
-        0, nullptr);
-    deviceManager.GetGraphicsQueueInfo().queue.submit(submitInfo, nullptr);
-
-    deviceManager.GetDevice().waitIdle();
-
-    return true;
+    // submit & wait only for the copy to finish
+    return s_SubmitAndWait(deviceManager, updateInfo.copyCmdBuffer);
 }
 
 bool
@@ -323,20 +324,8 @@ VulkanUtils::CopyImageDataStage(const VulkanDeviceManager& deviceManager, const
 
     // copy image data to the stage buffer
     {
-        void* stageBufferPtr = nullptr;
-        HEPHAESTUS_CHECK_RESULT_RAW(stageBufferPtr ,deviceManager.GetDevice().mapMemory(
-                                                        stageBufferInfo.deviceMemory.get(),
-                                                        0,	// offset
-                                                        textureUpdateInfo.dataSize,
-                                                        vk::MemoryMapFlags()));
-        if (stageBufferPtr == nullptr)
+        if (!s_WriteBufferMemory(deviceManager, stageBufferInfo, 0, textureUpdateInfo.data, textureUpdateInfo.dataSize))
             return false;
-        std::memcpy(stageBufferPtr, textureUpdateInfo.data, textureUpdateInfo.dataSize);
-
-        vk::MappedMemoryRange flushRange = { stageBufferInfo.deviceMemory.get(), 0, VK_WHOLE_SIZE };
-        deviceManager.GetDevice().flushMappedMemoryRanges(flushRange);
-        deviceManager.GetDevice().unmapMemory(
-            stageBufferInfo.deviceMemory.get());
     }
 
     // use temporarily a command buffer to write to the device image
@@ -401,17 +390,8 @@ VulkanUtils::CopyImageDataStage(const VulkanDeviceManager& deviceManager, const
         textureUpdateInfo.copyCmdBuffer.end();
     }
 
-    // submit queue now to do the copy
-    vk::SubmitInfo submitInfo(
-        0, nullptr,
-        nullptr,
-        1, &textureUpdateInfo.copyCmdBuffer,
-        0, nullptr);
-    deviceManager.GetGraphicsQueueInfo().queue.submit(submitInfo, nullptr);
-
-    deviceManager.GetDevice().waitIdle();
-
-    return true;
+    // submit & wait only for the copy to finish
+    return s_SubmitAndWait(deviceManager, textureUpdateInfo.copyCmdBuffer);
 }
 
 bool 
@@ -421,40 +401,26 @@ VulkanUtils::CopyBufferDataHost(const VulkanDeviceManager& deviceManager,
     HEPHAESTUS_ASSERT(dstBufferInfo.IsValid());
     HEPHAESTUS_ASSERT(updateInfo.dataSize <= dstBufferInfo.size);
 
-    void* mappedMemPtr = nullptr; 
-    HEPHAESTUS_CHECK_RESULT_RAW(mappedMemPtr, deviceManager.GetDevice().mapMemory(
-                                                    dstBufferInfo.deviceMemory.get(),
-                                                    dstBufferOffset,    // offset
-                                                    updateInfo.dataSize,
-                                                    vk::MemoryMapFlags()));
-    if (mappedMemPtr == nullptr)
-        return false;
-    std::memcpy(mappedMemPtr, updateInfo.data, updateInfo.dataSize);
-
-    //vk::MappedMemoryRange flushRange = { dstBufferInfo.deviceMemory.get(), 0, VK_WHOLE_SIZE };
-    vk::MappedMemoryRange flushRange = 
-    { 
-        dstBufferInfo.deviceMemory.get(), 
-        dstBufferOffset, 
-        updateInfo.dataSize 
-    };
-    deviceManager.GetDevice().flushMappedMemoryRanges(flushRange);
-
-    deviceManager.GetDevice().unmapMemory(dstBufferInfo.deviceMemory.get());
-
-    return true;
+    return s_WriteBufferMemory(deviceManager, dstBufferInfo, dstBufferOffset, updateInfo.data, updateInfo.dataSize);
 }
 
 bool 
 VulkanUtils::CreateDescriptorPool(const VulkanDeviceManager& deviceManager,
-    uint32_t uniformSize, uint32_t combinedImgSamplerSize, DescriptorPoolHandle& descriptorPool)
+    uint32_t uniformSize, uint32_t combinedImgSamplerSize, DescriptorPoolHandle& descriptorPool,
+    uint32_t dynamicUniformSize, uint32_t dynamicStorageSize)
 {
     std::vector<vk::DescriptorPoolSize> poolSizes;
     poolSizes.emplace_back(vk::DescriptorType::eUniformBuffer, uniformSize);
     poolSizes.emplace_back(vk::DescriptorType::eCombinedImageSampler, combinedImgSamplerSize);
+    if (dynamicUniformSize > 0u)
+        poolSizes.emplace_back(vk::DescriptorType::eUniformBufferDynamic, dynamicUniformSize);
+    if (dynamicStorageSize > 0u)
+        poolSizes.emplace_back(vk::DescriptorType::eStorageBufferDynamic, dynamicStorageSize);
 
+    const uint32_t maxSets = std::max(12u, 
+        uniformSize + combinedImgSamplerSize + dynamicUniformSize + dynamicStorageSize);
     vk::DescriptorPoolCreateInfo poolCreateInfo(
-        vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet, 12u, 
+        vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet, maxSets, 
         (uint32_t)poolSizes.size(), poolSizes.data());
 
     HEPHAESTUS_CHECK_RESULT_HANDLE(descriptorPool, 
@@ -465,7 +431,8 @@ VulkanUtils::CreateDescriptorPool(const VulkanDeviceManager& deviceManager,
 
 bool 
 VulkanUtils::CreateRenderPass(const VulkanDeviceManager& deviceManager, 
-    vk::Format format, vk::ImageLayout finalLayout, RenderPassHandle& renderPass)
+    vk::Format format, vk::ImageLayout finalLayout, RenderPassHandle& renderPass, uint32_t numViews /*= 1u*/,
+    const std::vector<vk::Format>& auxFormats /*= std::vector<vk::Format>()*/)
 {
     vk::AttachmentDescription colorAttachmentDescription(
         vk::AttachmentDescriptionFlags(),
@@ -490,14 +457,33 @@ VulkanUtils::CreateRenderPass(const VulkanDeviceManager& deviceManager,
         vk::ImageLayout::eDepthStencilAttachmentOptimal);	// final layout
 
 
-    vk::AttachmentReference colorAttachmentReference(0, vk::ImageLayout::eColorAttachmentOptimal);
+    std::vector<vk::AttachmentDescription> attachments = 
+        { colorAttachmentDescription, depthAttachmentDescription };
+    std::vector<vk::AttachmentReference> colorAttachmentReferences = 
+        { vk::AttachmentReference(0, vk::ImageLayout::eColorAttachmentOptimal) };
     vk::AttachmentReference depthAttachmentReference(1, vk::ImageLayout::eDepthStencilAttachmentOptimal);
 
+    // auxiliary outputs are stored like the color
+    for (vk::Format auxFormat : auxFormats)
+    {
+        if (auxFormat == vk::Format::eUndefined)
+        {
+            colorAttachmentReferences.emplace_back(VK_ATTACHMENT_UNUSED, vk::ImageLayout::eUndefined);
+            continue;
+        }
+
+        vk::AttachmentDescription auxAttachmentDescription = colorAttachmentDescription;
+        auxAttachmentDescription.format = auxFormat;
+        colorAttachmentReferences.emplace_back(
+            (uint32_t)attachments.size(), vk::ImageLayout::eColorAttachmentOptimal);
+        attachments.push_back(auxAttachmentDescription);
+    }
+
     vk::SubpassDescription subpassDescription(
         vk::SubpassDescriptionFlags(),
         vk::PipelineBindPoint::eGraphics,
         0, nullptr,
-        1, &colorAttachmentReference,
+        (uint32_t)colorAttachmentReferences.size(), colorAttachmentReferences.data(),
         nullptr,						// resolve attachment
         &depthAttachmentReference,
         0, nullptr);
@@ -520,20 +506,48 @@ VulkanUtils::CreateRenderPass(const VulkanDeviceManager& deviceManager,
         vk::AccessFlagBits::eMemoryRead,
         vk::DependencyFlagBits::eByRegion));
 
-    std::array<vk::AttachmentDescription, 2> attachments =
-    { colorAttachmentDescription, depthAttachmentDescription };
     vk::RenderPassCreateInfo renderPassCreateInfo(
         vk::RenderPassCreateFlags(),
         (uint32_t)attachments.size(), attachments.data(),
         1, &subpassDescription,
         (uint32_t)dependencies.size(), dependencies.data());
 
+    // broadcast the subpass to all views, the views are also rendered concurrently if possible
+    const uint32_t viewMask = numViews >= 32u ? UINT32_MAX : (1u << numViews) - 1u;
+    vk::RenderPassMultiviewCreateInfo multiviewCreateInfo(1, &viewMask, 0, nullptr, 1, &viewMask);
+    if (numViews > 1u)
+        renderPassCreateInfo.pNext = &multiviewCreateInfo;
+
     HEPHAESTUS_CHECK_RESULT_HANDLE(renderPass, 
         deviceManager.GetDevice().createRenderPassUnique(renderPassCreateInfo, nullptr));
 
     return true;
 }
 
+vk::Format 
+VulkanUtils::GetRenderOutputFormat(RenderOutput output, vk::Format colorFormat)
+{
+    switch (output)
+    {
+    case eRENDER_OUTPUT_COLOR:
+        return colorFormat;
+    case eRENDER_OUTPUT_DEPTH:
+        return vk::Format::eR32Sfloat;
+    case eRENDER_OUTPUT_NORMAL:
+        return vk::Format::eR16G16B16A16Sfloat;
+    case eRENDER_OUTPUT_MESH_ID:
+        return vk::Format::eR32Uint;
+    default:
+        return vk::Format::eUndefined;
+    }
+}
+
+uint32_t 
+VulkanUtils::GetRenderOutputPixelSize(RenderOutput output)
+{
+    // the color formats supported by the renderers are all 8 bit RGBA/BGRA
+    return output == eRENDER_OUTPUT_NORMAL ? 8u : 4u;
+}
 
 uint32_t 
 VulkanUtils::FixupFlushRange(const VulkanDeviceManager& deviceManager, uint32_t size)
@@ -101,6 +101,27 @@ VulkanValidate::CheckPhysicalDeviceRequiredExtensions(
     return true;
 }
 
+//static 
+bool 
+VulkanValidate::IsPhysicalDeviceExtensionSupported(
+    const char* extensionName,
+    const vk::PhysicalDevice& physicalDevice)
+{
+    HEPHAESTUS_LOG_ASSERT(physicalDevice, "No Vulkan physical device available");
+
+    std::vector<vk::ExtensionProperties> deviceExtensionProperties;
+    HEPHAESTUS_CHECK_RESULT_RAW(deviceExtensionProperties, 
+        physicalDevice.enumerateDeviceExtensionProperties(nullptr));
+
+    for (const vk::ExtensionProperties& extensionProperty : deviceExtensionProperties)
+    {
+        if (std::strcmp(extensionName, extensionProperty.extensionName) == 0)
+            return true;
+    }
+
+    return false;
+}
+
 //static 
 bool 
 VulkanValidate::CheckPhysicalDevicePropertiesAndFeatures(